@@ -32,18 +32,6 @@ end
 
 local mob_config = require "scripts/monster/settings"
 
-local function calculate_position_priority(x1, y1, x2, y2, anger, range)
-    if math.floor(x1 / TILESIZE) == math.floor(x2 / TILESIZE) and
-       math.floor(y1 / TILESIZE) == math.floor(y2 / TILESIZE)
-    then
-        -- Both on the same tile
-        return anger * range
-    end
-
-    local path_length = get_path_length(x1, y1, x2, y2, range, "w")
-    return (range - path_length) * anger
-end
-
 local function update_attack_ai(mob, tick)
     local config = mob_config[mob:name()]
 
@@ -84,16 +72,14 @@ local function update_attack_ai(mob, tick)
                     y = being:y() + config.attack_distance,
                 },
             }
-            for _, point in ipairs(possible_attack_positions) do
-                local priority = calculate_position_priority(mob:x(),
-                                                             mob:y(),
-                                                             point.x,
-                                                             point.y,
-                                                             anger,
-                                                             config.trackrange)
-
+            local index, path_length =
+                get_nearest_path(mob:x(), mob:y(), possible_attack_positions,
+                                 config.trackrange, "w")
+            if index then
+                local priority = (config.trackrange - path_length) * anger
                 if priority > 0 and (not target or priority > target_priority)
                 then
+                    local point = possible_attack_positions[index]
                     target = being
                     target_priority = priority
                     attack_x, attack_y = point.x, point.y
@@ -95,8 +95,9 @@ enum {
     PAMSG_PASSWORD_CHANGE          = 0x0034, // S old password, S new password
     APMSG_PASSWORD_CHANGE_RESPONSE = 0x0035, // B error
 
-    PGMSG_CONNECT                  = 0x0050, // B*32 token
-    GPMSG_CONNECT_RESPONSE         = 0x0051, // B error
+    PGMSG_CONNECT                  = 0x0050, // B*32 token [, B capabilities]
+    GPMSG_CONNECT_RESPONSE         = 0x0051, // B error [, B enabled capabilities (if capabilities were sent)]
+    GPMSG_BATCH                    = 0x0052, // { W length, B*length message }*
     PCMSG_CONNECT                  = 0x0053, // B*32 token
     CPMSG_CONNECT_RESPONSE         = 0x0054, // B error
 
@@ -148,6 +149,7 @@ enum {
     GPMSG_BEING_ABILITY_POINT      = 0x0282, // W being id, B abilityId, W*2 point
     GPMSG_BEING_ABILITY_BEING      = 0x0283, // W being id, B abilityId, W target being id
     GPMSG_BEING_ABILITY_DIRECTION  = 0x0284, // W being id, B abilityId, B direction
+    GPMSG_BEINGS_MOVE_DELTA        = 0x0285, // { W being id, B flags [, B*2 offset | W*2 position] [, B speed] }*
     PGMSG_USE_ABILITY_ON_BEING     = 0x0290, // B abilityID, W being id
     PGMSG_USE_ABILITY_ON_POINT     = 0x0291, // B abilityID, W*2 position
     PGMSG_USE_ABILITY_ON_DIRECTION = 0x0292, // B abilityID, B direction
@@ -314,6 +316,12 @@ enum {
     ERRMSG_LOGIN_WAS_TAKEN_OVER         // a different connection took over
 };
 
+// capabilities announced by the client in PGMSG_CONNECT
+enum {
+    CAPABILITY_BATCH = 0x01,            // messages may be sent in GPMSG_BATCH
+    CAPABILITY_MOVE_DELTA = 0x02        // movements are sent in GPMSG_BEINGS_MOVE_DELTA
+};
+
 // used in AGMSG_REGISTER_RESPONSE to show state of item db
 enum {
     DATA_VERSION_OK       = 0x00,
@@ -395,6 +403,18 @@ enum {
     MOVING_DESTINATION = 2
 };
 
+// Flags of the entries of GPMSG_BEINGS_MOVE_DELTA. Positions are relative to
+// the last position of the being sent to the client, which is the one of
+// GPMSG_BEING_ENTER for the first entry.
+enum {
+    // Payload contains the offset from the last position, as signed bytes.
+    MOVE_DELTA_OFFSET = 1,
+    // Payload contains the position, when the offset does not fit in a byte.
+    MOVE_DELTA_POSITION = 2,
+    // Payload contains the speed, which changed since the last entry.
+    MOVE_DELTA_SPEED = 4
+};
+
 // Chat errors return values
 enum {
     CHAT_USING_BAD_WORDS = 0x40,
@@ -22,36 +22,60 @@
 
 #include "game-server/being.h"
 #include "game-server/entity.h"
+#include "game-server/mapcomposite.h"
+#include "game-server/state.h"
+#include "game-server/timerwheel.h"
 
 #include "scripting/scriptmanager.h"
 
 #include "utils/logger.h"
 
+#include <sigc++/adaptors/bind.h>
+
 AbilityComponent::AbilityComponent():
     mLastUsedAbilityId(0),
     mLastTargetBeingId(0)
 {
 }
 
-void AbilityComponent::update(Entity &entity)
+AbilityComponent::~AbilityComponent()
 {
-    // Update ability recharge
+    TimerWheel &timers = GameState::getTimers();
     for (auto &it : mAbilities)
+        timers.cancel(it.second.rechargeTimer);
+}
+
+void AbilityComponent::recharged(Entity *entity, int id)
+{
+    AbilityMap::iterator it = mAbilities.find(id);
+    if (it == mAbilities.end())
+        return;
+
+    // A timer parked on an inactive map may fire after the ability was used
+    // again
+    auto &ability = it->second;
+    if (GameState::getTimers().isPending(ability.rechargeTimer))
+        return;
+    ability.rechargeTimer = 0;
+
+    MapComposite *map = entity->getMap();
+    if (!map->isActive())
     {
-        auto &ability = it.second;
-        if (!ability.recharged && ability.rechargeTimeout.expired()) {
-            ability.recharged = true;
-
-            if (ability.abilityInfo->rechargedCallback.isValid()) {
-                Script *script = ScriptManager::currentState();
-                script->prepare(ability.abilityInfo->rechargedCallback);
-                script->push(&entity);
-                script->push(ability.abilityInfo->id);
-                script->execute(entity.getMap());
-            }
-        }
+        map->parkTimer(sigc::bind(
+                sigc::mem_fun(this, &AbilityComponent::recharged),
+                entity, id));
+        return;
     }
 
+    ability.recharged = true;
+
+    if (ability.abilityInfo->rechargedCallback.isValid()) {
+        Script *script = ScriptManager::currentState();
+        script->prepare(ability.abilityInfo->rechargedCallback);
+        script->push(entity);
+        script->push(ability.abilityInfo->id);
+        script->execute(map);
+    }
 }
 
 /**
@@ -62,6 +86,7 @@ bool AbilityComponent::takeAbility(int id)
     AbilityMap::iterator i = mAbilities.find(id);
     if (i != mAbilities.end())
     {
+        GameState::getTimers().cancel(i->second.rechargeTimer);
         mAbilities.erase(i);
         signal_ability_took.emit(id);
         return true;
@@ -69,6 +94,17 @@ bool AbilityComponent::takeAbility(int id)
     return false;
 }
 
+/**
+ * Removes all abilities from character
+ */
+void AbilityComponent::clearAbilities()
+{
+    TimerWheel &timers = GameState::getTimers();
+    for (auto &it : mAbilities)
+        timers.cancel(it.second.rechargeTimer);
+    mAbilities.clear();
+}
+
 bool AbilityComponent::abilityUseCheck(AbilityMap::iterator it)
 {
     if (!mGlobalCooldown.expired())
@@ -194,7 +230,7 @@ bool AbilityComponent::useAbilityOnDirection(Entity &user, int id,
 /**
  * Allows a character to perform a ability
  */
-bool AbilityComponent::giveAbility(int id)
+bool AbilityComponent::giveAbility(Entity &entity, int id)
 {
     if (mAbilities.find(id) == mAbilities.end())
     {
@@ -204,30 +240,43 @@ bool AbilityComponent::giveAbility(int id)
             LOG_ERROR("Tried to give not existing ability id " << id << ".");
             return false;
         }
-        return giveAbility(abilityInfo);
+        return giveAbility(entity, abilityInfo);
     }
     return false;
 }
 
-bool AbilityComponent::giveAbility(const AbilityManager::AbilityInfo *info)
+bool AbilityComponent::giveAbility(Entity &entity,
+                                   const AbilityManager::AbilityInfo *info)
 {
     bool added = mAbilities.insert(std::pair<int, AbilityValue>(info->id,
                                    AbilityValue(info))).second;
 
-    signal_ability_changed.emit(info->id);
+    // New abilities are recharged on the next tick
+    if (added)
+        setAbilityCooldown(entity, info->id, 0);
+    else
+        signal_ability_changed.emit(info->id);
     return added;
 }
 
 /**
  * Sets cooldown time for this ability
  */
-void AbilityComponent::setAbilityCooldown(int id, int ticks)
+void AbilityComponent::setAbilityCooldown(Entity &entity, int id, int ticks)
 {
     AbilityMap::iterator it = mAbilities.find(id);
     if (it != mAbilities.end())
     {
-        it->second.recharged = false;
-        it->second.rechargeTimeout.set(ticks);
+        auto &ability = it->second;
+        ability.recharged = false;
+        ability.rechargeTimeout.set(ticks);
+
+        TimerWheel &timers = GameState::getTimers();
+        timers.cancel(ability.rechargeTimer);
+        ability.rechargeTimer = timers.schedule(ticks, sigc::bind(
+                sigc::mem_fun(this, &AbilityComponent::recharged),
+                &entity, id));
+
         signal_ability_changed.emit(id);
     }
 }
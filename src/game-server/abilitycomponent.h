@@ -33,11 +33,13 @@ struct AbilityValue
 {
     AbilityValue(const AbilityManager::AbilityInfo *abilityInfo)
         : recharged(false)
+        , rechargeTimer(0)
         , abilityInfo(abilityInfo)
     {}
 
     bool recharged;
     Timeout rechargeTimeout;
+    unsigned rechargeTimer;     /**< Fires when the ability is recharged. */
     const AbilityManager::AbilityInfo *abilityInfo;
 };
 
@@ -47,29 +49,34 @@ struct AbilityValue
 typedef std::map<unsigned, AbilityValue> AbilityMap;
 
 
-class AbilityComponent: public Component
+class AbilityComponent : public PooledComponent<AbilityComponent>
 {
 public:
     static const ComponentType type = CT_Ability;
 
     AbilityComponent();
+    ~AbilityComponent();
 
-    void update(Entity &entity);
+    /**
+     * Abilities recharge through timers, see setAbilityCooldown.
+     */
+    void update(Entity &entity)
+    {}
 
     bool useAbilityOnBeing(Entity &user, int id, Entity *b);
     bool useAbilityOnPoint(Entity &user, int id, int x, int y);
     bool useAbilityOnDirection(Entity &user, int id,
                                ManaServ::BeingDirection direction);
 
-    bool giveAbility(int id);
-    bool giveAbility(const AbilityManager::AbilityInfo *info);
+    bool giveAbility(Entity &entity, int id);
+    bool giveAbility(Entity &entity, const AbilityManager::AbilityInfo *info);
     bool hasAbility(int id) const;
     bool takeAbility(int id);
     AbilityMap::iterator findAbility(int id);
     const AbilityMap &getAbilities() const;
     void clearAbilities();
 
-    void setAbilityCooldown(int id, int ticks);
+    void setAbilityCooldown(Entity &entity, int id, int ticks);
     int abilityCooldown(int id);
 
     void setGlobalCooldown(int ticks);
@@ -89,6 +96,11 @@ public:
 private:
     bool abilityUseCheck(AbilityMap::iterator it);
 
+    /**
+     * Called by the recharge timer of an ability.
+     */
+    void recharged(Entity *entity, int id);
+
     Timeout mGlobalCooldown;
 
     AbilityMap mAbilities;
@@ -109,14 +121,6 @@ inline AbilityMap::iterator AbilityComponent::findAbility(int id)
     return mAbilities.find(id);
 }
 
-/**
- * Removes all abilities from character
- */
-inline void AbilityComponent::clearAbilities()
-{
-    mAbilities.clear();
-}
-
 /**
  * Checks if a character knows a ability action
  */
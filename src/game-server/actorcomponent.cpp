@@ -29,6 +29,8 @@ ActorComponent::ActorComponent(Entity &entity):
     mMoveTime(0),
     mUpdateFlags(0),
     mPublicID(65535),
+    mZone(-1),
+    mZoneSlot(0),
     mSize(0),
     mWalkMask(0),
     mBlockType(BLOCKTYPE_NONE)
@@ -70,6 +72,10 @@ void ActorComponent::setPosition(Entity &entity, const Point &p)
     }
 
     mPos = p;
+
+    // Keep the copy used by the map range queries up to date
+    if (mZone >= 0)
+        entity.getMap()->updatePosition(&entity);
 }
 
 void ActorComponent::mapChanged(Entity *entity)
@@ -47,7 +47,7 @@ enum
  * Generic client-visible object. Keeps track of position, size and what to
  * update clients about.
  */
-class ActorComponent : public Component
+class ActorComponent : public PooledComponent<ActorComponent>
 {
     public:
         static const ComponentType type = CT_Actor;
@@ -116,6 +116,32 @@ class ActorComponent : public Component
         bool isPublicIdValid() const
         { return (mPublicID > 0 && mPublicID != 65535); }
 
+        /**
+         * Gets the index of the map zone the actor is stored in, -1 if none.
+         * Since map zones overlap, the position of the actor does not
+         * uniquely define it.
+         */
+        int getZone() const
+        { return mZone; }
+
+        /**
+         * Sets the map zone the actor is stored in. Used by MapComposite.
+         */
+        void setZone(int zone)
+        { mZone = zone; }
+
+        /**
+         * Gets the index of the actor in its map zone.
+         */
+        unsigned getZoneSlot() const
+        { return mZoneSlot; }
+
+        /**
+         * Sets the index of the actor in its map zone. Used by MapComposite.
+         */
+        void setZoneSlot(unsigned slot)
+        { mZoneSlot = slot; }
+
         void setWalkMask(unsigned char mask)
         { mWalkMask = mask; }
 
@@ -150,6 +176,9 @@ class ActorComponent : public Component
         /** Actor ID sent to clients (unique with respect to the map). */
         unsigned short mPublicID;
 
+        int mZone;                  /**< Map zone the actor is stored in. */
+        unsigned mZoneSlot;         /**< Index in the map zone. */
+
         Point mPos;                 /**< Coordinates. */
         unsigned char mSize;        /**< Radius of bounding circle. */
 
@@ -20,7 +20,9 @@
 
 #include "attribute.h"
 #include "game-server/being.h"
+#include "game-server/state.h"
 #include "utils/logger.h"
+#include <algorithm>
 #include <cassert>
 
 AttributeModifiersEffect::AttributeModifiersEffect(StackableType stackableType,
@@ -56,7 +58,17 @@ bool AttributeModifiersEffect::add(unsigned short duration,
               " with a previous layer value of " << prevLayerValue << ". "
               "Current mod at this layer: " << mMod << ".");
     bool ret = false;
-    mStates.push_back(new AttributeModifierState(duration, value, level));
+    if (duration)
+    {
+        const int expireTick = GameState::getCurrentTick() + duration;
+        mTimedStates.push_back(AttributeModifierState(expireTick, value,
+                                                      level));
+        std::push_heap(mTimedStates.begin(), mTimedStates.end());
+    }
+    else
+    {
+        mPermanentStates.push_back(AttributeModifierState(0, value, level));
+    }
     switch (mStackableType) {
     case Stackable:
         switch (mEffectType) {
@@ -127,42 +139,63 @@ bool AttributeModifiersEffect::add(unsigned short duration,
     return ret;
 }
 
-bool durationCompare(const AttributeModifierState *lhs,
-                     const AttributeModifierState *rhs)
+unsigned AttributeModifiersEffect::removeStates(
+        std::vector<AttributeModifierState> &states,
+        double value, unsigned id)
 {
-    return lhs->mDuration < rhs->mDuration;
-}
-
-bool AttributeModifiersEffect::remove(double value, unsigned id,
-                                      bool fullCheck)
-{
-    /* We need to find and check this entry exists, and erase the entry
-       from the list too. */
-    if (!fullCheck)
-        mStates.sort(durationCompare); /* Search only through those with a duration of 0. */
-    bool ret = false;
-
-    for (std::list< AttributeModifierState * >::iterator it = mStates.begin();
-         it != mStates.end() && (fullCheck || !(*it)->mDuration);)
+    unsigned removed = 0;
+    int first = -1;
+    for (unsigned i = 0; i < states.size(); )
     {
         /* Check for a match */
-        if ((*it)->mValue != value || (*it)->mId != id)
+        if (states[i].mValue != value || states[i].mId != id)
         {
-            ++it;
+            ++i;
             continue;
         }
 
-        delete *it;
-        mStates.erase(it++);
+        if (!id)
+        {
+            if (first == -1 ||
+                states[i].mExpireTick < states[first].mExpireTick)
+                first = i;
+            ++i;
+            continue;
+        }
 
-        /* If this is stackable, we need to update for every modifier affected */
-        if (mStackableType == Stackable)
-            updateMod(value);
+        states[i] = states.back();
+        states.pop_back();
+        ++removed;
+    }
 
-        ret = true;
-        if (!id)
-            break;
+    if (first != -1)
+    {
+        states[first] = states.back();
+        states.pop_back();
+        ++removed;
     }
+    return removed;
+}
+
+bool AttributeModifiersEffect::remove(double value, unsigned id,
+                                      bool fullCheck)
+{
+    /* Search only through those with a duration of 0, unless asked. */
+    unsigned removed = removeStates(mPermanentStates, value, id);
+    if (fullCheck && (id || !removed))
+    {
+        const unsigned timedRemoved = removeStates(mTimedStates, value, id);
+        if (timedRemoved)
+            std::make_heap(mTimedStates.begin(), mTimedStates.end());
+        removed += timedRemoved;
+    }
+
+    /* If this is stackable, we need to update for every modifier affected */
+    if (mStackableType == Stackable)
+        for (unsigned i = 0; i < removed; ++i)
+            updateMod(value);
+
+    const bool ret = removed;
     /*
      * Non stackables only need to be updated once, since this is recomputed
      * from scratch. This is done at the end after modifications have been
@@ -188,12 +221,10 @@ void AttributeModifiersEffect::updateMod(double value)
             else
             {
                 mMod = 1;
-                for (std::list< AttributeModifierState * >::const_iterator
-                     it = mStates.begin(),
-                     it_end = mStates.end();
-                    it != it_end;
-                    ++it)
-                    mMod *= (*it)->mValue;
+                for (const AttributeModifierState &state : mPermanentStates)
+                    mMod *= state.mValue;
+                for (const AttributeModifierState &state : mTimedStates)
+                    mMod *= state.mValue;
             }
         }
         else LOG_ERROR("Attribute modifiers effect: unhandled type '"
@@ -204,13 +235,12 @@ void AttributeModifiersEffect::updateMod(double value)
         if (mMod == value)
         {
             mMod = 0;
-            for (std::list< AttributeModifierState * >::const_iterator
-                 it = mStates.begin(),
-                 it_end = mStates.end();
-                it != it_end;
-                ++it)
-                if ((*it)->mValue > mMod)
-                    mMod = (*it)->mValue;
+            for (const AttributeModifierState &state : mPermanentStates)
+                if (state.mValue > mMod)
+                    mMod = state.mValue;
+            for (const AttributeModifierState &state : mTimedStates)
+                if (state.mValue > mMod)
+                    mMod = state.mValue;
         }
     }
     else
@@ -294,22 +324,17 @@ bool Attribute::remove(double value, unsigned layer,
     return false;
 }
 
-bool AttributeModifiersEffect::tick()
+bool AttributeModifiersEffect::expire(int tick)
 {
     bool ret = false;
-    std::list<AttributeModifierState *>::iterator it = mStates.begin();
-    while (it != mStates.end())
+    while (!mTimedStates.empty() && mTimedStates.front().mExpireTick <= tick)
     {
-        if ((*it)->tick())
-        {
-            double value = (*it)->mValue;
-            LOG_DEBUG("Modifier of value " << value << " expiring!");
-            delete *it;
-            mStates.erase(it++);
-            updateMod(value);
-            ret = true;
-        }
-        ++it;
+        double value = mTimedStates.front().mValue;
+        LOG_DEBUG("Modifier of value " << value << " expiring!");
+        std::pop_heap(mTimedStates.begin(), mTimedStates.end());
+        mTimedStates.pop_back();
+        updateMod(value);
+        ret = true;
     }
     return ret;
 }
@@ -344,14 +369,15 @@ Attribute::~Attribute()
 //    }
 }
 
-bool Attribute::tick()
+bool Attribute::expire()
 {
+    const int tick = GameState::getCurrentTick();
     bool ret = false;
     double prev = mBase;
     for (std::vector<AttributeModifiersEffect *>::iterator it = mMods.begin(),
         it_end = mMods.end(); it != it_end; ++it)
     {
-        if ((*it)->tick())
+        if ((*it)->expire(tick))
         {
             LOG_DEBUG("Attribute layer " << mMods.begin() - it
                       << " has expiring modifiers.");
@@ -364,6 +390,30 @@ bool Attribute::tick()
     return ret;
 }
 
+bool Attribute::hasTimedModifiers() const
+{
+    for (std::vector<AttributeModifiersEffect *>::const_iterator
+         it = mMods.begin(), it_end = mMods.end(); it != it_end; ++it)
+    {
+        if ((*it)->hasTimedStates())
+            return true;
+    }
+    return false;
+}
+
+int Attribute::getNextExpiry() const
+{
+    int next = 0;
+    for (std::vector<AttributeModifiersEffect *>::const_iterator
+         it = mMods.begin(), it_end = mMods.end(); it != it_end; ++it)
+    {
+        const int expireTick = (*it)->getNextExpiry();
+        if (expireTick && (!next || expireTick < next))
+            next = expireTick;
+    }
+    return next;
+}
+
 void Attribute::clearMods()
 {
     for (std::vector<AttributeModifiersEffect *>::iterator it = mMods.begin(),
@@ -389,7 +439,8 @@ void Attribute::setBase(double base)
 
 void AttributeModifiersEffect::clearMods(double baseValue)
 {
-    mStates.clear();
+    mPermanentStates.clear();
+    mTimedStates.clear();
     mCacheVal = baseValue;
     mMod = mEffectType == Additive ? 0 : 1;
 }
@@ -24,33 +24,35 @@
 #include "common/defines.h"
 #include "attributeinfo.h"
 #include <vector>
-#include <list>
 
 class AttributeModifierState
 {
     public:
-        AttributeModifierState(unsigned short duration,
+        AttributeModifierState(int expireTick,
                                double value,
                                unsigned id)
-            : mDuration(duration)
+            : mExpireTick(expireTick)
             , mValue(value)
             , mId(id)
         {}
 
-        bool tick() { return mDuration ? !--mDuration : false; }
+        /**
+         * Orders the states by expiry, the one expiring last first, as
+         * needed to keep the next one to expire on top of a heap.
+         */
+        bool operator<(const AttributeModifierState &other) const
+        { return mExpireTick > other.mExpireTick; }
 
     private:
-        /** Number of ticks (0 means permanent, e.g. equipment). */
-        unsigned short mDuration;
-        const double mValue;   /**< Positive or negative amount. */
+        /** Tick of expiry (0 means permanent, e.g. equipment). */
+        int mExpireTick;
+        double mValue;   /**< Positive or negative amount. */
         /**
          * Special purpose variable used to identify this effect to
          * dispells or similar. Exact usage depends on the effect,
          * origin, etc.
          */
-        const unsigned mId;
-        friend bool durationCompare(const AttributeModifierState*,
-                                    const AttributeModifierState*);
+        unsigned mId;
         friend class AttributeModifiersEffect;
 };
 
@@ -98,7 +100,23 @@ class AttributeModifiersEffect
 
         double getCachedModifiedValue() const { return mCacheVal; }
 
-        bool tick();
+        /**
+         * Returns whether some modifiers of this layer expire.
+         */
+        bool hasTimedStates() const { return !mTimedStates.empty(); }
+
+        /**
+         * Returns the tick at which the next modifier of this layer expires,
+         * or 0 when none expires.
+         */
+        int getNextExpiry() const
+        { return mTimedStates.empty() ? 0 : mTimedStates.front().mExpireTick; }
+
+        /**
+         * Removes the modifiers expired by the given tick.
+         * @returns Whether some modifiers expired.
+         */
+        bool expire(int tick);
 
         /**
          * clearMods() - removes all modifications present in this layer.
@@ -109,16 +127,32 @@ class AttributeModifiersEffect
         void clearMods(double baseValue);
 
     private:
-        /** List of all modifications present at this level */
-        std::list<AttributeModifierState *> mStates;
         /**
-         * Stores the value that results from mStates. This takes into
+         * Removes the states matching \a value and \a id from \a states,
+         * by moving the last states in their place. When \a id is 0, only
+         * the one expiring first is removed.
+         * @returns The number of states removed.
+         */
+        static unsigned removeStates(
+                std::vector<AttributeModifierState> &states,
+                double value, unsigned id);
+
+        /**
+         * Modifications present at this level. The permanent ones are kept
+         * in no particular order, the timed ones in a heap with the next one
+         * to expire on top. Both keep their storage when states go away.
+         */
+        std::vector<AttributeModifierState> mPermanentStates;
+        std::vector<AttributeModifierState> mTimedStates;
+        /**
+         * Stores the value that results from the states. This takes into
          * account all previous layers.
          */
         double mCacheVal;
         /**
-         * Stores the effective modifying value from mStates. This defaults to
-         * 0 for additive modifiers and 1 for multiplicative modifiers.
+         * Stores the effective modifying value from the states. This
+         * defaults to 0 for additive modifiers and 1 for multiplicative
+         * modifiers.
          */
         double mMod;
         const StackableType mStackableType;
@@ -183,9 +217,22 @@ class Attribute
         void clearMods();
 
         /**
-         * tick() processes all timers associated with modifiers for this attribute.
+         * expire() removes the modifiers of this attribute expired by the
+         * current tick.
+         * @returns Whether the modified attribute value was changed.
+         */
+        bool expire();
+
+        /**
+         * Returns whether some modifiers of this attribute expire.
+         */
+        bool hasTimedModifiers() const;
+
+        /**
+         * Returns the tick at which the next modifier of this attribute
+         * expires, or 0 when none expires.
          */
-        bool tick();
+        int getNextExpiry() const;
 
     private:
         /**
@@ -63,7 +63,8 @@ struct AttributeInfo
         persistent(false),
         minimum(std::numeric_limits<double>::min()),
         maximum(std::numeric_limits<double>::max()),
-        modifiable(false)
+        modifiable(false),
+        slot(0)
     {}
 
     int id;
@@ -73,6 +74,9 @@ struct AttributeInfo
     double maximum;
     bool modifiable;
     std::vector<AttributeModifier> modifiers;
+
+    /** Dense index of the attribute, set by the AttributeManager. */
+    unsigned slot;
 };
 
 #endif /* ATTRIBUTEINFO_H_ */
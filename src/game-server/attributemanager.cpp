@@ -43,6 +43,7 @@ void AttributeManager::deinitialize()
     for (auto &it : mAttributeMap)
         delete it.second;
     mAttributeMap.clear();
+    mAttributeCount = 0;
 
     for (unsigned i = 0; i < MaxScope; ++i)
         mAttributeScopes[i].clear();
@@ -167,6 +168,7 @@ void AttributeManager::readAttributeNode(xmlNodePtr attributeNode)
         }
     }
 
+    attribute->slot = mAttributeCount++;
     mAttributeMap[id] = attribute;
     mAttributeNameMap[name] = attribute;
 }
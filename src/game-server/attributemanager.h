@@ -62,6 +62,7 @@ class AttributeManager
 {
     public:
         AttributeManager()
+            : mAttributeCount(0)
         {}
 
         /**
@@ -80,6 +81,13 @@ class AttributeManager
 
         const std::set<AttributeInfo *> &getAttributeScope(ScopeType) const;
 
+        /**
+         * Returns the number of attributes, which is one more than the
+         * highest AttributeInfo::slot.
+         */
+        unsigned getAttributeCount() const
+        { return mAttributeCount; }
+
         ModifierLocation getLocation(const std::string &tag) const;
 
         const std::string *getTag(const ModifierLocation &location) const;
@@ -98,6 +106,8 @@ class AttributeManager
         utils::NameMap<AttributeInfo *> mAttributeNameMap;
 
         std::map<std::string, ModifierLocation> mTagMap;
+
+        unsigned mAttributeCount;
 };
 
 extern AttributeManager *attributeManager;
@@ -18,7 +18,12 @@
  *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <limits>
+
+#include <sigc++/adaptors/bind.h>
 
 #include "game-server/being.h"
 
@@ -29,8 +34,13 @@
 #include "game-server/collisiondetection.h"
 #include "game-server/mapcomposite.h"
 #include "game-server/effect.h"
+#include "game-server/flowfield.h"
+#include "game-server/pathscheduler.h"
+#include "game-server/state.h"
 #include "game-server/statuseffect.h"
 #include "game-server/statusmanager.h"
+#include "game-server/tickprofiler.h"
+#include "game-server/timerwheel.h"
 #include "utils/logger.h"
 #include "utils/speedconv.h"
 #include "scripting/scriptmanager.h"
@@ -40,20 +50,31 @@ Script::Ref BeingComponent::mRecalculateDerivedAttributesCallback;
 Script::Ref BeingComponent::mRecalculateBaseAttributeCallback;
 
 BeingComponent::BeingComponent(Entity &entity):
-    mMoveTime(0),
     mAction(STAND),
     mGender(GENDER_UNSPECIFIED),
+    mPathIndex(0),
+    mMoveFractionX(0),
+    mMoveFractionY(0),
+    mPathGeneration(0),
+    mPathRequest(0),
+    mFollowFlow(false),
     mDirection(DOWN),
-    mEmoteId(0)
+    mEmoteId(0),
+    mAttributeIndices(attributeManager->getAttributeCount(), -1),
+    mModifierTimer(0),
+    mModifierTimerTick(0),
+    mStatusTimer(0),
+    mUpdatingDerivedAttributes(false)
 {
     auto &attributeScope = attributeManager->getAttributeScope(BeingScope);
     LOG_DEBUG("Being creation: initialisation of " << attributeScope.size()
               << " attributes.");
+    mAttributes.reserve(attributeScope.size());
     for (auto &attribute : attributeScope)
     {
         LOG_DEBUG("Attempting to create attribute '"
                   << attribute->id << "'.");
-        mAttributes.insert(std::make_pair(attribute, Attribute(attribute)));
+        createAttribute(attribute);
     }
 
     clearDestination(entity);
@@ -74,6 +95,15 @@ BeingComponent::BeingComponent(Entity &entity):
 #endif
 }
 
+BeingComponent::~BeingComponent()
+{
+    clearPath();
+
+    TimerWheel &timers = GameState::getTimers();
+    timers.cancel(mModifierTimer);
+    timers.cancel(mStatusTimer);
+}
+
 void BeingComponent::triggerEmote(Entity &entity, int id)
 {
     mEmoteId = id;
@@ -86,9 +116,13 @@ void BeingComponent::triggerEmote(Entity &entity, int id)
 
 void BeingComponent::heal(Entity &entity)
 {
+    // The maximum may depend on attributes changed since the last update
+    updateDerivedAttributes(entity);
+
     auto *hpAttribute = attributeManager->getAttributeInfo(ATTR_HP);
-    Attribute &hp = mAttributes.at(hpAttribute);
-    Attribute &maxHp = mAttributes.at(attributeManager->getAttributeInfo(ATTR_MAX_HP));
+    Attribute &hp = *findAttribute(hpAttribute);
+    Attribute &maxHp =
+            *findAttribute(attributeManager->getAttributeInfo(ATTR_MAX_HP));
     if (maxHp.getModifiedAttribute() == hp.getModifiedAttribute())
         return; // Full hp, do nothing.
 
@@ -99,10 +133,12 @@ void BeingComponent::heal(Entity &entity)
 
 void BeingComponent::heal(Entity &entity, int gain)
 {
+    updateDerivedAttributes(entity);
+
     auto *hpAttribute = attributeManager->getAttributeInfo(ATTR_HP);
     auto *maxHpAttribute = attributeManager->getAttributeInfo(ATTR_MAX_HP);
-    Attribute &hp = mAttributes.at(hpAttribute);
-    Attribute &maxHp = mAttributes.at(maxHpAttribute);
+    Attribute &hp = *findAttribute(hpAttribute);
+    Attribute &maxHp = *findAttribute(maxHpAttribute);
     if (maxHp.getModifiedAttribute() == hp.getModifiedAttribute())
         return; // Full hp, do nothing.
 
@@ -123,6 +159,9 @@ void BeingComponent::died(Entity &entity)
     // dead beings stay where they are
     clearDestination(entity);
 
+    // Status effects are removed on the next tick
+    scheduleStatusTimer(entity);
+
     signal_died.emit(&entity);
 }
 
@@ -131,7 +170,28 @@ void BeingComponent::setDestination(Entity &entity, const Point &dst)
     mDst = dst;
     entity.getComponent<ActorComponent>()->raiseUpdateFlags(
             UPDATEFLAG_NEW_DESTINATION);
+    clearPath();
+    mFollowFlow = false;
+}
+
+void BeingComponent::clearPath()
+{
     mPath.clear();
+    mPathIndex = 0;
+    mMoveFractionX = 0;
+    mMoveFractionY = 0;
+
+    if (mPathRequest)
+    {
+        PathScheduler::cancel(mPathRequest);
+        mPathRequest = 0;
+    }
+}
+
+void BeingComponent::setFlowDestination(Entity &entity, const Point &dst)
+{
+    setDestination(entity, dst);
+    mFollowFlow = true;
 }
 
 void BeingComponent::clearDestination(Entity &entity)
@@ -147,8 +207,40 @@ void BeingComponent::setDirection(Entity &entity, BeingDirection direction)
             UPDATEFLAG_DIRCHANGE);
 }
 
-Path BeingComponent::findPath(Entity &entity)
+static int getMaxPathCost()
+{
+    static const int maxCost =
+            Configuration::getValue("game_maxPathCost", 20);
+    return maxCost;
+}
+
+void BeingComponent::findPath(Entity &entity)
+{
+    auto *actorComponent = entity.getComponent<ActorComponent>();
+
+    Map *map = entity.getMap()->getMap();
+    int tileWidth = map->getTileWidth();
+    int tileHeight = map->getTileHeight();
+    int startX = actorComponent->getPosition().x / tileWidth;
+    int startY = actorComponent->getPosition().y / tileHeight;
+    int destX = mDst.x / tileWidth, destY = mDst.y / tileHeight;
+
+    map->findCachedPath(startX, startY, destX, destY,
+                        actorComponent->getWalkMask(), getMaxPathCost(),
+                        mPath);
+}
+
+bool BeingComponent::requestPath(Entity &entity)
 {
+    if (mPathRequest)
+    {
+        if (!PathScheduler::takeResult(mPathRequest, mPath))
+            return false;
+
+        mPathRequest = 0;
+        return true;
+    }
+
     auto *actorComponent = entity.getComponent<ActorComponent>();
 
     Map *map = entity.getMap()->getMap();
@@ -158,8 +250,58 @@ Path BeingComponent::findPath(Entity &entity)
     int startY = actorComponent->getPosition().y / tileHeight;
     int destX = mDst.x / tileWidth, destY = mDst.y / tileHeight;
 
-    return map->findPath(startX, startY, destX, destY,
-                         actorComponent->getWalkMask());
+    // Players notice waiting more than monsters do
+    const int priority = entity.getType() == OBJECT_CHARACTER ? 1 : 0;
+
+    mPathRequest = PathScheduler::findPath(map, startX, startY, destX, destY,
+                                           actorComponent->getWalkMask(),
+                                           getMaxPathCost(), priority, mPath);
+    return !mPathRequest;
+}
+
+bool BeingComponent::followFlow(Entity &entity)
+{
+    static const int radius =
+            Configuration::getValue("game_flowFieldRadius", 32);
+
+    // Keep waiting for the search queued when the field could not be used
+    if (mPathRequest)
+        return requestPath(entity);
+
+    auto *actorComponent = entity.getComponent<ActorComponent>();
+
+    Map *map = entity.getMap()->getMap();
+    int tileWidth = map->getTileWidth();
+    int tileHeight = map->getTileHeight();
+    int startX = actorComponent->getPosition().x / tileWidth;
+    int startY = actorComponent->getPosition().y / tileHeight;
+    int destX = mDst.x / tileWidth, destY = mDst.y / tileHeight;
+
+    const unsigned char walkmask = actorComponent->getWalkMask();
+
+    // Building a field counts against the path search budget of the tick
+    const bool build = PathScheduler::hasBudget();
+    const TickProfiler::Clock::time_point start = TickProfiler::Clock::now();
+    const FlowField *field = map->getFlowField(destX, destY, walkmask, radius,
+                                               GameState::getCurrentTick(),
+                                               build);
+    if (build)
+        PathScheduler::charge(TickProfiler::elapsed(start));
+
+    if (!field || field->getCost(startX, startY) < 0)
+        return requestPath(entity);
+
+    field->getPath(startX, startY, walkmask, mPath);
+
+    // Stop in the middle of the last tile when blocked on the way
+    if (!mPath.empty() &&
+        (mPath.back().x != destX || mPath.back().y != destY))
+    {
+        mDst.x = mPath.back().x * tileWidth + tileWidth / 2;
+        mDst.y = mPath.back().y * tileHeight + tileHeight / 2;
+        actorComponent->raiseUpdateFlags(UPDATEFLAG_NEW_DESTINATION);
+    }
+    return true;
 }
 
 void BeingComponent::updateDirection(Entity &entity,
@@ -197,13 +339,6 @@ void BeingComponent::move(Entity &entity)
     if ((mAction == STAND && mDst == mOld) || mAction == DEAD)
         return;
 
-    if (mMoveTime > WORLD_TICK_MS)
-    {
-        // Current move has not yet ended
-        mMoveTime -= WORLD_TICK_MS;
-        return;
-    }
-
     Map *map = entity.getMap()->getMap();
     int tileWidth = map->getTileWidth();
     int tileHeight = map->getTileHeight();
@@ -220,33 +355,58 @@ void BeingComponent::move(Entity &entity)
         // We only update the direction in that case.
         updateDirection(entity, mOld, mDst);
         entity.getComponent<ActorComponent>()->setPosition(entity, mDst);
-        mMoveTime = 0;
+        clearPath();
         return;
     }
 
+    const unsigned char walkmask =
+            entity.getComponent<ActorComponent>()->getWalkMask();
+
     /* If no path exists, the for-loop won't be entered. Else a path for the
      * current destination has already been calculated.
-     * The tiles in this path have to be checked for walkability,
-     * in case there have been changes. The 'getWalk' method of the Map
-     * class has been used, because that seems to be the most logical
-     * place extra functionality will be added.
+     * The lines to the next few points of this path have to be checked for
+     * walkability, in case beings got in the way. The whole remaining path
+     * is only checked again when walls changed.
      */
-    for (Point &point : mPath)
+    static const size_t checkedPoints = 2;
+    const unsigned generation = map->getGeneration(Map::BLOCKMASK_WALL);
+    size_t checkEnd = std::min(mPath.size(), mPathIndex + checkedPoints);
+    if (generation != mPathGeneration)
+    {
+        checkEnd = mPath.size();
+        mPathGeneration = generation;
+    }
+
+    Point from(tileSX, tileSY);
+    for (size_t i = mPathIndex; i < checkEnd; ++i)
     {
-        const unsigned char walkmask =
-                entity.getComponent<ActorComponent>()->getWalkMask();
-        if (!map->getWalk(point.x, point.y, walkmask))
+        const Point &point = mPath[i];
+        if (!map->isLineWalkable(from.x, from.y, point.x, point.y, walkmask))
         {
-            mPath.clear();
+            clearPath();
             break;
         }
+        from = point;
     }
 
     if (mPath.empty())
     {
         // No path exists: the walkability of cached path has changed, the
         // destination has changed, or a path was never set.
-        mPath = findPath(entity);
+        if (mPath.capacity() == 0)
+            mPath.reserve(getMaxPathCost());
+
+        const bool found = mFollowFlow ? followFlow(entity)
+                                       : requestPath(entity);
+        if (!found)
+            return;     // Wait for the scheduler to find the path
+        mPathIndex = 0;
+        mPathGeneration = map->getGeneration(Map::BLOCKMASK_WALL);
+
+        static const bool smoothing =
+                Configuration::getBoolValue("game_pathSmoothing", false);
+        if (smoothing)
+            map->smoothPath(tileSX, tileSY, mPath, walkmask);
     }
 
     if (mPath.empty())
@@ -255,40 +415,61 @@ void BeingComponent::move(Entity &entity)
             setAction(entity, STAND);
         // no path was found
         mDst = mOld;
-        mMoveTime = 0;
         return;
     }
 
     setAction(entity, WALK);
 
-    Point prev(tileSX, tileSY);
-    Point pos;
-    do
+    // Walk along the path for the duration of a tick, stopping between two
+    // points when the time runs out. The speed is the time to walk a tile.
+    auto *rawSpeedAttribute =
+            attributeManager->getAttributeInfo(ATTR_MOVE_SPEED_RAW);
+    double tilesLeft = WORLD_TICK_MS / getModifiedAttribute(rawSpeedAttribute);
+
+    // The position is kept below the pixel between ticks, so that the rounding
+    // does not slow down the beings, nor stops the slowest ones
+    double posX = mOld.x + mMoveFractionX;
+    double posY = mOld.y + mMoveFractionY;
+    while (mPathIndex < mPath.size())
     {
-        Point next = mPath.front();
-        mPath.pop_front();
-
-        auto *rawSpeedAttribute = attributeManager->getAttributeInfo(ATTR_MOVE_SPEED_RAW);
-        // SQRT2 is used for diagonal movement.
-        mMoveTime += (prev.x == next.x || prev.y == next.y) ?
-                       getModifiedAttribute(rawSpeedAttribute) :
-                       getModifiedAttribute(rawSpeedAttribute) * SQRT2;
-
-        if (mPath.empty())
+        Point next;
+        if (mPathIndex + 1 == mPath.size())
         {
             // skip last tile center
-            pos = mDst;
+            next = mDst;
+        }
+        else
+        {
+            // Walk to the middle of the tiles for pathfinding purposes
+            next.x = mPath[mPathIndex].x * tileWidth + (tileWidth / 2);
+            next.y = mPath[mPathIndex].y * tileHeight + (tileHeight / 2);
+        }
+
+        const double dx = (next.x - posX) / tileWidth;
+        const double dy = (next.y - posY) / tileHeight;
+        const double distance = std::sqrt(dx * dx + dy * dy);
+        if (distance > tilesLeft)
+        {
+            const double ratio = tilesLeft / distance;
+            posX += (next.x - posX) * ratio;
+            posY += (next.y - posY) * ratio;
             break;
         }
 
-        // Position the actor in the middle of the tile for pathfinding purposes
-        pos.x = next.x * tileWidth + (tileWidth / 2);
-        pos.y = next.y * tileHeight + (tileHeight / 2);
+        tilesLeft -= distance;
+        posX = next.x;
+        posY = next.y;
+        ++mPathIndex;
     }
-    while (mMoveTime < WORLD_TICK_MS);
-    entity.getComponent<ActorComponent>()->setPosition(entity, pos);
 
-    mMoveTime = mMoveTime > WORLD_TICK_MS ? mMoveTime - WORLD_TICK_MS : 0;
+    const Point pos((int) std::lround(posX), (int) std::lround(posY));
+    mMoveFractionX = posX - pos.x;
+    mMoveFractionY = posY - pos.y;
+
+    if (mPathIndex == mPath.size())
+        clearPath();
+
+    entity.getComponent<ActorComponent>()->setPosition(entity, pos);
 
     // Update the being direction also
     updateDirection(entity, mOld, pos);
@@ -321,15 +502,78 @@ void BeingComponent::applyModifier(Entity &entity, AttributeInfo *attribute,
                                    double value, unsigned layer,
                                    unsigned duration, unsigned id)
 {
-    mAttributes.at(attribute).add(duration, value, layer, id);
+    Attribute *attr = findAttribute(attribute);
+    attr->add(duration, value, layer, id);
+    if (duration)
+    {
+        if (std::find(mTimedAttributes.begin(), mTimedAttributes.end(),
+                      attribute) == mTimedAttributes.end())
+            mTimedAttributes.push_back(attribute);
+        scheduleModifierTimer(entity, attr->getNextExpiry());
+    }
     updateDerivedAttributes(entity, attribute);
 }
 
+void BeingComponent::scheduleModifierTimer(Entity &entity, int expireTick)
+{
+    TimerWheel &timers = GameState::getTimers();
+    if (timers.isPending(mModifierTimer) && mModifierTimerTick <= expireTick)
+        return;
+
+    timers.cancel(mModifierTimer);
+    mModifierTimerTick = expireTick;
+    mModifierTimer = timers.schedule(
+            expireTick - GameState::getCurrentTick(),
+            sigc::bind(sigc::mem_fun(this, &BeingComponent::expireModifiers),
+                       &entity));
+}
+
+void BeingComponent::expireModifiers(Entity *entity)
+{
+    // A timer parked on an inactive map may fire while a newer one waits,
+    // which is scheduled again below
+    GameState::getTimers().cancel(mModifierTimer);
+    mModifierTimer = 0;
+
+    MapComposite *map = entity->getMap();
+    if (!map->isActive())
+    {
+        map->parkTimer(sigc::bind(
+                sigc::mem_fun(this, &BeingComponent::expireModifiers),
+                entity));
+        return;
+    }
+
+    int nextExpiry = 0;
+    for (unsigned i = 0; i < mTimedAttributes.size(); )
+    {
+        AttributeInfo *attributeInfo = mTimedAttributes[i];
+        Attribute *attribute = findAttribute(attributeInfo);
+        if (attribute->expire())
+            updateDerivedAttributes(*entity, attributeInfo);
+
+        if (const int expireTick = attribute->getNextExpiry())
+        {
+            if (!nextExpiry || expireTick < nextExpiry)
+                nextExpiry = expireTick;
+            ++i;
+        }
+        else
+        {
+            mTimedAttributes[i] = mTimedAttributes.back();
+            mTimedAttributes.pop_back();
+        }
+    }
+
+    if (nextExpiry)
+        scheduleModifierTimer(*entity, nextExpiry);
+}
+
 bool BeingComponent::removeModifier(Entity &entity, AttributeInfo *attribute,
                                     double value, unsigned layer,
                                     unsigned id, bool fullcheck)
 {
-    bool ret = mAttributes.at(attribute).remove(value, layer, id, fullcheck);
+    bool ret = findAttribute(attribute)->remove(value, layer, id, fullcheck);
     updateDerivedAttributes(entity, attribute);
     return ret;
 }
@@ -343,8 +587,8 @@ void BeingComponent::setAttribute(Entity &entity,
                                   AttributeInfo *attribute,
                                   double value)
 {
-    auto attributeIt = mAttributes.find(attribute);
-    if (attributeIt == mAttributes.end())
+    Attribute *attr = findAttribute(attribute);
+    if (!attr)
     {
         /*
          * The attribute does not yet exist, so we must attempt to create it.
@@ -356,52 +600,73 @@ void BeingComponent::setAttribute(Entity &entity,
     }
     else
     {
-        attributeIt->second.setBase(value);
+        attr->setBase(value);
         updateDerivedAttributes(entity, attribute);
     }
 }
 
 void BeingComponent::createAttribute(AttributeInfo *attributeInfo)
 {
-    mAttributes.insert(std::pair<AttributeInfo *, Attribute>
-            (attributeInfo, Attribute(attributeInfo)));
+    if (findAttribute(attributeInfo))
+        return;
+
+    if (attributeInfo->slot >= mAttributeIndices.size())
+        mAttributeIndices.resize(attributeInfo->slot + 1, -1);
+
+    mAttributeIndices[attributeInfo->slot] = mAttributes.size();
+    mAttributes.push_back(std::make_pair(attributeInfo,
+                                         Attribute(attributeInfo)));
+}
+
+Attribute *BeingComponent::findAttribute(const AttributeInfo *info)
+{
+    if (!info || info->slot >= mAttributeIndices.size())
+        return 0;
+
+    const int index = mAttributeIndices[info->slot];
+    return index < 0 ? 0 : &mAttributes[index].second;
+}
+
+const Attribute *BeingComponent::findAttribute(const AttributeInfo *info) const
+{
+    return const_cast<BeingComponent *>(this)->findAttribute(info);
 }
 
 const Attribute *BeingComponent::getAttribute(AttributeInfo *attribute) const
 {
-    AttributeMap::const_iterator ret = mAttributes.find(attribute);
-    if (ret == mAttributes.end())
+    const Attribute *ret = findAttribute(attribute);
+    if (!ret)
     {
         LOG_DEBUG("BeingComponent::getAttribute: Attribute "
                   << attribute->id << " not found! Returning 0.");
         return 0;
     }
-    return &ret->second;
+    return ret;
 }
 
 double BeingComponent::getAttributeBase(AttributeInfo *attribute) const
 {
-    AttributeMap::const_iterator ret = mAttributes.find(attribute);
-    if (ret == mAttributes.end())
+    const Attribute *ret = findAttribute(attribute);
+    if (!ret)
     {
         LOG_DEBUG("BeingComponent::getAttributeBase: Attribute "
                   << attribute->id << " not found! Returning 0.");
         return 0;
     }
-    return ret->second.getBase();
+    return ret->getBase();
 }
 
 
 double BeingComponent::getModifiedAttribute(AttributeInfo *attribute) const
 {
-    AttributeMap::const_iterator ret = mAttributes.find(attribute);
-    if (ret == mAttributes.end())
+    const Attribute *ret = findAttribute(attribute);
+    if (!ret)
     {
         LOG_DEBUG("BeingComponent::getModifiedAttribute: Attribute "
                   << attribute->id << " not found! Returning 0.");
         return 0;
     }
-    return ret->second.getModifiedAttribute();
+    return ret->getModifiedAttribute();
 }
 
 void BeingComponent::recalculateBaseAttribute(Entity &entity,
@@ -409,7 +674,7 @@ void BeingComponent::recalculateBaseAttribute(Entity &entity,
 {
     LOG_DEBUG("Being: Received update attribute recalculation request for "
               << attribute << ".");
-    if (!mAttributes.count(attribute))
+    if (!findAttribute(attribute))
     {
         LOG_DEBUG("BeingComponent::recalculateBaseAttribute: " << attribute->id << " not found!");
         return;
@@ -439,11 +704,7 @@ void BeingComponent::recalculateBaseAttribute(Entity &entity,
 void BeingComponent::updateDerivedAttributes(Entity &entity,
                                              AttributeInfo *attribute)
 {
-    signal_attribute_changed.emit(&entity, attribute);
-
-    LOG_DEBUG("Being: Updating derived attribute(s) of: " << attribute);
-
-    // Handle default actions before handing over to the script engine
+    // Handle default actions right away, the rest waits for the next update
     switch (attribute->id)
     {
     case ATTR_MAX_HP:
@@ -459,17 +720,56 @@ void BeingComponent::updateDerivedAttributes(Entity &entity,
         break;
     }
 
-    if (!mRecalculateDerivedAttributesCallback.isValid())
+    if (std::find(mChangedAttributes.begin(), mChangedAttributes.end(),
+                  attribute) == mChangedAttributes.end())
+        mChangedAttributes.push_back(attribute);
+}
+
+void BeingComponent::updateDerivedAttributes(Entity &entity)
+{
+    // The scripts may read attributes while recalculating them
+    if (mUpdatingDerivedAttributes)
         return;
+    mUpdatingDerivedAttributes = true;
+
+    // Recalculating may change further attributes, which are handled in the
+    // next round. A limit guards against attributes depending on each other.
+    static const int MAX_ROUNDS = 16;
+    std::vector<AttributeInfo *> changed;
+    int rounds = 0;
+    while (!mChangedAttributes.empty() && rounds++ < MAX_ROUNDS)
+    {
+        changed.swap(mChangedAttributes);
+        for (AttributeInfo *attribute : changed)
+        {
+            signal_attribute_changed.emit(&entity, attribute);
 
-    Script *script = ScriptManager::currentState();
-    script->prepare(mRecalculateDerivedAttributesCallback);
-    script->push(&entity);
-    script->push(attribute);
-    script->execute(entity.getMap());
+            LOG_DEBUG("Being: Updating derived attribute(s) of: "
+                      << attribute);
+
+            if (!mRecalculateDerivedAttributesCallback.isValid())
+                continue;
+
+            Script *script = ScriptManager::currentState();
+            script->prepare(mRecalculateDerivedAttributesCallback);
+            script->push(&entity);
+            script->push(attribute);
+            script->execute(entity.getMap());
+        }
+        changed.clear();
+    }
+
+    if (!mChangedAttributes.empty())
+    {
+        LOG_WARN("Being: Derived attributes still changing after "
+                 << MAX_ROUNDS << " rounds, dependencies may be circular.");
+        mChangedAttributes.clear();
+    }
+
+    mUpdatingDerivedAttributes = false;
 }
 
-void BeingComponent::applyStatusEffect(int id, int timer)
+void BeingComponent::applyStatusEffect(Entity &entity, int id, int timer)
 {
     if (mAction == DEAD)
         return;
@@ -478,8 +778,9 @@ void BeingComponent::applyStatusEffect(int id, int timer)
     {
         Status newStatus;
         newStatus.status = statusEffect;
-        newStatus.time = timer;
+        newStatus.expiry.set(timer);
         mStatus[id] = newStatus;
+        scheduleStatusTimer(entity);
     }
     else
     {
@@ -487,9 +788,9 @@ void BeingComponent::applyStatusEffect(int id, int timer)
     }
 }
 
-void BeingComponent::removeStatusEffect(int id)
+void BeingComponent::removeStatusEffect(Entity &entity, int id)
 {
-    setStatusEffectTime(id, 0);
+    setStatusEffectTime(entity, id, 0);
 }
 
 bool BeingComponent::hasStatusEffect(int id) const
@@ -505,18 +806,90 @@ bool BeingComponent::hasStatusEffect(int id) const
 unsigned BeingComponent::getStatusEffectTime(int id) const
 {
     StatusEffects::const_iterator it = mStatus.find(id);
-    if (it != mStatus.end()) return it->second.time;
+    if (it != mStatus.end()) return std::max(it->second.expiry.remaining(), 0);
     else return 0;
 }
 
-void BeingComponent::setStatusEffectTime(int id, int time)
+void BeingComponent::setStatusEffectTime(Entity &entity, int id, int time)
 {
     StatusEffects::iterator it = mStatus.find(id);
-    if (it != mStatus.end()) it->second.time = time;
+    if (it != mStatus.end())
+    {
+        it->second.expiry.set(time);
+        scheduleStatusTimer(entity);
+    }
+}
+
+void BeingComponent::scheduleStatusTimer(Entity &entity)
+{
+    TimerWheel &timers = GameState::getTimers();
+    timers.cancel(mStatusTimer);
+    mStatusTimer = 0;
+
+    if (mStatus.empty())
+        return;
+
+    int ticks = std::numeric_limits<int>::max();
+    if (mAction == DEAD)
+        ticks = 1;
+
+    for (auto &statusIt : mStatus)
+    {
+        const Status &status = statusIt.second;
+        if (status.status->hasTickCallback())
+            ticks = 1;
+        else
+            ticks = std::min(ticks, status.expiry.remaining());
+    }
+
+    mStatusTimer = timers.schedule(ticks, sigc::bind(
+            sigc::mem_fun(this, &BeingComponent::updateStatusEffects),
+            &entity));
+}
+
+void BeingComponent::updateStatusEffects(Entity *entity)
+{
+    // A timer parked on an inactive map may fire while a newer one waits
+    if (GameState::getTimers().isPending(mStatusTimer))
+        return;
+    mStatusTimer = 0;
+
+    MapComposite *map = entity->getMap();
+    if (!map->isActive())
+    {
+        map->parkTimer(sigc::bind(
+                sigc::mem_fun(this, &BeingComponent::updateStatusEffects),
+                entity));
+        return;
+    }
+
+    StatusEffects::iterator it = mStatus.begin();
+    while (it != mStatus.end())
+    {
+        const int time = it->second.expiry.remaining();
+        if (time > 0 && mAction != DEAD)
+            it->second.status->tick(*entity, time);
+
+        if (time <= 0 || mAction == DEAD)
+        {
+            StatusEffects::iterator removeIt = it;
+            ++it; // bring this iterator to the safety of the next element
+            mStatus.erase(removeIt);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    scheduleStatusTimer(*entity);
 }
 
 void BeingComponent::update(Entity &entity)
 {
+    // Catch up on changes made since the last update
+    updateDerivedAttributes(entity);
+
     auto *hpAttribute = attributeManager->getAttributeInfo(ATTR_HP);
 
     int oldHP = getModifiedAttribute(hpAttribute);
@@ -542,34 +915,9 @@ void BeingComponent::update(Entity &entity)
                 UPDATEFLAG_HEALTHCHANGE);
     }
 
-    // Update lifetime of effects.
-    for (AttributeMap::iterator it = mAttributes.begin();
-         it != mAttributes.end();
-         ++it)
-    {
-        if (it->second.tick())
-            updateDerivedAttributes(entity, it->first);
-    }
+    // Expiring modifiers and status effects are handled by their timers
 
-    // Update and run status effects
-    StatusEffects::iterator it = mStatus.begin();
-    while (it != mStatus.end())
-    {
-        it->second.time--;
-        if (it->second.time > 0 && mAction != DEAD)
-            it->second.status->tick(entity, it->second.time);
-
-        if (it->second.time <= 0 || mAction == DEAD)
-        {
-            StatusEffects::iterator removeIt = it;
-            ++it; // bring this iterator to the safety of the next element
-            mStatus.erase(removeIt);
-        }
-        else
-        {
-            ++it;
-        }
-    }
+    updateDerivedAttributes(entity);
 
     // Check if being died
     if (getModifiedAttribute(hpAttribute) <= 0 && mAction != DEAD)
@@ -581,4 +929,7 @@ void BeingComponent::inserted(Entity *entity)
     // Reset the old position, since after insertion it is important that it is
     // in sync with the zone that we're currently present in.
     mOld = entity->getComponent<ActorComponent>()->getPosition();
+
+    // The path may have been found on another map
+    clearPath();
 }
@@ -38,12 +38,15 @@ class BeingComponent;
 class MapComposite;
 class StatusEffect;
 
-typedef std::map<AttributeInfo *, Attribute> AttributeMap;
+/**
+ * The attributes of a being, in the order they were created.
+ */
+typedef std::vector<std::pair<AttributeInfo *, Attribute> > AttributeList;
 
 struct Status
 {
     StatusEffect *status;
-    unsigned time;  // Number of ticks
+    Timeout expiry;
 };
 
 typedef std::map< int, Status > StatusEffects;
@@ -57,7 +60,7 @@ typedef std::vector<unsigned> Hits;
  * Generic being (living actor). Keeps direction, destination and a few other
  * relevant properties. Used for characters & monsters (all animated objects).
  */
-class BeingComponent : public Component
+class BeingComponent : public PooledComponent<BeingComponent>
 {
     public:
         static const ComponentType type = CT_Being;
@@ -67,6 +70,8 @@ class BeingComponent : public Component
          */
         BeingComponent(Entity &entity);
 
+        ~BeingComponent();
+
         /**
          * Update being state.
          */
@@ -94,6 +99,14 @@ class BeingComponent : public Component
          */
         void setDestination(Entity &entity, const Point &dst);
 
+        /**
+         * Sets the destination coordinates of the being, reaching them by
+         * following the flow field toward them shared with other beings
+         * instead of searching its own path. Suited to many beings walking
+         * to the same target.
+         */
+        void setFlowDestination(Entity &entity, const Point &dst);
+
         /**
          * Sets the destination coordinates of the being to the current
          * position.
@@ -130,9 +143,26 @@ class BeingComponent : public Component
         void move(Entity &entity);
 
         /**
-         * Returns the path to the being's current destination.
+         * Finds the path to the being's current destination.
+         */
+        virtual void findPath(Entity &);
+
+        /**
+         * Asks the path scheduler for the path to the being's current
+         * destination, or takes the path it found.
+         *
+         * @return whether the path is known, false while it is searched.
+         */
+        bool requestPath(Entity &);
+
+        /**
+         * Finds the path to the being's current destination by following the
+         * flow field toward it. Falls back to requestPath when the being is
+         * out of the field, or when the field cannot be built this tick.
+         *
+         * @return whether the path is known, false while it is searched.
          */
-        virtual Path findPath(Entity &);
+        bool followFlow(Entity &);
 
         /** Gets the gender of the being (male or female). */
         BeingGender getGender() const
@@ -159,7 +189,7 @@ class BeingComponent : public Component
          */
         const Attribute *getAttribute(AttributeInfo *) const;
 
-        const AttributeMap &getAttributes() const
+        const AttributeList &getAttributes() const
         { return mAttributes; }
 
         /**
@@ -168,7 +198,8 @@ class BeingComponent : public Component
         double getAttributeBase(AttributeInfo *) const;
 
         /**
-         * Gets an attribute after applying modifiers.
+         * Gets an attribute after applying modifiers. Attributes derived by
+         * the scripts are only current after updateDerivedAttributes(Entity &).
          */
         double getModifiedAttribute(AttributeInfo *) const;
 
@@ -178,7 +209,7 @@ class BeingComponent : public Component
          */
 
         bool checkAttributeExists(AttributeInfo *attribute) const
-        { return mAttributes.count(attribute); }
+        { return findAttribute(attribute); }
 
         /**
          * Adds a modifier to one attribute.
@@ -205,22 +236,31 @@ class BeingComponent : public Component
                                       AttributeInfo *);
 
         /**
-         * Attribute has changed, recalculate base value of dependant
-         *     attributes (and handle other actions for the modified
-         *     attribute)
+         * Attribute has changed. Handles the actions of the engine for the
+         *     modified attribute right away, while the base values of the
+         *     dependant attributes are recalculated by the next call to
+         *     updateDerivedAttributes(Entity &).
          */
         void updateDerivedAttributes(Entity &entity,
                                      AttributeInfo *);
 
+        /**
+         * Recalculates the base value of the attributes depending on those
+         *     changed since the last call, once for each changed attribute.
+         *     Done on each update, and needed before reading attributes
+         *     derived by the scripts right after changing others.
+         */
+        void updateDerivedAttributes(Entity &entity);
+
         /**
          * Sets a statuseffect on this being
          */
-        void applyStatusEffect(int id, int time);
+        void applyStatusEffect(Entity &entity, int id, int time);
 
         /**
          * Removes the status effect
          */
-        void removeStatusEffect(int id);
+        void removeStatusEffect(Entity &entity, int id);
 
         /**
          * Returns true if the being has a status effect
@@ -238,7 +278,7 @@ class BeingComponent : public Component
         /**
          * Changes the time of the status effect (if in effect)
          */
-        void setStatusEffectTime(int id, int time);
+        void setStatusEffectTime(Entity &entity, int id, int time);
 
         /** Gets the name of the being. */
         const std::string &getName() const
@@ -288,10 +328,8 @@ class BeingComponent : public Component
     protected:
         static const int TICKS_PER_HP_REGENERATION = 100;
 
-        /** Delay until move to next tile in miliseconds. */
-        unsigned short mMoveTime;
         BeingAction mAction;
-        AttributeMap mAttributes;
+        AttributeList mAttributes;
         StatusEffects mStatus;
         Point mOld;                 /**< Old coordinates. */
         Point mDst;                 /**< Target coordinates. */
@@ -303,7 +341,51 @@ class BeingComponent : public Component
          */
         void inserted(Entity *);
 
+        /**
+         * Drops the path and any search for it.
+         */
+        void clearPath();
+
+        /**
+         * Makes sure the modifier timer fires by \a expireTick.
+         */
+        void scheduleModifierTimer(Entity &entity, int expireTick);
+
+        /**
+         * Called by the modifier timer to remove the expired modifiers.
+         */
+        void expireModifiers(Entity *entity);
+
+        /**
+         * Sets the status timer to fire on the next tick when a status effect
+         * ticks or expires.
+         */
+        void scheduleStatusTimer(Entity &entity);
+
+        /**
+         * Called by the status timer to tick the status effects and remove
+         * the expired ones.
+         */
+        void updateStatusEffects(Entity *entity);
+
+        /**
+         * Returns the attribute described by \a info, or null when the being
+         * does not have it.
+         */
+        Attribute *findAttribute(const AttributeInfo *info);
+        const Attribute *findAttribute(const AttributeInfo *info) const;
+
+        /**
+         * Tiles or waypoints to walk through. The storage is kept between
+         * paths, which are copied into it.
+         */
         Path mPath;
+        size_t mPathIndex;          /**< Next point of the path. */
+        double mMoveFractionX;      /**< Position below the pixel. */
+        double mMoveFractionY;
+        unsigned mPathGeneration;   /**< Walls the path was checked with. */
+        unsigned mPathRequest;      /**< Path searched, see PathScheduler. */
+        bool mFollowFlow;           /**< Whether to use flow fields. */
         BeingDirection mDirection;   /**< Facing direction. */
 
         std::string mName;
@@ -316,6 +398,19 @@ class BeingComponent : public Component
 
         Hits mHitsTaken;            //List of punches taken since last update.
 
+        /** Index in mAttributes of each attribute slot, -1 when missing. */
+        std::vector<int> mAttributeIndices;
+
+        /** Attributes with modifiers that expire. */
+        std::vector<AttributeInfo *> mTimedAttributes;
+        unsigned mModifierTimer;    /**< Fires when modifiers expire. */
+        int mModifierTimerTick;     /**< Tick mModifierTimer fires at. */
+        unsigned mStatusTimer;      /**< Fires when status effects tick. */
+
+        /** Attributes changed since updateDerivedAttributes last ran. */
+        std::vector<AttributeInfo *> mChangedAttributes;
+        bool mUpdatingDerivedAttributes;
+
         /** Called when derived attributes need to get calculated */
         static Script::Ref mRecalculateDerivedAttributesCallback;
 
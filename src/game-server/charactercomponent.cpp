@@ -147,7 +147,7 @@ void CharacterComponent::deserialize(Entity &entity, MessageIn &msg)
     {
         int status = msg.readInt16();
         int time = msg.readInt16();
-        beingComponent->applyStatusEffect(status, time);
+        beingComponent->applyStatusEffect(entity, status, time);
     }
 
     // location
@@ -173,7 +173,7 @@ void CharacterComponent::deserialize(Entity &entity, MessageIn &msg)
     for (int i = 0; i < abilitiesSize; i++)
     {
         const int id = msg.readInt32();
-        entity.getComponent<AbilityComponent>()->giveAbility(id);
+        entity.getComponent<AbilityComponent>()->giveAbility(entity, id);
     }
 
     // questlog
@@ -220,7 +220,7 @@ void CharacterComponent::serialize(Entity &entity, MessageOut &msg)
     msg.writeInt16(getCorrectionPoints());
 
 
-    const AttributeMap &attributes = beingComponent->getAttributes();
+    const AttributeList &attributes = beingComponent->getAttributes();
     std::map<const AttributeInfo *, const Attribute *> attributesToSend;
     for (auto &attributeIt : attributes)
     {
@@ -242,7 +242,7 @@ void CharacterComponent::serialize(Entity &entity, MessageOut &msg)
     for (auto &statusIt : statusEffects)
     {
         msg.writeInt16(statusIt.first);
-        msg.writeInt16(statusIt.second.time);
+        msg.writeInt16(statusIt.second.expiry.remaining());
     }
 
     // location
@@ -314,6 +314,7 @@ void CharacterComponent::respawn(Entity &entity)
         return;
 
     // No script respawn callback set - fall back to hardcoded logic
+    beingComponent->updateDerivedAttributes(entity);
     const double maxHp = beingComponent->getModifiedAttribute(
             attributeManager->getAttributeInfo(ATTR_MAX_HP));
     beingComponent->setAttribute(entity,
@@ -70,7 +70,7 @@ struct QuestInfo
 /**
  * The representation of a player's character in the game world.
  */
-class CharacterComponent : public Component
+class CharacterComponent : public PooledComponent<CharacterComponent>
 {
     public:
         static const ComponentType type = CT_Character;
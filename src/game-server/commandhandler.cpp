@@ -34,6 +34,7 @@
 #include "game-server/monstermanager.h"
 #include "game-server/abilitymanager.h"
 #include "game-server/state.h"
+#include "game-server/tickprofiler.h"
 
 #include "scripting/scriptmanager.h"
 
@@ -87,6 +88,7 @@ static void handleRechargeAbility(Entity*, std::string&);
 static void handleListAbility(Entity*, std::string&);
 static void handleSetAttributePoints(Entity*, std::string&);
 static void handleSetCorrectionPoints(Entity*, std::string&);
+static void handleTickStats(Entity*, std::string&);
 
 static CmdRef const cmdRef[] =
 {
@@ -170,6 +172,9 @@ static CmdRef const cmdRef[] =
         "Sets the attribute points of a character.", &handleSetAttributePoints},
     {"setcorrectionpoints", "<character> <amount>",
         "Sets the correction points of a character.", &handleSetCorrectionPoints},
+    {"tickstats", "[maps [<number of maps>]]",
+        "Shows the time spent in the phases of the world ticks, or the "
+        "maps taking the most time.", &handleTickStats},
     {nullptr, nullptr, nullptr, nullptr}
 
 };
@@ -1606,7 +1611,8 @@ static void handleGiveAbility(Entity *player, std::string &args)
         abilityId = abilityManager->getId(ability);
 
     if (abilityId <= 0 ||
-        !other->getComponent<AbilityComponent>()->giveAbility(abilityId))
+        !other->getComponent<AbilityComponent>()->giveAbility(*other,
+                                                              abilityId))
     {
         say("Invalid ability.", player);
         return;
@@ -1692,7 +1698,8 @@ static void handleRechargeAbility(Entity *player, std::string &args)
         say("Invalid ability.", player);
         return;
     }
-    other->getComponent<AbilityComponent>()->setAbilityCooldown(abilityId, 0);
+    auto *abilityComponent = other->getComponent<AbilityComponent>();
+    abilityComponent->setAbilityCooldown(*other, abilityId, 0);
 }
 
 static void handleListAbility(Entity *player, std::string &args)
@@ -1798,6 +1805,42 @@ static void handleSetCorrectionPoints(Entity *player, std::string &args)
     characterComponent->setCorrectionPoints(utils::stringToInt(correctionPoints));
 }
 
+static void handleTickStats(Entity *player, std::string &args)
+{
+    std::string type = getArgument(args);
+    std::vector<std::string> lines;
+
+    if (type.empty())
+    {
+        lines = TickProfiler::getPhaseReport();
+    }
+    else if (type == "maps")
+    {
+        std::string count = getArgument(args);
+        if (!count.empty() && !utils::isNumeric(count))
+        {
+            say("Invalid number of maps given.", player);
+            return;
+        }
+        lines = TickProfiler::getMapReport(
+                    count.empty() ? 5 : utils::stringToInt(count));
+        if (lines.empty())
+            lines.push_back("No map timings recorded yet.");
+    }
+    else
+    {
+        say("Invalid argument given.", player);
+        say("Usage: @tickstats [maps [<number of maps>]]", player);
+        return;
+    }
+
+    for (std::vector<std::string>::const_iterator it = lines.begin(),
+         it_end = lines.end(); it != it_end; ++it)
+    {
+        say(*it, player);
+    }
+}
+
 void CommandHandler::handleCommand(Entity *player,
                                    const std::string &command)
 {
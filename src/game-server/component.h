@@ -21,6 +21,8 @@
 #ifndef COMPONENT_H
 #define COMPONENT_H
 
+#include "game-server/componentpool.h"
+
 #include <sigc++/trackable.h>
 
 class Entity;
@@ -60,4 +62,29 @@ public:
     virtual void update(Entity &entity) = 0;
 };
 
+/**
+ * Base of the components of type \a T, which allocates them from a pool of
+ * their own.
+ */
+template <class T>
+class PooledComponent : public Component
+{
+public:
+    static void *operator new(std::size_t size)
+    { return getPool().allocate(size); }
+
+    static void operator delete(void *object, std::size_t size)
+    { getPool().deallocate(object, size); }
+
+    /**
+     * Returns the pool the components of type \a T come from.
+     */
+    static ComponentPool &getPool()
+    {
+        // Never destroyed, since entities may outlive static objects
+        static ComponentPool *pool = new ComponentPool(sizeof(T));
+        return *pool;
+    }
+};
+
 #endif // COMPONENT_H
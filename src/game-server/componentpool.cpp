@@ -0,0 +1,84 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "game-server/componentpool.h"
+
+#include <new>
+
+ComponentPool::ComponentPool(std::size_t objectSize):
+    mFreeSlots(nullptr),
+    mUsed(0)
+{
+    // Keep the slots aligned for any object and large enough to link them
+    const std::size_t alignment = alignof(std::max_align_t);
+    if (objectSize < sizeof(void *))
+        objectSize = sizeof(void *);
+    mSlotSize = (objectSize + alignment - 1) / alignment * alignment;
+}
+
+ComponentPool::~ComponentPool()
+{
+    for (char *chunk : mChunks)
+        ::operator delete(chunk);
+}
+
+void *ComponentPool::allocate(std::size_t size)
+{
+    // Objects of a derived type do not fit in the slots
+    if (size > mSlotSize)
+        return ::operator new(size);
+
+    if (!mFreeSlots)
+    {
+        char *chunk = static_cast<char *>(
+                ::operator new(mSlotSize * CHUNK_SLOTS));
+        mChunks.push_back(chunk);
+
+        // Link the slots so that they are handed out in address order
+        for (std::size_t i = CHUNK_SLOTS; i-- > 0;)
+        {
+            void *slot = chunk + i * mSlotSize;
+            *static_cast<void **>(slot) = mFreeSlots;
+            mFreeSlots = slot;
+        }
+    }
+
+    void *slot = mFreeSlots;
+    mFreeSlots = *static_cast<void **>(slot);
+    ++mUsed;
+    return slot;
+}
+
+void ComponentPool::deallocate(void *object, std::size_t size)
+{
+    if (!object)
+        return;
+
+    if (size > mSlotSize)
+    {
+        ::operator delete(object);
+        return;
+    }
+
+    *static_cast<void **>(object) = mFreeSlots;
+    mFreeSlots = object;
+    --mUsed;
+}
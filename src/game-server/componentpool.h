@@ -0,0 +1,72 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef COMPONENTPOOL_H
+#define COMPONENTPOOL_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Storage for the components of one type. Components are allocated in
+ * chunks of contiguous slots, so that components of the same type are close
+ * to each other in memory, and a slot never moves while in use. Freed slots
+ * are reused before new chunks are allocated.
+ *
+ * Not thread-safe, components are only created and deleted by the main
+ * thread.
+ */
+class ComponentPool
+{
+    public:
+        ComponentPool(std::size_t objectSize);
+
+        ~ComponentPool();
+
+        /**
+         * Returns memory for an object of the given size.
+         */
+        void *allocate(std::size_t size);
+
+        /**
+         * Gives back memory returned by allocate.
+         */
+        void deallocate(void *object, std::size_t size);
+
+        /**
+         * Returns the number of slots in use.
+         */
+        std::size_t getUsed() const
+        { return mUsed; }
+
+    private:
+        ComponentPool(const ComponentPool &) = delete;
+        ComponentPool &operator=(const ComponentPool &) = delete;
+
+        static const std::size_t CHUNK_SLOTS = 256;
+
+        std::size_t mSlotSize;
+        std::vector<char *> mChunks;
+        void *mFreeSlots;       /**< Linked through their first bytes. */
+        std::size_t mUsed;
+};
+
+#endif // COMPONENTPOOL_H
@@ -56,6 +56,7 @@ class Entity : public sigc::trackable
         template <class T> T *getComponent() const;
         template <class T> T *findComponent() const;
         template <class T> bool hasComponent() const;
+        Component *getComponent(ComponentType type) const;
 
         bool isVisible() const;
         bool canMove() const;
@@ -71,8 +72,6 @@ class Entity : public sigc::trackable
         sigc::signal<void, Entity *> signal_map_changed;
 
     private:
-        Component *getComponent(ComponentType type) const;
-
         unsigned mId;
         MapComposite *mMap;     /**< Map the entity is on */
         EntityType mType;       /**< Type of this entity. */
@@ -85,7 +84,8 @@ class Entity : public sigc::trackable
 };
 
 /**
- * Looks up an entity by its ID, returns null if there is no such entity.
+ * Looks up an entity by its ID, returns null if there is no such entity,
+ * including when the entity with that ID was deleted since.
  */
 inline Entity *findEntity(unsigned id)
 {
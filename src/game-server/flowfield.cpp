@@ -0,0 +1,152 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game-server/flowfield.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+/* Same costs as the tile search of the map. */
+static const int basicCost = 100;
+static const int straightCost = basicCost + 1;
+static const int diagonalCost = basicCost * 362 / 256;
+
+static const int directionCount = 8;
+/* Straight directions first. Opposite directions differ by the lowest bit. */
+static const int directionX[directionCount] = { 1, -1,  0,  0,  1, -1,  1, -1 };
+static const int directionY[directionCount] = { 0,  0,  1, -1,  1, -1, -1,  1 };
+
+FlowField::FlowField(const Map *map, int targetX, int targetY,
+                     unsigned char walkmask, int radius):
+    tick(0),
+    generation(0),
+    mMap(map),
+    mTargetX(targetX),
+    mTargetY(targetY),
+    mWalkmask(walkmask),
+    mRadius(radius)
+{
+    mX0 = std::max(0, targetX - radius);
+    mY0 = std::max(0, targetY - radius);
+    mWidth = std::min(map->getWidth(), targetX + radius + 1) - mX0;
+    mHeight = std::min(map->getHeight(), targetY + radius + 1) - mY0;
+    if (mWidth <= 0 || mHeight <= 0 || !map->contains(targetX, targetY))
+    {
+        mWidth = mHeight = 0;
+        return;
+    }
+
+    mCosts.assign(mWidth * mHeight, -1);
+    mDirections.assign(mWidth * mHeight, -1);
+
+    // Search from the target outward. Moves cost the same both ways, so the
+    // cost of reaching a tile is the cost of walking from it to the target.
+    const unsigned char wallmask = walkmask & Map::BLOCKMASK_WALL;
+    typedef std::pair<int, int> Entry;  // Cost and tile index
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+
+    mCosts[getIndex(targetX, targetY)] = 0;
+    open.push(Entry(0, getIndex(targetX, targetY)));
+
+    while (!open.empty())
+    {
+        const Entry curr = open.top();
+        open.pop();
+        if (curr.first > mCosts[curr.second])
+            continue;
+
+        const int x = mX0 + curr.second % mWidth;
+        const int y = mY0 + curr.second / mWidth;
+
+        for (int d = 0; d < directionCount; ++d)
+        {
+            if (!canStep(x, y, d, wallmask))
+                continue;
+
+            const int nx = x + directionX[d], ny = y + directionY[d];
+            const int cost = curr.first + (d < 4 ? straightCost : diagonalCost);
+            const int index = getIndex(nx, ny);
+            if (mCosts[index] < 0 || cost < mCosts[index])
+            {
+                mCosts[index] = cost;
+                mDirections[index] = d ^ 1;
+                open.push(Entry(cost, index));
+            }
+        }
+    }
+}
+
+bool FlowField::canStep(int x, int y, int direction,
+                        unsigned char walkmask) const
+{
+    const int nx = x + directionX[direction], ny = y + directionY[direction];
+    if (!contains(nx, ny) || !mMap->getWalk(nx, ny, walkmask))
+        return false;
+
+    // Corners cannot be cut, as in the tile search
+    return direction < 4 || (mMap->getWalk(x, ny, walkmask) &&
+                             mMap->getWalk(nx, y, walkmask));
+}
+
+int FlowField::getCost(int x, int y) const
+{
+    return contains(x, y) ? mCosts[getIndex(x, y)] : -1;
+}
+
+void FlowField::getPath(int x, int y, unsigned char walkmask,
+                        Path &path) const
+{
+    path.clear();
+
+    int cost = getCost(x, y);
+    while (cost > 0)
+    {
+        int direction = mDirections[getIndex(x, y)];
+        if (!canStep(x, y, direction, walkmask))
+        {
+            // Something is in the way, take the best other step getting
+            // closer to the target
+            direction = -1;
+            int best = cost;
+            for (int d = 0; d < directionCount; ++d)
+            {
+                if (!canStep(x, y, d, walkmask))
+                    continue;
+
+                const int next = mCosts[getIndex(x + directionX[d],
+                                                 y + directionY[d])];
+                if (next >= 0 && next < best)
+                {
+                    best = next;
+                    direction = d;
+                }
+            }
+
+            if (direction < 0)
+                break;
+        }
+
+        x += directionX[direction];
+        y += directionY[direction];
+        cost = mCosts[getIndex(x, y)];
+        path.push_back(Point(x, y));
+    }
+}
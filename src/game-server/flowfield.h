@@ -0,0 +1,101 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLOWFIELD_H
+#define FLOWFIELD_H
+
+#include <vector>
+
+#include "game-server/map.h"
+
+/**
+ * Directions toward a target tile from every tile around it, so that any
+ * number of beings can walk to the same target without searching a path
+ * each.
+ *
+ * The field is computed with a single search from the target, up to a given
+ * radius in tiles. Only the walls of the walkmask are taken into account, so
+ * that the field stays valid while beings move. Beings in the way are walked
+ * around when following the field.
+ */
+class FlowField
+{
+    public:
+        FlowField(const Map *map, int targetX, int targetY,
+                  unsigned char walkmask, int radius);
+
+        int getTargetX() const
+        { return mTargetX; }
+
+        int getTargetY() const
+        { return mTargetY; }
+
+        unsigned char getWalkmask() const
+        { return mWalkmask; }
+
+        int getRadius() const
+        { return mRadius; }
+
+        /**
+         * Returns the cost of walking from a tile to the target, or -1 when
+         * the target cannot be reached from there within the field.
+         */
+        int getCost(int x, int y) const;
+
+        /**
+         * Builds the path from a tile to the target by following the field.
+         * Tiles blocked for \a walkmask are walked around when possible,
+         * otherwise the path stops before them. The path is written into
+         * \a path, keeping its storage.
+         */
+        void getPath(int x, int y, unsigned char walkmask, Path &path) const;
+
+        /** Tick and generation of the map the field was computed on. */
+        int tick;
+        unsigned generation;
+
+    private:
+        bool contains(int x, int y) const
+        {
+            return x >= mX0 && y >= mY0 &&
+                   x < mX0 + mWidth && y < mY0 + mHeight;
+        }
+
+        int getIndex(int x, int y) const
+        { return (x - mX0) + (y - mY0) * mWidth; }
+
+        /**
+         * Returns whether a step in a direction can be taken from a tile.
+         */
+        bool canStep(int x, int y, int direction,
+                     unsigned char walkmask) const;
+
+        const Map *mMap;
+        int mTargetX, mTargetY;
+        unsigned char mWalkmask;
+        int mRadius;
+        int mX0, mY0, mWidth, mHeight;  /**< Tiles covered by the field. */
+
+        std::vector<int> mCosts;
+        /** Direction of the next step from each tile, or -1. */
+        std::vector<signed char> mDirections;
+};
+
+#endif // FLOWFIELD_H
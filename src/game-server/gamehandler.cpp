@@ -18,6 +18,7 @@
  *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cassert>
 #include <map>
 
@@ -46,17 +47,32 @@
 
 const unsigned TILES_TO_BE_NEAR = 7;
 
+/**
+ * Queue receiving the messages sent by the current thread, when deferred.
+ */
+static thread_local DeferredMessages *deferredQueue = nullptr;
+
 GameHandler::GameHandler():
-    mTokenCollector(this)
+    mTokenCollector(this),
+    mBatchSize(0)
 {
 }
 
 bool GameHandler::startListen(enet_uint16 port)
 {
     LOG_INFO("Game handler started:");
+    mBatchSize = std::max(0, Configuration::getValue("net_batchSize", 1200));
     return ConnectionHandler::startListen(port);
 }
 
+int GameHandler::getSupportedCapabilities() const
+{
+    int capabilities = CAPABILITY_MOVE_DELTA;
+    if (mBatchSize > 0)
+        capabilities |= CAPABILITY_BATCH;
+    return capabilities;
+}
+
 NetComputer *GameHandler::computerConnected(ENetPeer *peer)
 {
     return new GameClient(peer);
@@ -181,6 +197,11 @@ void GameHandler::processMessage(NetComputer *computer, MessageIn &message)
             return;
 
         std::string magic_token = message.readString(MAGIC_TOKEN_LENGTH);
+
+        // Older clients do not announce any capabilities
+        if (message.getUnreadLength() > 0)
+            client.capabilities = message.readInt8();
+
         client.status = CLIENT_QUEUED; // Before the addPendingClient
         mTokenCollector.addPendingClient(magic_token, &client);
         return;
@@ -311,7 +332,67 @@ void GameHandler::sendTo(Entity *beingPtr, MessageOut &msg)
 void GameHandler::sendTo(GameClient *client, MessageOut &msg)
 {
     assert(client && client->status == CLIENT_CONNECTED);
-    client->send(msg);
+    if (deferredQueue)
+        deferredQueue->emplace_back(client, msg);
+    else
+        client->send(msg);
+}
+
+void GameHandler::sendTo(Entity *beingPtr, MessageOut &&msg)
+{
+    GameClient *client = beingPtr->getComponent<CharacterComponent>()
+            ->getClient();
+    sendTo(client, std::move(msg));
+}
+
+void GameHandler::sendTo(GameClient *client, MessageOut &&msg)
+{
+    assert(client && client->status == CLIENT_CONNECTED);
+    if (deferredQueue)
+        deferredQueue->emplace_back(client, std::move(msg));
+    else
+        client->send(std::move(msg));
+}
+
+void GameHandler::sendTo(const std::vector<Entity *> &characters,
+                         const MessageOut &msg, Entity *except)
+{
+    if (deferredQueue)
+    {
+        for (Entity *character : characters)
+        {
+            if (character == except)
+                continue;
+            GameClient *client = character->getComponent<CharacterComponent>()
+                    ->getClient();
+            assert(client && client->status == CLIENT_CONNECTED);
+            deferredQueue->emplace_back(client, msg);
+        }
+        return;
+    }
+
+    SharedPacket packet(msg);
+    for (Entity *character : characters)
+    {
+        if (character == except)
+            continue;
+        GameClient *client = character->getComponent<CharacterComponent>()
+                ->getClient();
+        assert(client && client->status == CLIENT_CONNECTED);
+        client->send(packet);
+    }
+}
+
+void GameHandler::setDeferredQueue(DeferredMessages *queue)
+{
+    deferredQueue = queue;
+}
+
+void GameHandler::sendDeferred(DeferredMessages &queue)
+{
+    for (auto &deferred : queue)
+        deferred.first->send(std::move(deferred.second));
+    queue.clear();
 }
 
 void GameHandler::addPendingCharacter(const std::string &token, Entity *ch)
@@ -381,8 +462,19 @@ void GameHandler::tokenMatched(GameClient *computer, Entity *character)
     characterComponent->triggerLoginCallback(*character);
 
     result.writeInt8(ERRMSG_OK);
+
+    int capabilities = 0;
+    if (computer->capabilities != -1)
+    {
+        capabilities = computer->capabilities & getSupportedCapabilities();
+        result.writeInt8(capabilities);
+        computer->capabilities = capabilities;
+    }
     computer->send(result);
 
+    if (capabilities & CAPABILITY_BATCH)
+        computer->enableBatching(GPMSG_BATCH, mBatchSize);
+
     Inventory(character).sendFull();
     characterComponent->markAllInfoAsChanged(*character);
 }
@@ -21,10 +21,14 @@
 #ifndef SERVER_GAMEHANDLER_H
 #define SERVER_GAMEHANDLER_H
 
+#include "game-server/interestmanager.h"
 #include "net/connectionhandler.h"
+#include "net/messageout.h"
 #include "net/netcomputer.h"
 #include "utils/tokencollector.h"
 
+#include <vector>
+
 class Entity;
 
 enum
@@ -38,11 +42,27 @@ enum
 struct GameClient: NetComputer
 {
     GameClient(ENetPeer *peer)
-      : NetComputer(peer), character(nullptr), status(CLIENT_LOGIN) {}
+      : NetComputer(peer), character(nullptr), status(CLIENT_LOGIN),
+        capabilities(-1) {}
     Entity *character;
     int status;
+
+    /**
+     * Capabilities enabled for the client, or the ones it asked for until it
+     * is connected. -1 when it did not announce any.
+     */
+    int capabilities;
+
+    /** Last movements sent, with CAPABILITY_MOVE_DELTA. */
+    MovementBaselines movementBaselines;
 };
 
+/**
+ * Messages held back by GameHandler::sendTo while sending is deferred for the
+ * calling thread.
+ */
+typedef std::vector< std::pair<GameClient *, MessageOut> > DeferredMessages;
+
 /**
  * Manages connections to game client.
  */
@@ -62,6 +82,33 @@ class GameHandler: public ConnectionHandler
         void sendTo(Entity *, MessageOut &msg);
         void sendTo(GameClient *, MessageOut &msg);
 
+        /**
+         * Sends a message that is not needed anymore to the given character.
+         * Its buffer is handed over to the packet without being copied.
+         */
+        void sendTo(Entity *, MessageOut &&msg);
+        void sendTo(GameClient *, MessageOut &&msg);
+
+        /**
+         * Sends a message to several characters, skipping \a except. The
+         * message is serialized once into a packet shared by all of them.
+         */
+        void sendTo(const std::vector<Entity *> &characters,
+                    const MessageOut &msg, Entity *except = nullptr);
+
+        /**
+         * Makes the messages passed to sendTo() by the calling thread be
+         * appended to \a queue instead of being sent, until this is called
+         * again with null. Used to build messages on worker threads.
+         */
+        static void setDeferredQueue(DeferredMessages *queue);
+
+        /**
+         * Sends the messages collected in \a queue and clears it.
+         * @note Must be called from the main thread.
+         */
+        void sendDeferred(DeferredMessages &queue);
+
         /**
          * Kills connection with given character.
          */
@@ -159,10 +206,17 @@ class GameHandler: public ConnectionHandler
         void sendNpcError(GameClient &client, int id,
                           const std::string &errorMsg);
 
+        /**
+         * Returns the capabilities which may be enabled for the clients.
+         */
+        int getSupportedCapabilities() const;
+
         /**
          * Container for pending clients and pending connections.
          */
         TokenCollector<GameHandler, GameClient *, Entity *> mTokenCollector;
+
+        int mBatchSize;     /**< Maximum size of a batch, 0 disables them. */
 };
 
 extern GameHandler *gameHandler;
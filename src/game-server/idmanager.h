@@ -21,19 +21,25 @@
 #ifndef IDMANAGER_H
 #define IDMANAGER_H
 
-#include <unordered_map>
+#include <cassert>
+#include <vector>
 
 /**
- * A very simplistic ID manager.
+ * Hands out ids that index an array of slots. An id is made of the index of
+ * its slot and of a generation, which changes each time the slot is freed.
+ * Lookups are a single array access, and ids kept after their value was
+ * freed, for example by scripts, are never mistaken for the value that
+ * reuses the slot.
  *
- * Does not have any error handling on the premise that other problems will
- * occur before hitting UINT_MAX allocated IDs.
+ * Freed slots are reused in the order they were freed, and only once enough
+ * of them are waiting, so that a slot comes back to a generation it had
+ * before only after millions of allocations.
  */
 template <typename Value>
 class IdManager
 {
 public:
-    IdManager() : mLastId(0) {}
+    IdManager() : mFirstFree(NONE), mLastFree(NONE), mFreeCount(0) {}
     IdManager(const IdManager&) = delete;
 
     unsigned allocate(Value *t);
@@ -41,33 +47,83 @@ public:
     Value *find(unsigned id) const;
 
 private:
-    std::unordered_map<unsigned, Value*> mIdMap;
-    unsigned mLastId;
+    static const unsigned INDEX_BITS = 20;
+    static const unsigned INDEX_MASK = (1u << INDEX_BITS) - 1;
+    static const unsigned GENERATION_MASK = ~0u >> INDEX_BITS;
+    static const unsigned MIN_FREE_SLOTS = 1024;
+    static const unsigned NONE = ~0u;
+
+    struct Slot
+    {
+        Value *value;
+        unsigned generation;
+        unsigned nextFree;      /**< Next slot to reuse, while free. */
+    };
+
+    std::vector<Slot> mSlots;
+    unsigned mFirstFree, mLastFree;
+    unsigned mFreeCount;
 };
 
 
 template <typename Value>
 inline unsigned IdManager<Value>::allocate(Value *t)
 {
-    do {
-       ++mLastId;
-    } while (mIdMap.find(mLastId) != mIdMap.end());
+    unsigned index;
+    const bool full = mSlots.size() > INDEX_MASK;
+    if (mFreeCount > MIN_FREE_SLOTS || (mFreeCount && full))
+    {
+        index = mFirstFree;
+        mFirstFree = mSlots[index].nextFree;
+        if (mFirstFree == NONE)
+            mLastFree = NONE;
+        --mFreeCount;
+    }
+    else
+    {
+        assert(!full);
+        index = mSlots.size();
+        Slot slot = { nullptr, 1, NONE };
+        mSlots.push_back(slot);
+    }
 
-    mIdMap.emplace(mLastId, t);
-    return mLastId;
+    mSlots[index].value = t;
+    return mSlots[index].generation << INDEX_BITS | index;
 }
 
 template <typename Value>
 inline void IdManager<Value>::free(unsigned id)
 {
-    mIdMap.erase(id);
+    const unsigned index = id & INDEX_MASK;
+    if (index >= mSlots.size() ||
+        mSlots[index].generation != id >> INDEX_BITS)
+        return;
+
+    Slot &slot = mSlots[index];
+    slot.value = nullptr;
+
+    // Generation 0 is skipped so that no id is 0
+    slot.generation = (slot.generation + 1) & GENERATION_MASK;
+    if (!slot.generation)
+        slot.generation = 1;
+
+    slot.nextFree = NONE;
+    if (mLastFree == NONE)
+        mFirstFree = index;
+    else
+        mSlots[mLastFree].nextFree = index;
+    mLastFree = index;
+    ++mFreeCount;
 }
 
 template <typename Value>
 inline Value *IdManager<Value>::find(unsigned id) const
 {
-    auto it = mIdMap.find(id);
-    return it != mIdMap.end() ? it->second : nullptr;
+    const unsigned index = id & INDEX_MASK;
+    if (index >= mSlots.size() ||
+        mSlots[index].generation != id >> INDEX_BITS)
+        return nullptr;
+    return mSlots[index].value;
 }
 
 #endif // IDMANAGER_H
@@ -0,0 +1,892 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "game-server/interestmanager.h"
+
+#include "game-server/abilitycomponent.h"
+#include "game-server/attributemanager.h"
+#include "game-server/charactercomponent.h"
+#include "game-server/effect.h"
+#include "game-server/gamehandler.h"
+#include "game-server/inventory.h"
+#include "game-server/item.h"
+#include "game-server/itemmanager.h"
+#include "game-server/mapcomposite.h"
+#include "game-server/monster.h"
+#include "game-server/npc.h"
+#include "net/messageout.h"
+#include "utils/rangefilter.h"
+
+#include <cassert>
+#include <deque>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+/**
+ * Sets message fields describing character look.
+ */
+static void serializeLooks(Entity *ch, MessageOut &msg)
+{
+    auto *characterComponent = ch->getComponent<CharacterComponent>();
+    msg.writeInt8(characterComponent->getHairStyle());
+    msg.writeInt8(characterComponent->getHairColor());
+    const EquipData &equipData =
+            characterComponent->getPossessions().getEquipment();
+    const InventoryData &inventoryData =
+            characterComponent->getPossessions().getInventory();
+
+    // The map storing the info about the look changes to send
+    //{ slot type id, item id }
+    std::map<unsigned, unsigned> lookChanges;
+
+    // Note that we can send several updates on the same slot type as different
+    // items may have been equipped.
+    for (EquipData::const_iterator it = equipData.begin(),
+         it_end = equipData.end(); it != it_end; ++it)
+    {
+        InventoryData::const_iterator itemIt = inventoryData.find(*it);
+
+        if (!itemManager->isEquipSlotVisible(itemIt->second.equipmentSlot))
+            continue;
+
+        lookChanges.insert(std::make_pair(
+                itemIt->second.equipmentSlot,
+                itemIt->second.itemId));
+    }
+
+    if (!lookChanges.empty())
+    {
+        // Number of look changes to send
+        msg.writeInt8(lookChanges.size());
+
+        for (std::map<unsigned, unsigned>::const_iterator it =
+             lookChanges.begin(), it_end = lookChanges.end();
+             it != it_end; ++it)
+        {
+            msg.writeInt8(it->first);
+            msg.writeInt16(it->second);
+        }
+    }
+}
+
+namespace
+{
+
+/**
+ * What happened to a being during the tick. The messages are serialized on
+ * first use and then sent to every character that can see the being.
+ */
+struct BeingDelta
+{
+    BeingDelta(Entity *being):
+        being(being),
+        oldPos(being->getComponent<BeingComponent>()->getOldPosition()),
+        pos(being->getComponent<ActorComponent>()->getPosition()),
+        id(being->getComponent<ActorComponent>()->getPublicID()),
+        flags(being->getComponent<ActorComponent>()->getUpdateFlags()),
+        speed(-1),
+        directionUpdate(-1)
+    {}
+
+    Entity *being;
+    Point oldPos;
+    Point pos;
+    int id;
+    int flags;                          /**< Update flags of the being. */
+    int speed;                          /**< Sent speed, -1 until known. */
+
+    /** Action, looks, emote, direction and ability messages. */
+    std::vector<MessageOut> updates;
+    int directionUpdate;                /**< Index in updates, or -1. */
+
+    std::unique_ptr<MessageOut> damage; /**< Entries of a damage message. */
+    std::unique_ptr<MessageOut> move;   /**< Entry of a move message. */
+    /** Delta-encoded move entry, for clients which saw the old position. */
+    std::unique_ptr<MessageOut> moveDelta;
+    std::unique_ptr<MessageOut> enter;
+    std::unique_ptr<MessageOut> leave;
+};
+
+/**
+ * Item or effect which may be visible from a zone.
+ */
+struct FixedCandidate
+{
+    Entity *actor;
+    Point pos;
+    int flags;
+    int itemId;             /**< Item class, or 0 for effects. */
+    MessageOut *message;    /**< Appear or effect message, if any. */
+};
+
+/**
+ * Candidate which was and/or will be in range of a character.
+ */
+struct RangeHit
+{
+    unsigned index;
+    bool wereInRange;
+    bool willBeInRange;
+};
+
+/**
+ * Merges the sorted index lists of the candidates which were and which will
+ * be in range into a single list.
+ */
+static void mergeHits(const std::vector<unsigned> &were,
+                      const std::vector<unsigned> &will,
+                      std::vector<RangeHit> &hits)
+{
+    hits.clear();
+    std::vector<unsigned>::const_iterator a = were.begin(), a_end = were.end();
+    std::vector<unsigned>::const_iterator b = will.begin(), b_end = will.end();
+    while (a != a_end || b != b_end)
+    {
+        RangeHit hit;
+        if (b == b_end || (a != a_end && *a < *b))
+        {
+            hit.index = *a++;
+            hit.wereInRange = true;
+            hit.willBeInRange = false;
+        }
+        else if (a == a_end || *b < *a)
+        {
+            hit.index = *b++;
+            hit.wereInRange = false;
+            hit.willBeInRange = true;
+        }
+        else
+        {
+            hit.index = *a++;
+            ++b;
+            hit.wereInRange = true;
+            hit.willBeInRange = true;
+        }
+        hits.push_back(hit);
+    }
+}
+
+/**
+ * Writes the delta-encoded movement of a being from the last position and
+ * speed sent to a client, and updates them. Writes nothing when the being is
+ * still where the client saw it last.
+ */
+static void writeMoveDelta(MessageOut &msg, int id,
+                           MovementBaseline &baseline,
+                           const Point &pos, int speed)
+{
+    const int dx = pos.x - baseline.x;
+    const int dy = pos.y - baseline.y;
+    if (!dx && !dy)
+        return;
+
+    int flags = MOVE_DELTA_POSITION;
+    if (dx >= -128 && dx < 128 && dy >= -128 && dy < 128)
+        flags = MOVE_DELTA_OFFSET;
+    if (speed != baseline.speed)
+        flags |= MOVE_DELTA_SPEED;
+
+    msg.writeInt16(id);
+    msg.writeInt8(flags);
+    if (flags & MOVE_DELTA_OFFSET)
+    {
+        msg.writeInt8(dx);
+        msg.writeInt8(dy);
+    }
+    else
+    {
+        msg.writeInt16(pos.x);
+        msg.writeInt16(pos.y);
+    }
+    if (flags & MOVE_DELTA_SPEED)
+        msg.writeInt8(speed);
+
+    baseline.x = pos.x;
+    baseline.y = pos.y;
+    baseline.speed = speed;
+}
+
+/**
+ * Pending health change of a character, for its party members.
+ */
+struct HealthChange
+{
+    Entity *character;
+    int party;
+    MessageOut message;
+};
+
+/**
+ * State of the interest pass over a single map.
+ */
+class InterestPass
+{
+    public:
+        InterestPass(MapComposite *map, int visualRange, int tick):
+            mMap(map),
+            mVisualRange(visualRange),
+            mTick(tick),
+            mSpeedAttribute(
+                attributeManager->getAttributeInfo(ATTR_MOVE_SPEED_TPS))
+        {}
+
+        void run();
+
+    private:
+        void collectHealthChanges();
+        void informZone(const std::vector<Entity *> &characters);
+        void informPlayer(Entity *p);
+
+        BeingDelta *getDelta(Entity *being);
+        void serializeUpdates(BeingDelta &delta);
+        int getSpeed(BeingDelta &delta);
+        MessageOut &getMove(BeingDelta &delta);
+        MessageOut &getMoveDelta(BeingDelta &delta);
+        MessageOut &getEnter(BeingDelta &delta);
+        MessageOut &getLeave(BeingDelta &delta);
+        MessageOut *getFixedMessage(Entity *actor, const Point &pos,
+                                    int flags);
+
+        MapComposite *mMap;
+        int mVisualRange;
+        int mTick;
+        AttributeInfo *mSpeedAttribute;
+
+        /** Deltas of the beings seen so far, stable when growing. */
+        std::deque<BeingDelta> mDeltas;
+        std::unordered_map<Entity *, BeingDelta *> mDeltaIndex;
+        std::unordered_map<Entity *, MessageOut> mFixedMessages;
+        std::vector<HealthChange> mHealthChanges;
+
+        /** Beings and items which may be visible from the current zone. */
+        std::vector<BeingDelta *> mBeings;
+        std::vector<FixedCandidate> mFixed;
+
+        /** Packed old and new positions of the candidates, for filtering. */
+        std::vector<int> mBeingOldXs, mBeingOldYs, mBeingXs, mBeingYs;
+        std::vector<int> mFixedXs, mFixedYs;
+
+        std::vector<unsigned> mWere, mWill;
+        std::vector<RangeHit> mHits;
+};
+
+} // anonymous namespace
+
+void InterestPass::run()
+{
+    collectHealthChanges();
+
+    // The characters are visited zone by zone, so they can share the work of
+    // finding what is around them.
+    std::vector<Entity *> characters;
+    MapZone *zone = nullptr;
+    for (CharacterIterator p(mMap->getWholeMapIterator()); p; ++p)
+    {
+        if (*p.iterator != zone)
+        {
+            if (!characters.empty())
+                informZone(characters);
+            characters.clear();
+            zone = *p.iterator;
+        }
+        characters.push_back(*p);
+    }
+    if (!characters.empty())
+        informZone(characters);
+}
+
+void InterestPass::collectHealthChanges()
+{
+    for (CharacterIterator i(mMap->getWholeMapIterator()); i; ++i)
+    {
+        Entity *c = *i;
+        int cflags = c->getComponent<ActorComponent>()->getUpdateFlags();
+        if (!(cflags & UPDATEFLAG_HEALTHCHANGE))
+            continue;
+
+        auto *beingComponent = c->getComponent<BeingComponent>();
+
+        HealthChange change = {
+            c,
+            c->getComponent<CharacterComponent>()->getParty(),
+            MessageOut(GPMSG_BEING_HEALTH_CHANGE)
+        };
+        MessageOut &healthMsg = change.message;
+        healthMsg.writeInt16(c->getComponent<ActorComponent>()->getPublicID());
+        auto *hpAttribute = attributeManager->getAttributeInfo(ATTR_HP);
+        healthMsg.writeInt16(beingComponent->getModifiedAttribute(hpAttribute));
+        auto *maxHpAttribute = attributeManager->getAttributeInfo(ATTR_MAX_HP);
+        healthMsg.writeInt16(
+                beingComponent->getModifiedAttribute(maxHpAttribute));
+        mHealthChanges.push_back(std::move(change));
+    }
+}
+
+void InterestPass::informZone(const std::vector<Entity *> &characters)
+{
+    mBeings.clear();
+    mFixed.clear();
+    mBeingOldXs.clear();
+    mBeingOldYs.clear();
+    mBeingXs.clear();
+    mBeingYs.clear();
+    mFixedXs.clear();
+    mFixedYs.clear();
+
+    // Everything around any of the characters, in zone order
+    const ZoneIterator around =
+            mMap->getAroundBeingsIterator(characters, mVisualRange);
+
+    for (BeingIterator it(around); it; ++it)
+    {
+        BeingDelta *delta = getDelta(*it);
+        mBeings.push_back(delta);
+        mBeingOldXs.push_back(delta->oldPos.x);
+        mBeingOldYs.push_back(delta->oldPos.y);
+        mBeingXs.push_back(delta->pos.x);
+        mBeingYs.push_back(delta->pos.y);
+    }
+
+    for (FixedActorIterator it(around); it; ++it)
+    {
+        Entity *o = *it;
+
+        assert(o->getType() == OBJECT_ITEM ||
+               o->getType() == OBJECT_EFFECT);
+
+        FixedCandidate candidate;
+        candidate.actor = o;
+        candidate.pos = o->getComponent<ActorComponent>()->getPosition();
+        candidate.flags = o->getComponent<ActorComponent>()->getUpdateFlags();
+        candidate.itemId = 0;
+        if (o->getType() == OBJECT_ITEM)
+        {
+            ItemComponent *item = o->getComponent<ItemComponent>();
+            candidate.itemId = item->getItemClass()->getDatabaseID();
+        }
+        candidate.message = getFixedMessage(o, candidate.pos, candidate.flags);
+        mFixed.push_back(candidate);
+        mFixedXs.push_back(candidate.pos.x);
+        mFixedYs.push_back(candidate.pos.y);
+    }
+
+    for (std::vector<Entity *>::const_iterator i = characters.begin(),
+         i_end = characters.end(); i != i_end; ++i)
+    {
+        informPlayer(*i);
+    }
+}
+
+/**
+ * Informs a player of what happened around the character.
+ */
+void InterestPass::informPlayer(Entity *p)
+{
+    const Point &pold = p->getComponent<BeingComponent>()->getOldPosition();
+    const Point &ppos = p->getComponent<ActorComponent>()->getPosition();
+    int pflags = p->getComponent<ActorComponent>()->getUpdateFlags();
+
+    // Last movements sent to the client, when it takes delta-encoded ones
+    GameClient *client = p->getComponent<CharacterComponent>()->getClient();
+    MovementBaselines *baselines = nullptr;
+    if (client->capabilities != -1 &&
+        (client->capabilities & CAPABILITY_MOVE_DELTA))
+    {
+        baselines = &client->movementBaselines;
+        if (pflags & UPDATEFLAG_NEW_ON_MAP)
+            baselines->clear();
+    }
+
+    MessageOut moveMsg(baselines ? GPMSG_BEINGS_MOVE_DELTA
+                                 : GPMSG_BEINGS_MOVE);
+    MessageOut damageMsg(GPMSG_BEINGS_DAMAGE);
+
+    // Check which beings were and will be around the character p. Beings
+    // far away in both cases are skipped: there is nothing to report.
+    mWere.clear();
+    mWill.clear();
+    if (!(pflags & UPDATEFLAG_NEW_ON_MAP))
+    {
+        utils::rangefilter::inRange(mBeingOldXs.data(), mBeingOldYs.data(),
+                                    mBeings.size(), pold, mVisualRange, mWere);
+    }
+    utils::rangefilter::inRange(mBeingXs.data(), mBeingYs.data(),
+                                mBeings.size(), ppos, mVisualRange, mWill);
+    mergeHits(mWere, mWill, mHits);
+
+    // Inform client about activities of other beings near its character
+    for (std::vector<RangeHit>::const_iterator it = mHits.begin(),
+         it_end = mHits.end(); it != it_end; ++it)
+    {
+        BeingDelta &o = *mBeings[it->index];
+
+        bool wereInRange = it->wereInRange &&
+                           !(o.flags & UPDATEFLAG_NEW_ON_MAP);
+        bool willBeInRange = it->willBeInRange;
+
+        if (!wereInRange && !willBeInRange)
+        {
+            // Nothing to report: o and p are far away from each other.
+            continue;
+        }
+
+        if (wereInRange && willBeInRange)
+        {
+            serializeUpdates(o);
+
+            // Send action, looks, emote, direction and ability messages.
+            // Characters are not told about their own direction changes.
+            for (int i = 0, i_end = o.updates.size(); i != i_end; ++i)
+            {
+                if (i != o.directionUpdate || o.being != p)
+                    gameHandler->sendTo(p, o.updates[i]);
+            }
+
+            if (o.damage)
+                damageMsg.append(*o.damage);
+
+            if (o.oldPos == o.pos)
+            {
+                // o does not move, nothing more to report.
+                continue;
+            }
+        }
+
+        if (!willBeInRange)
+        {
+            // o is no longer visible from p. Send leave message.
+            gameHandler->sendTo(p, getLeave(o));
+            if (baselines)
+                baselines->erase(o.id);
+            continue;
+        }
+
+        if (!wereInRange)
+        {
+            // o is now visible by p. Send enter message.
+            gameHandler->sendTo(p, getEnter(o));
+            if (baselines)
+            {
+                MovementBaseline &baseline = (*baselines)[o.id];
+                baseline = MovementBaseline();
+                baseline.x = o.pos.x;
+                baseline.y = o.pos.y;
+            }
+        }
+
+        if (!baselines)
+        {
+            moveMsg.append(getMove(o));
+            continue;
+        }
+
+        // Clients which saw the previous movement share the same entry
+        MovementBaseline &baseline = (*baselines)[o.id];
+        const int speed = getSpeed(o);
+        if (baseline.x == o.oldPos.x && baseline.y == o.oldPos.y &&
+            baseline.speed == speed)
+        {
+            moveMsg.append(getMoveDelta(o));
+            baseline.x = o.pos.x;
+            baseline.y = o.pos.y;
+        }
+        else
+        {
+            writeMoveDelta(moveMsg, o.id, baseline, o.pos, speed);
+        }
+    }
+
+    // Do not send a packet if nothing happened in p's range.
+    if (moveMsg.getLength() > 2)
+        gameHandler->sendTo(p, std::move(moveMsg));
+
+    if (damageMsg.getLength() > 2)
+        gameHandler->sendTo(p, std::move(damageMsg));
+
+    // Inform client about status change.
+    p->getComponent<CharacterComponent>()->sendStatus(*p);
+
+    // Inform client about health change of party members
+    const int party = p->getComponent<CharacterComponent>()->getParty();
+    for (std::vector<HealthChange>::iterator i = mHealthChanges.begin(),
+         i_end = mHealthChanges.end(); i != i_end; ++i)
+    {
+        // Make sure its not the same character, and they are in the same
+        // party
+        if (i->character != p && i->party == party)
+            gameHandler->sendTo(p, i->message);
+    }
+
+    // Inform client about items on the ground around its character
+    mWere.clear();
+    mWill.clear();
+    if (!(pflags & UPDATEFLAG_NEW_ON_MAP))
+    {
+        utils::rangefilter::inRange(mFixedXs.data(), mFixedYs.data(),
+                                    mFixed.size(), pold, mVisualRange, mWere);
+    }
+    utils::rangefilter::inRange(mFixedXs.data(), mFixedYs.data(),
+                                mFixed.size(), ppos, mVisualRange, mWill);
+    mergeHits(mWere, mWill, mHits);
+
+    MessageOut itemMsg(GPMSG_ITEMS);
+    for (std::vector<RangeHit>::const_iterator it = mHits.begin(),
+         it_end = mHits.end(); it != it_end; ++it)
+    {
+        const FixedCandidate &o = mFixed[it->index];
+
+        bool willBeInRange = it->willBeInRange;
+        bool wereInRange = it->wereInRange &&
+                           !(o.flags & UPDATEFLAG_NEW_ON_MAP);
+
+        if (!(willBeInRange ^ wereInRange))
+            continue;
+
+        if (o.message)
+        {
+            // Appearing item or new effect
+            gameHandler->sendTo(p, *o.message);
+        }
+        else if (o.actor->getType() == OBJECT_ITEM)
+        {
+            itemMsg.writeInt16(willBeInRange ? o.itemId : 0);
+            itemMsg.writeInt16(o.pos.x);
+            itemMsg.writeInt16(o.pos.y);
+        }
+    }
+
+    // Do not send a packet if nothing happened in p's range.
+    if (itemMsg.getLength() > 2)
+        gameHandler->sendTo(p, std::move(itemMsg));
+}
+
+BeingDelta *InterestPass::getDelta(Entity *being)
+{
+    std::unordered_map<Entity *, BeingDelta *>::iterator it =
+            mDeltaIndex.find(being);
+    if (it != mDeltaIndex.end())
+        return it->second;
+
+    mDeltas.push_back(BeingDelta(being));
+    BeingDelta *delta = &mDeltas.back();
+    mDeltaIndex.insert(std::make_pair(being, delta));
+    return delta;
+}
+
+/**
+ * Serializes the changes seen by the characters which could already see the
+ * being.
+ */
+void InterestPass::serializeUpdates(BeingDelta &delta)
+{
+    if (delta.damage)
+        return;
+
+    Entity *o = delta.being;
+    const int oid = delta.id;
+    const int oflags = delta.flags;
+    auto *beingComponent = o->getComponent<BeingComponent>();
+
+    // Action change messages.
+    if (oflags & UPDATEFLAG_ACTIONCHANGE)
+    {
+        MessageOut actionMsg(GPMSG_BEING_ACTION_CHANGE);
+        actionMsg.writeInt16(oid);
+        actionMsg.writeInt8(beingComponent->getAction());
+        delta.updates.push_back(std::move(actionMsg));
+    }
+
+    // Looks change messages.
+    if (oflags & UPDATEFLAG_LOOKSCHANGE)
+    {
+        MessageOut looksMsg(GPMSG_BEING_LOOKS_CHANGE);
+        looksMsg.writeInt16(oid);
+        serializeLooks(o, looksMsg);
+        delta.updates.push_back(std::move(looksMsg));
+    }
+
+    // Emote messages.
+    if (oflags & UPDATEFLAG_EMOTE)
+    {
+        int emoteId = beingComponent->getLastEmote();
+        if (emoteId > -1)
+        {
+            MessageOut emoteMsg(GPMSG_BEING_EMOTE);
+            emoteMsg.writeInt16(oid);
+            emoteMsg.writeInt16(emoteId);
+            delta.updates.push_back(std::move(emoteMsg));
+        }
+    }
+
+    // Direction change messages.
+    if (oflags & UPDATEFLAG_DIRCHANGE)
+    {
+        MessageOut dirMsg(GPMSG_BEING_DIR_CHANGE);
+        dirMsg.writeInt16(oid);
+        dirMsg.writeInt8(beingComponent->getDirection());
+        delta.directionUpdate = delta.updates.size();
+        delta.updates.push_back(std::move(dirMsg));
+    }
+
+    // Ability uses
+    if (oflags & UPDATEFLAG_ABILITY_ON_POINT)
+    {
+        MessageOut abilityMsg(GPMSG_BEING_ABILITY_POINT);
+        abilityMsg.writeInt16(oid);
+        auto *abilityComponent = o->getComponent<AbilityComponent>();
+        const Point &point = abilityComponent->getLastTargetPoint();
+        abilityMsg.writeInt8(abilityComponent->getLastUsedAbilityId());
+        abilityMsg.writeInt16(point.x);
+        abilityMsg.writeInt16(point.y);
+        delta.updates.push_back(std::move(abilityMsg));
+    }
+
+    if (oflags & UPDATEFLAG_ABILITY_ON_BEING)
+    {
+        MessageOut abilityMsg(GPMSG_BEING_ABILITY_BEING);
+        abilityMsg.writeInt16(oid);
+        auto *abilityComponent = o->getComponent<AbilityComponent>();
+        abilityMsg.writeInt8(abilityComponent->getLastUsedAbilityId());
+        abilityMsg.writeInt16(abilityComponent->getLastTargetBeingId());
+        delta.updates.push_back(std::move(abilityMsg));
+    }
+
+    if (oflags & UPDATEFLAG_ABILITY_ON_DIRECTION)
+    {
+        MessageOut abilityMsg(GPMSG_BEING_ABILITY_DIRECTION);
+        abilityMsg.writeInt16(oid);
+        auto *abilityComponent = o->getComponent<AbilityComponent>();
+        abilityMsg.writeInt8(abilityComponent->getLastUsedAbilityId());
+        abilityMsg.writeInt8(abilityComponent->getLastTargetDirection());
+        delta.updates.push_back(std::move(abilityMsg));
+    }
+
+    // Damage entries, also marking the updates as serialized.
+    delta.damage.reset(new MessageOut(GPMSG_BEINGS_DAMAGE));
+    if (o->canFight())
+    {
+        const Hits &hits = beingComponent->getHitsTaken();
+        for (Hits::const_iterator j = hits.begin(),
+             j_end = hits.end(); j != j_end; ++j)
+        {
+            delta.damage->writeInt16(oid);
+            delta.damage->writeInt16(*j);
+        }
+    }
+}
+
+/**
+ * Returns the speed of the being as sent to the clients, in tenths of tiles
+ * per second.
+ */
+int InterestPass::getSpeed(BeingDelta &delta)
+{
+    if (delta.speed == -1)
+    {
+        // We multiply the sent speed (in tiles per second) by ten
+        // to get it within a byte with decimal precision.
+        // For instance, a value of 4.5 will be sent as 45.
+        delta.speed = (unsigned short)
+            (delta.being->getComponent<BeingComponent>()
+                    ->getModifiedAttribute(mSpeedAttribute) * 10);
+    }
+    return delta.speed;
+}
+
+MessageOut &InterestPass::getMove(BeingDelta &delta)
+{
+    if (delta.move)
+        return *delta.move;
+
+    int flags = 0;
+    if (delta.pos != delta.oldPos)
+    {
+        // Add position check coords every 5 seconds.
+        if (mTick % 50 == 0)
+            flags |= MOVING_POSITION;
+
+        flags |= MOVING_DESTINATION;
+    }
+
+    MessageOut *moveMsg = new MessageOut(GPMSG_BEINGS_MOVE);
+    delta.move.reset(moveMsg);
+    moveMsg->writeInt16(delta.id);
+    moveMsg->writeInt8(flags);
+    if (flags & MOVING_POSITION)
+    {
+        moveMsg->writeInt16(delta.oldPos.x);
+        moveMsg->writeInt16(delta.oldPos.y);
+    }
+
+    if (flags & MOVING_DESTINATION)
+    {
+        moveMsg->writeInt16(delta.pos.x);
+        moveMsg->writeInt16(delta.pos.y);
+        moveMsg->writeInt8(getSpeed(delta));
+    }
+    return *moveMsg;
+}
+
+/**
+ * Returns the delta-encoded move entry of a being for the clients which saw
+ * its old position and know its speed. Unlike GPMSG_BEINGS_MOVE, it never
+ * repeats the position: the messages are reliable, so the clients always
+ * know where the being was last.
+ */
+MessageOut &InterestPass::getMoveDelta(BeingDelta &delta)
+{
+    if (delta.moveDelta)
+        return *delta.moveDelta;
+
+    MovementBaseline baseline;
+    baseline.x = delta.oldPos.x;
+    baseline.y = delta.oldPos.y;
+    baseline.speed = getSpeed(delta);
+
+    delta.moveDelta.reset(new MessageOut(GPMSG_BEINGS_MOVE_DELTA));
+    writeMoveDelta(*delta.moveDelta, delta.id, baseline, delta.pos,
+                   baseline.speed);
+    return *delta.moveDelta;
+}
+
+MessageOut &InterestPass::getEnter(BeingDelta &delta)
+{
+    if (delta.enter)
+        return *delta.enter;
+
+    Entity *o = delta.being;
+    const int otype = o->getType();
+    auto *beingComponent = o->getComponent<BeingComponent>();
+
+    MessageOut *enterMsg = new MessageOut(GPMSG_BEING_ENTER);
+    delta.enter.reset(enterMsg);
+    enterMsg->writeInt8(otype);
+    enterMsg->writeInt16(delta.id);
+    enterMsg->writeInt8(beingComponent->getAction());
+    enterMsg->writeInt16(delta.pos.x);
+    enterMsg->writeInt16(delta.pos.y);
+    enterMsg->writeInt8(beingComponent->getDirection());
+    enterMsg->writeInt8(beingComponent->getGender());
+    switch (otype)
+    {
+        case OBJECT_CHARACTER:
+        {
+            enterMsg->writeString(beingComponent->getName());
+            serializeLooks(o, *enterMsg);
+        } break;
+
+        case OBJECT_MONSTER:
+        {
+            MonsterComponent *monsterComponent =
+                    o->getComponent<MonsterComponent>();
+            enterMsg->writeInt16(monsterComponent->getSpecy()->getId());
+            enterMsg->writeString(beingComponent->getName());
+        } break;
+
+        case OBJECT_NPC:
+        {
+            NpcComponent *npcComponent = o->getComponent<NpcComponent>();
+            enterMsg->writeInt16(npcComponent->getNpcId());
+            enterMsg->writeString(beingComponent->getName());
+        } break;
+
+        default:
+            assert(false); // TODO
+            break;
+    }
+    return *enterMsg;
+}
+
+MessageOut &InterestPass::getLeave(BeingDelta &delta)
+{
+    if (!delta.leave)
+    {
+        delta.leave.reset(new MessageOut(GPMSG_BEING_LEAVE));
+        delta.leave->writeInt16(delta.id);
+    }
+    return *delta.leave;
+}
+
+/**
+ * Returns the message sent when a new item or effect comes into view, or null
+ * when there is none.
+ */
+MessageOut *InterestPass::getFixedMessage(Entity *actor, const Point &pos,
+                                          int flags)
+{
+    // Don't show old effects, and only announce new items specially
+    if (!(flags & UPDATEFLAG_NEW_ON_MAP))
+        return nullptr;
+
+    std::unordered_map<Entity *, MessageOut>::iterator it =
+            mFixedMessages.find(actor);
+    if (it != mFixedMessages.end())
+        return &it->second;
+
+    switch (actor->getType())
+    {
+        case OBJECT_ITEM:
+        {
+            /* Send a specific message to the client when an item appears
+               out of nowhere, so that a sound/animation can be performed. */
+            ItemComponent *item = actor->getComponent<ItemComponent>();
+            MessageOut appearMsg(GPMSG_ITEM_APPEAR);
+            appearMsg.writeInt16(item->getItemClass()->getDatabaseID());
+            appearMsg.writeInt16(pos.x);
+            appearMsg.writeInt16(pos.y);
+            it = mFixedMessages.insert(
+                    std::make_pair(actor, std::move(appearMsg))).first;
+        }
+        break;
+        case OBJECT_EFFECT:
+        {
+            EffectComponent *e = actor->getComponent<EffectComponent>();
+            if (Entity *b = e->getBeing())
+            {
+                auto *actorComponent = b->getComponent<ActorComponent>();
+                MessageOut effectMsg(GPMSG_CREATE_EFFECT_BEING);
+                effectMsg.writeInt16(e->getEffectId());
+                effectMsg.writeInt16(actorComponent->getPublicID());
+                it = mFixedMessages.insert(
+                        std::make_pair(actor, std::move(effectMsg))).first;
+            } else {
+                MessageOut effectMsg(GPMSG_CREATE_EFFECT_POS);
+                effectMsg.writeInt16(e->getEffectId());
+                effectMsg.writeInt16(pos.x);
+                effectMsg.writeInt16(pos.y);
+                it = mFixedMessages.insert(
+                        std::make_pair(actor, std::move(effectMsg))).first;
+            }
+        }
+        break;
+        default:
+            return nullptr;
+    }
+    return &it->second;
+}
+
+void InterestManager::informPlayers(MapComposite *map, int visualRange,
+                                    int tick)
+{
+    InterestPass pass(map, visualRange, tick);
+    pass.run();
+}
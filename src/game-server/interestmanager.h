@@ -0,0 +1,70 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef INTERESTMANAGER_H
+#define INTERESTMANAGER_H
+
+#include <unordered_map>
+
+class MapComposite;
+
+/**
+ * Last movement of a being sent to a client receiving delta-encoded
+ * movements.
+ */
+struct MovementBaseline
+{
+    MovementBaseline(): x(0), y(0), speed(-1) {}
+
+    int x, y;
+    int speed;  /**< -1 until a speed was sent. */
+};
+
+/**
+ * Movement baselines of the beings known by a client, by public ID.
+ */
+typedef std::unordered_map<int, MovementBaseline> MovementBaselines;
+
+/**
+ * Informs the characters about what happened around them during a tick.
+ *
+ * The characters of a map are handled zone by zone: the beings and items that
+ * may be visible from a zone are gathered once for all the characters in it,
+ * and the changes of every being are serialized once and the resulting
+ * messages shared by all the characters that can see it.
+ *
+ * Clients supporting it get movements as offsets from the last position they
+ * were sent. The entry is still shared by the clients which received the
+ * previous movement of the being.
+ */
+namespace InterestManager
+{
+    /**
+     * Sends to the characters of the map the messages about the beings and
+     * items around them.
+     *
+     * @note Only touches the given map, so different maps can be handled
+     *       concurrently.
+     */
+    void informPlayers(MapComposite *map, int visualRange, int tick);
+}
+
+#endif // INTERESTMANAGER_H
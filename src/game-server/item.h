@@ -251,7 +251,7 @@ class ItemClass
 /**
  * An item stack lying on the floor in the game world.
  */
-class ItemComponent : public Component
+class ItemComponent : public PooledComponent<ItemComponent>
 {
     public:
         static const ComponentType type = CT_Item;
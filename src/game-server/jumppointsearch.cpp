@@ -0,0 +1,462 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game-server/jumppointsearch.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <queue>
+
+/* Same costs as the tile search of the map. */
+static const int basicCost = 100;
+static const int straightCost = basicCost + 1;
+static const int diagonalCost = basicCost * 362 / 256;
+
+static int countTrailingZeros(uint64_t bits)
+{
+    return __builtin_ctzll(bits);
+}
+
+static int highestBit(uint64_t bits)
+{
+    return 63 - __builtin_clzll(bits);
+}
+
+namespace {
+
+struct OpenNode
+{
+    OpenNode(int tile, int Fcost): tile(tile), Fcost(Fcost) {}
+
+    bool operator<(const OpenNode &other) const
+    { return Fcost > other.Fcost; }
+
+    int tile;
+    int Fcost;
+};
+
+/**
+ * Search state indexed by tile, reused between searches like the one of the
+ * tile search.
+ */
+struct SearchState
+{
+    SearchState(): onClosedList(1), onOpenList(2) {}
+
+    void prepare(unsigned size)
+    {
+        if (onOpenList < UINT_MAX - 2)
+        {
+            onClosedList += 2;
+            onOpenList += 2;
+        }
+        else
+        {
+            onClosedList = 1;
+            onOpenList = 2;
+            std::fill(whichList.begin(), whichList.end(), 0);
+        }
+
+        if (whichList.size() < size)
+        {
+            whichList.resize(size, 0);
+            Gcost.resize(size);
+            parent.resize(size);
+        }
+    }
+
+    std::vector<unsigned> whichList;
+    std::vector<int> Gcost;
+    std::vector<int> parent;
+    unsigned onClosedList, onOpenList;
+};
+
+/**
+ * One search. Tiles farther than the maximum cost from the start cannot be
+ * part of the path, so they are handled like walls. This keeps the scans
+ * short on large maps.
+ */
+class JumpPointSearch
+{
+    public:
+        JumpPointSearch(const Map *map, int startX, int startY,
+                        int destX, int destY,
+                        unsigned char walkmask, int maxCost):
+            mMap(map),
+            mWidth(map->getWidth()),
+            mDestX(destX), mDestY(destY),
+            mWalkmask(walkmask),
+            mMinX(std::max(0, startX - maxCost)),
+            mMinY(std::max(0, startY - maxCost)),
+            mMaxX(std::min(map->getWidth() - 1, startX + maxCost)),
+            mMaxY(std::min(map->getHeight() - 1, startY + maxCost)),
+            mPlaneCount(0)
+        {
+            for (int i = 0; i < NB_BLOCKTYPES; ++i)
+            {
+                const BlockType type = BlockType(i);
+                if (!(walkmask & Map::getBlockMask(type)))
+                    continue;
+                mRows[mPlaneCount] = map->getBlockedRows(type);
+                mColumns[mPlaneCount++] = map->getBlockedColumns(type);
+            }
+        }
+
+        bool isWalkable(int x, int y) const
+        {
+            return x >= mMinX && y >= mMinY && x <= mMaxX && y <= mMaxY &&
+                   mMap->getWalk(x, y, mWalkmask);
+        }
+
+        /**
+         * Jumps from a tile in a direction, checking the tile itself first.
+         *
+         * @return the tile index of the jump point, or -1 if none.
+         */
+        int jump(int x, int y, int dx, int dy) const;
+
+    private:
+        /**
+         * Gets the blocked bits of a word of a row (or of a column when
+         * \a columns is set), with the tiles outside the search blocked.
+         */
+        uint64_t getBlockedBits(bool columns, int line, int word) const;
+
+        /**
+         * Scans a row (or a column) from a position in a direction, for the
+         * first tile that is blocked, the destination, or a jump point.
+         *
+         * @return the position of the jump point, or -1 if a blocked tile
+         *         comes first.
+         */
+        int scan(bool columns, int line, int pos, int dir) const;
+
+        const Map *mMap;
+        int mWidth;
+        int mDestX, mDestY;
+        unsigned char mWalkmask;
+        int mMinX, mMinY, mMaxX, mMaxY;
+
+        /** Walkability planes of the block types of the walkmask. */
+        const uint64_t *mRows[NB_BLOCKTYPES];
+        const uint64_t *mColumns[NB_BLOCKTYPES];
+        int mPlaneCount;
+};
+
+} // anonymous namespace
+
+uint64_t JumpPointSearch::getBlockedBits(bool columns, int line,
+                                         int word) const
+{
+    const int minLine = columns ? mMinX : mMinY;
+    const int maxLine = columns ? mMaxX : mMaxY;
+    const int words = columns ? mMap->getColumnWords() : mMap->getRowWords();
+    if (line < minLine || line > maxLine || word < 0 || word >= words)
+        return ~uint64_t(0);
+
+    const uint64_t *const *planes = columns ? mColumns : mRows;
+    const int index = line * words + word;
+    uint64_t bits = 0;
+    for (int i = 0; i < mPlaneCount; ++i)
+        bits |= planes[i][index];
+    if (word == words - 1)
+        bits |= columns ? mMap->getColumnPadding() : mMap->getRowPadding();
+
+    // Block the tiles outside the search
+    const int min = (columns ? mMinY : mMinX) - word * 64;
+    const int max = (columns ? mMaxY : mMaxX) - word * 64;
+    if (min > 0)
+        bits |= min >= 64 ? ~uint64_t(0) : ~(~uint64_t(0) << min);
+    if (max < 63)
+        bits |= max < 0 ? ~uint64_t(0) : ~uint64_t(0) << (max + 1);
+    return bits;
+}
+
+int JumpPointSearch::scan(bool columns, int line, int pos, int dir) const
+{
+    // A tile is a jump point when a tile beside it is walkable while the one
+    // behind that is not: the path may turn there.
+    const int destLine = columns ? mDestX : mDestY;
+    const int destPos = columns ? mDestY : mDestX;
+    const int words = columns ? mMap->getColumnWords() : mMap->getRowWords();
+
+    // Words of the lines beside the scan, on the side the scan comes from
+    int word = pos >> 6;
+    uint64_t lastBefore = getBlockedBits(columns, line - 1, word - dir);
+    uint64_t lastAfter = getBlockedBits(columns, line + 1, word - dir);
+
+    for (; word >= 0 && word < words; word += dir)
+    {
+        const uint64_t blocked = getBlockedBits(columns, line, word);
+        const uint64_t before = getBlockedBits(columns, line - 1, word);
+        const uint64_t after = getBlockedBits(columns, line + 1, word);
+
+        uint64_t behindBefore, behindAfter;
+        if (dir > 0)
+        {
+            behindBefore = (before << 1) | (lastBefore >> 63);
+            behindAfter = (after << 1) | (lastAfter >> 63);
+        }
+        else
+        {
+            behindBefore = (before >> 1) | (lastBefore << 63);
+            behindAfter = (after >> 1) | (lastAfter << 63);
+        }
+        lastBefore = before;
+        lastAfter = after;
+
+        uint64_t found = blocked |
+                (~before & behindBefore) | (~after & behindAfter);
+        if (line == destLine && destPos >> 6 == word)
+            found |= uint64_t(1) << (destPos & 63);
+
+        // Ignore the tiles behind the start of the scan
+        if (word == pos >> 6)
+        {
+            if (dir > 0)
+                found &= ~uint64_t(0) << (pos & 63);
+            else
+                found &= ~uint64_t(0) >> (63 - (pos & 63));
+        }
+
+        if (found)
+        {
+            const int bit = dir > 0 ? countTrailingZeros(found)
+                                    : highestBit(found);
+            return (blocked >> bit) & 1 ? -1 : word * 64 + bit;
+        }
+    }
+    return -1;
+}
+
+int JumpPointSearch::jump(int x, int y, int dx, int dy) const
+{
+    if (dx == 0 || dy == 0)
+    {
+        // Straight moves
+        if (x < 0 || y < 0 || x >= mMap->getWidth() || y >= mMap->getHeight())
+            return -1;
+
+        if (dy == 0)
+        {
+            const int found = scan(false, y, x, dx);
+            return found < 0 ? -1 : found + y * mWidth;
+        }
+
+        const int found = scan(true, x, y, dy);
+        return found < 0 ? -1 : x + found * mWidth;
+    }
+
+    // Diagonal moves, stopping where a straight move finds a jump point
+    while (isWalkable(x, y))
+    {
+        if ((x == mDestX && y == mDestY) ||
+            jump(x + dx, y, dx, 0) >= 0 || jump(x, y + dy, 0, dy) >= 0)
+            return x + y * mWidth;
+
+        // Corners cannot be cut
+        if (!isWalkable(x + dx, y) || !isWalkable(x, y + dy))
+            break;
+
+        x += dx;
+        y += dy;
+    }
+    return -1;
+}
+
+/* Per thread, see the threading notes of Map. */
+static thread_local SearchState searchState;
+
+static int sign(int value)
+{
+    return (value > 0) - (value < 0);
+}
+
+Path findJumpPointPath(const Map *map,
+                       int startX, int startY,
+                       int destX, int destY,
+                       unsigned char walkmask,
+                       int maxCost)
+{
+    Path path;
+
+    if (!map->contains(startX, startY) ||
+        !map->getWalk(destX, destY, walkmask) ||
+        (startX == destX && startY == destY))
+        return path;
+
+    const JumpPointSearch search(map, startX, startY, destX, destY,
+                                 walkmask, maxCost);
+    if (!search.isWalkable(destX, destY))
+        return path;
+
+    const int width = map->getWidth();
+    const int start = startX + startY * width;
+    const int goal = destX + destY * width;
+    const int costLimit = maxCost * basicCost;
+
+    SearchState &state = searchState;
+    state.prepare(width * map->getHeight());
+
+    std::priority_queue<OpenNode> openList;
+    state.Gcost[start] = 0;
+    state.parent[start] = start;
+    state.whichList[start] = state.onOpenList;
+    openList.push(OpenNode(start, 0));
+
+    bool foundPath = false;
+    while (!openList.empty())
+    {
+        const OpenNode curr = openList.top();
+        openList.pop();
+
+        if (state.whichList[curr.tile] == state.onClosedList)
+            continue;
+        state.whichList[curr.tile] = state.onClosedList;
+
+        if (curr.tile == goal)
+        {
+            foundPath = true;
+            break;
+        }
+
+        const int x = curr.tile % width, y = curr.tile / width;
+
+        // Directions worth searching, depending on where we come from
+        int directions[8][2];
+        int count = 0;
+        if (curr.tile == start)
+        {
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    if (dx == 0 && dy == 0)
+                        continue;
+                    directions[count][0] = dx;
+                    directions[count++][1] = dy;
+                }
+            }
+        }
+        else
+        {
+            const int parent = state.parent[curr.tile];
+            const int dx = sign(x - parent % width);
+            const int dy = sign(y - parent / width);
+
+            if (dx != 0 && dy != 0)
+            {
+                directions[count][0] = dx;
+                directions[count++][1] = 0;
+                directions[count][0] = 0;
+                directions[count++][1] = dy;
+                directions[count][0] = dx;
+                directions[count++][1] = dy;
+            }
+            else if (dx != 0)
+            {
+                directions[count][0] = dx;
+                directions[count++][1] = 0;
+                for (int side = -1; side <= 1; side += 2)
+                {
+                    if (!search.isWalkable(x, y + side))
+                        continue;
+                    directions[count][0] = 0;
+                    directions[count++][1] = side;
+                    directions[count][0] = dx;
+                    directions[count++][1] = side;
+                }
+            }
+            else
+            {
+                directions[count][0] = 0;
+                directions[count++][1] = dy;
+                for (int side = -1; side <= 1; side += 2)
+                {
+                    if (!search.isWalkable(x + side, y))
+                        continue;
+                    directions[count][0] = side;
+                    directions[count++][1] = 0;
+                    directions[count][0] = side;
+                    directions[count++][1] = dy;
+                }
+            }
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            const int dx = directions[i][0], dy = directions[i][1];
+
+            // Diagonal moves cannot cut corners
+            if (dx != 0 && dy != 0 &&
+                (!search.isWalkable(x + dx, y) ||
+                 !search.isWalkable(x, y + dy)))
+                continue;
+
+            const int tile = search.jump(x + dx, y + dy, dx, dy);
+            if (tile < 0 || state.whichList[tile] == state.onClosedList)
+                continue;
+
+            const int tileX = tile % width, tileY = tile / width;
+            const int steps = std::max(std::abs(tileX - x),
+                                       std::abs(tileY - y));
+            const int Gcost = state.Gcost[curr.tile] + steps *
+                    (dx != 0 && dy != 0 ? diagonalCost : straightCost);
+            if (Gcost > costLimit)
+                continue;
+
+            if (state.whichList[tile] != state.onOpenList ||
+                Gcost < state.Gcost[tile])
+            {
+                state.whichList[tile] = state.onOpenList;
+                state.Gcost[tile] = Gcost;
+                state.parent[tile] = curr.tile;
+
+                const int hx = std::abs(tileX - destX);
+                const int hy = std::abs(tileY - destY);
+                const int Hcost = std::abs(hx - hy) * basicCost +
+                        std::min(hx, hy) * diagonalCost;
+                openList.push(OpenNode(tile, Gcost + Hcost));
+            }
+        }
+    }
+
+    if (!foundPath)
+        return path;
+
+    // Fill in the tiles between the jump points
+    for (int tile = goal; tile != start; tile = state.parent[tile])
+    {
+        const int parent = state.parent[tile];
+        int x = tile % width, y = tile / width;
+        const int dx = sign(parent % width - x);
+        const int dy = sign(parent / width - y);
+        while (x + y * width != parent)
+        {
+            path.push_back(Point(x, y));
+            x += dx;
+            y += dy;
+        }
+    }
+    std::reverse(path.begin(), path.end());
+
+    return path;
+}
@@ -0,0 +1,40 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JUMPPOINTSEARCH_H
+#define JUMPPOINTSEARCH_H
+
+#include "game-server/map.h"
+
+/**
+ * Finds a path with jump point search, an A* that only stops on the tiles
+ * where the path may have to turn. Straight stretches are skipped by
+ * scanning the walkability bits of the map a word at a time.
+ *
+ * The paths are as short as the ones of the plain search, the same rules
+ * apply to diagonal moves and \a maxCost has the same meaning.
+ */
+Path findJumpPointPath(const Map *map,
+                       int startX, int startY,
+                       int destX, int destY,
+                       unsigned char walkmask,
+                       int maxCost);
+
+#endif // JUMPPOINTSEARCH_H
@@ -35,12 +35,14 @@
 #include "game-server/postman.h"
 #include "game-server/state.h"
 #include "game-server/settingsmanager.h"
+#include "game-server/tickprofiler.h"
 #include "net/bandwidth.h"
 #include "net/connectionhandler.h"
 #include "net/messageout.h"
 #include "scripting/scriptmanager.h"
 #include "utils/logger.h"
 #include "utils/processorutils.h"
+#include "utils/rangefilter.h"
 #include "utils/stringfilter.h"
 #include "utils/timer.h"
 #include "utils/mathutils.h"
@@ -158,6 +160,18 @@ static void initializeServer()
     // Initialize the processor utility functions
     utils::processor::init();
 
+    // Use the fastest range filters supported by the processor
+    utils::rangefilter::init();
+    LOG_INFO("Using " << utils::rangefilter::getName(
+                 utils::rangefilter::getImplementation())
+             << " range filters.");
+
+    // Start the map and path worker threads, if enabled
+    GameState::initialize();
+
+    // Read the tick profiler options
+    TickProfiler::initialize();
+
     // Seed the random number generator
     std::srand( time(nullptr) );
 }
@@ -171,6 +185,9 @@ static void deinitializeServer()
     // Stop world timer
     worldTimer.stop();
 
+    // Stop the map and path worker threads
+    GameState::deinitialize();
+
     // Quit ENet
     enet_deinitialize();
 
@@ -386,6 +403,9 @@ int main(int argc, char *argv[])
 
         while (elapsedTicks > 0)
         {
+            const TickProfiler::Clock::time_point tickStart =
+                    TickProfiler::Clock::now();
+
             currentTick++;
             elapsedTicks--;
 
@@ -398,7 +418,10 @@ int main(int argc, char *argv[])
                 accountServerLost = false;
 
                 // Handle all messages that are in the message queues
-                accountHandler->process();
+                {
+                    TickProfiler::PhaseTimer timer(TickProfiler::PHASE_ACCOUNT);
+                    accountHandler->process();
+                }
 
                 if (currentTick % 100 == 0) {
                     accountHandler->syncChanges(true);
@@ -412,6 +435,20 @@ int main(int argc, char *argv[])
                     LOG_INFO("Total Account Input: " << gBandwidth->totalInterServerIn() << " Bytes");
                     LOG_INFO("Total Client Output: " << gBandwidth->totalClientOut() << " Bytes");
                     LOG_INFO("Total Client Input: " << gBandwidth->totalClientIn() << " Bytes");
+                    LOG_INFO("Client Packets Saved by Batching: " << gBandwidth->totalPacketsSaved()
+                             << " (" << gBandwidth->totalBatchedMessages() << " Messages Batched)");
+
+                    unsigned pathCacheHits = 0, pathCacheMisses = 0;
+                    for (auto &it : MapManager::getMaps())
+                    {
+                        if (const Map *map = it.second->getMap())
+                        {
+                            pathCacheHits += map->getPathCacheHits();
+                            pathCacheMisses += map->getPathCacheMisses();
+                        }
+                    }
+                    LOG_INFO("Path Cache: " << pathCacheHits << " Hits, "
+                             << pathCacheMisses << " Misses");
                 }
             }
             else
@@ -430,11 +467,20 @@ int main(int argc, char *argv[])
                     accountHandler->start(options.port);
                 }
             }
-            gameHandler->process();
+            {
+                TickProfiler::PhaseTimer timer(TickProfiler::PHASE_GAME);
+                gameHandler->process();
+            }
             // Update all active objects/beings
             GameState::update(currentTick);
             // Send potentially urgent outgoing messages
-            gameHandler->flush();
+            {
+                TickProfiler::PhaseTimer timer(TickProfiler::PHASE_FLUSH);
+                gameHandler->flush();
+            }
+
+            TickProfiler::endTick(currentTick,
+                                  TickProfiler::elapsed(tickStart));
         }
     }
 
@@ -25,6 +25,10 @@
 #include <limits.h>
 
 #include "game-server/map.h"
+#include "game-server/flowfield.h"
+#include "game-server/jumppointsearch.h"
+#include "game-server/pathcache.h"
+#include "game-server/pathhierarchy.h"
 
 #include "common/defines.h"
 
@@ -66,6 +70,11 @@ class FindPath
                          unsigned char walkmask, int maxCost,
                          const Map *map);
 
+        Path nearest(int startX, int startY,
+                     const std::vector<Point> &goals,
+                     unsigned char walkmask, int maxCost,
+                     const Map *map, int &goal);
+
     private:
         PathInfo *getInfo(int x, int y)
         { return &mPathInfos.at(x + y * mWidth); }
@@ -77,7 +86,8 @@ class FindPath
         unsigned mOnClosedList, mOnOpenList;
 };
 
-static FindPath findPath;
+/* Per thread, see the threading notes of Map. */
+static thread_local FindPath findPath;
 
 
 /**
@@ -103,8 +113,15 @@ class Location
 Map::Map(int width, int height, int tileWidth, int tileHeight):
     mWidth(width), mHeight(height),
     mTileWidth(tileWidth), mTileHeight(tileHeight),
-    mMetaTiles(width * height)
+    mMetaTiles(width * height),
+    mJumpPointSearch(true),
+    mPathHierarchy(nullptr),
+    mPathCache(nullptr),
+    mRegionLimit(0)
 {
+    for (unsigned i = 0; i < NB_BLOCKTYPES; ++i)
+        mGenerations[i] = 0;
+    resetWalkPlanes();
 }
 
 Map::~Map()
@@ -114,6 +131,13 @@ Map::~Map()
     {
         delete *it;
     }
+    delete mPathHierarchy;
+    delete mPathCache;
+    for (std::vector<FlowField*>::iterator it = mFlowFields.begin();
+         it != mFlowFields.end(); ++it)
+    {
+        delete *it;
+    }
 }
 
 void Map::setSize(int width, int height)
@@ -122,6 +146,49 @@ void Map::setSize(int width, int height)
     mHeight = height;
 
     mMetaTiles.resize(width * height);
+    resetWalkPlanes();
+}
+
+const unsigned char Map::blockMasks[NB_BLOCKTYPES] = {
+    BLOCKMASK_WALL,
+    BLOCKMASK_CHARACTER,
+    BLOCKMASK_MONSTER
+};
+
+void Map::resetWalkPlanes()
+{
+    mRowWords = (mWidth + 63) / 64;
+    mColumnWords = (mHeight + 63) / 64;
+    mRowPadding = mWidth % 64 ? ~uint64_t(0) << (mWidth % 64) : 0;
+    mColumnPadding = mHeight % 64 ? ~uint64_t(0) << (mHeight % 64) : 0;
+
+    for (unsigned i = 0; i < NB_BLOCKTYPES; ++i)
+    {
+        mRowPlanes[i].assign(mRowWords * mHeight, 0);
+        mColumnPlanes[i].assign(mColumnWords * mWidth, 0);
+    }
+
+    for (int y = 0; y < mHeight; ++y)
+        for (int x = 0; x < mWidth; ++x)
+            for (unsigned i = 0; i < NB_BLOCKTYPES; ++i)
+                if (mMetaTiles[x + y * mWidth].occupation[i])
+                    setBlocked(x, y, BlockType(i), true);
+}
+
+void Map::setBlocked(int x, int y, BlockType type, bool blocked)
+{
+    uint64_t &row = mRowPlanes[type][y * mRowWords + x / 64];
+    uint64_t &column = mColumnPlanes[type][x * mColumnWords + y / 64];
+    if (blocked)
+    {
+        row |= uint64_t(1) << (x % 64);
+        column |= uint64_t(1) << (y % 64);
+    }
+    else
+    {
+        row &= ~(uint64_t(1) << (x % 64));
+        column &= ~(uint64_t(1) << (y % 64));
+    }
 }
 
 const std::string &Map::getProperty(const std::string &key) const
@@ -141,13 +208,26 @@ void Map::blockTile(int x, int y, BlockType type)
 
     MetaTile &metaTile = mMetaTiles[x + y * mWidth];
 
-    if (metaTile.occupation[type] < UINT_MAX &&
+    if (metaTile.occupation[type] < USHRT_MAX &&
         (++metaTile.occupation[type]) > 0)
     {
+        if (metaTile.occupation[type] == 1)
+        {
+            ++mGenerations[type];
+            setBlocked(x, y, type, true);
+        }
+
         switch (type)
         {
             case BLOCKTYPE_WALL:
                 metaTile.blockmask |= BLOCKMASK_WALL;
+                if (metaTile.occupation[type] == 1)
+                {
+                    if (mPathHierarchy)
+                        mPathHierarchy->invalidate(x, y);
+                    if (!mRegions.empty())
+                        splitRegion(x, y);
+                }
                 break;
             case BLOCKTYPE_CHARACTER:
                 metaTile.blockmask |= BLOCKMASK_CHARACTER;
@@ -172,10 +252,17 @@ void Map::freeTile(int x, int y, BlockType type)
 
     if (!(--metaTile.occupation[type]))
     {
+        ++mGenerations[type];
+        setBlocked(x, y, type, false);
+
         switch (type)
         {
             case BLOCKTYPE_WALL:
                 metaTile.blockmask &= (BLOCKMASK_WALL xor 0xff);
+                if (mPathHierarchy)
+                    mPathHierarchy->invalidate(x, y);
+                if (!mRegions.empty())
+                    mergeRegions(x, y);
                 break;
             case BLOCKTYPE_CHARACTER:
                 metaTile.blockmask &= (BLOCKMASK_CHARACTER xor 0xff);
@@ -204,12 +291,547 @@ Path Map::findPath(int startX, int startY,
                    int destX, int destY,
                    unsigned char walkmask, int maxCost) const
 {
+    const int dx = std::abs(destX - startX), dy = std::abs(destY - startY);
+
+    // No need to search when even a straight line costs too much, or when
+    // walls separate the tiles
+    if ((std::abs(dx - dy) * 100 + std::min(dx, dy) * (100 * 362 / 256)) >
+        maxCost * 100)
+        return Path();
+    if (!isReachable(startX, startY, destX, destY, walkmask))
+        return Path();
+
+    // Long paths are first searched on the graph of the clusters, which
+    // ignores anything but walls
+    if (mPathHierarchy && (walkmask & BLOCKMASK_WALL) &&
+        std::max(dx, dy) > mPathHierarchy->getClusterSize())
+    {
+        return mPathHierarchy->findPath(startX, startY, destX, destY,
+                                        walkmask, maxCost);
+    }
+
+    if (mJumpPointSearch)
+    {
+        return findJumpPointPath(this, startX, startY, destX, destY,
+                                 walkmask, maxCost);
+    }
+
     return ::findPath(startX, startY,
                       destX, destY,
                       walkmask, maxCost,
                       this);
 }
 
+Path Map::findNearestPath(int startX, int startY,
+                          const std::vector<Point> &goals,
+                          unsigned char walkmask, int maxCost,
+                          int &goal) const
+{
+    goal = -1;
+    if (!contains(startX, startY))
+        return Path();
+
+    return ::findPath.nearest(startX, startY, goals, walkmask, maxCost,
+                              this, goal);
+}
+
+void Map::initializePathHierarchy(int clusterSize)
+{
+    delete mPathHierarchy;
+    mPathHierarchy = nullptr;
+
+    if (clusterSize > 0)
+        mPathHierarchy = new PathHierarchy(this, clusterSize);
+}
+
+Map *Map::createWalkSnapshot() const
+{
+    Map *snapshot = new Map(mWidth, mHeight, mTileWidth, mTileHeight);
+    snapshot->mMetaTiles = mMetaTiles;
+    for (unsigned i = 0; i < NB_BLOCKTYPES; ++i)
+    {
+        snapshot->mRowPlanes[i] = mRowPlanes[i];
+        snapshot->mColumnPlanes[i] = mColumnPlanes[i];
+        snapshot->mGenerations[i] = mGenerations[i];
+    }
+    snapshot->mJumpPointSearch = mJumpPointSearch;
+    snapshot->mRegions = mRegions;
+
+    // Point the labels straight at their region, the snapshot never changes
+    snapshot->mRegionParents.resize(mRegionParents.size());
+    for (unsigned i = 0; i < mRegionParents.size(); ++i)
+    {
+        const unsigned parent = mRegionParents[i];
+        snapshot->mRegionParents[i] = parent < i ?
+                snapshot->mRegionParents[parent] : parent;
+    }
+    return snapshot;
+}
+
+bool Map::isLineWalkable(int startX, int startY, int destX, int destY,
+                         unsigned char walkmask) const
+{
+    // Walks the tiles touched by the line, like Bresenham's algorithm but
+    // without skipping the tiles only crossed at one end
+    const int stepX = destX > startX ? 1 : -1;
+    const int stepY = destY > startY ? 1 : -1;
+    const int dx = std::abs(destX - startX), dy = std::abs(destY - startY);
+    const int ddx = 2 * dx, ddy = 2 * dy;
+
+    int x = startX, y = startY;
+    if (ddx >= ddy)
+    {
+        int error = dx, previousError = dx;
+        for (int i = 0; i < dx; ++i)
+        {
+            x += stepX;
+            error += ddy;
+            if (error > ddx)
+            {
+                y += stepY;
+                error -= ddx;
+                if (error + previousError < ddx)
+                {
+                    if (!getWalk(x, y - stepY, walkmask))
+                        return false;
+                }
+                else if (error + previousError > ddx)
+                {
+                    if (!getWalk(x - stepX, y, walkmask))
+                        return false;
+                }
+                else if (!getWalk(x, y - stepY, walkmask) ||
+                         !getWalk(x - stepX, y, walkmask))
+                {
+                    return false;
+                }
+            }
+            if (!getWalk(x, y, walkmask))
+                return false;
+            previousError = error;
+        }
+    }
+    else
+    {
+        int error = dy, previousError = dy;
+        for (int i = 0; i < dy; ++i)
+        {
+            y += stepY;
+            error += ddx;
+            if (error > ddy)
+            {
+                x += stepX;
+                error -= ddy;
+                if (error + previousError < ddy)
+                {
+                    if (!getWalk(x - stepX, y, walkmask))
+                        return false;
+                }
+                else if (error + previousError > ddy)
+                {
+                    if (!getWalk(x, y - stepY, walkmask))
+                        return false;
+                }
+                else if (!getWalk(x - stepX, y, walkmask) ||
+                         !getWalk(x, y - stepY, walkmask))
+                {
+                    return false;
+                }
+            }
+            if (!getWalk(x, y, walkmask))
+                return false;
+            previousError = error;
+        }
+    }
+    return true;
+}
+
+void Map::smoothPath(int startX, int startY, Path &path,
+                     unsigned char walkmask) const
+{
+    if (path.size() < 2)
+        return;
+
+    // Keep the farthest tile in sight of the previous waypoint each time
+    Path waypoints;
+    Point from(startX, startY);
+    for (size_t i = 0; i < path.size(); ++i)
+    {
+        size_t last = i;
+        while (last + 1 < path.size() &&
+               isLineWalkable(from.x, from.y,
+                              path[last + 1].x, path[last + 1].y, walkmask))
+        {
+            ++last;
+        }
+
+        waypoints.push_back(path[last]);
+        from = path[last];
+        i = last;
+    }
+    path.swap(waypoints);
+}
+
+void Map::findCachedPath(int startX, int startY,
+                         int destX, int destY,
+                         unsigned char walkmask, int maxCost,
+                         Path &path)
+{
+    if (!mPathCache || !contains(startX, startY) || !contains(destX, destY) ||
+        !isReachable(startX, startY, destX, destY, walkmask))
+    {
+        const Path found = findPath(startX, startY, destX, destY,
+                                    walkmask, maxCost);
+        path.assign(found.begin(), found.end());
+        return;
+    }
+
+    const int start = startX + startY * mWidth;
+    const int dest = destX + destY * mWidth;
+    const unsigned generation = getGeneration(walkmask);
+
+    const Path *cached = mPathCache->find(start, dest, walkmask, maxCost,
+                                          generation);
+    if (!cached)
+    {
+        Path found = findPath(startX, startY, destX, destY, walkmask, maxCost);
+        cached = &mPathCache->insert(start, dest, walkmask, maxCost,
+                                     generation, found);
+    }
+    path.assign(cached->begin(), cached->end());
+}
+
+int Map::getPathLength(int startX, int startY,
+                       int destX, int destY,
+                       unsigned char walkmask, int maxCost)
+{
+    if (!mPathCache || !contains(startX, startY) || !contains(destX, destY) ||
+        !isReachable(startX, startY, destX, destY, walkmask))
+        return findPath(startX, startY, destX, destY, walkmask,
+                        maxCost).size();
+
+    const int start = startX + startY * mWidth;
+    const int dest = destX + destY * mWidth;
+    const unsigned generation = getGeneration(walkmask);
+
+    if (const Path *path = mPathCache->find(start, dest, walkmask, maxCost,
+                                            generation))
+        return path->size();
+
+    Path path = findPath(startX, startY, destX, destY, walkmask, maxCost);
+    return mPathCache->insert(start, dest, walkmask, maxCost, generation,
+                              path).size();
+}
+
+void Map::initializePathCache(unsigned capacity)
+{
+    delete mPathCache;
+    mPathCache = capacity > 0 ? new PathCache(capacity) : nullptr;
+}
+
+unsigned Map::getPathCacheHits() const
+{
+    return mPathCache ? mPathCache->getHits() : 0;
+}
+
+unsigned Map::getPathCacheMisses() const
+{
+    return mPathCache ? mPathCache->getMisses() : 0;
+}
+
+/* Number of ticks a flow field is kept. Fields toward a moving target are
+   replaced as soon as the target changes tile, old ones expire. */
+static const int flowFieldLifetime = 10;
+
+/* Number of flow fields kept by a map. */
+static const unsigned maxFlowFields = 8;
+
+const FlowField *Map::getFlowField(int targetX, int targetY,
+                                   unsigned char walkmask, int radius,
+                                   int tick, bool build)
+{
+    if (!contains(targetX, targetY))
+        return nullptr;
+
+    // Fields only depend on the walls
+    const unsigned generation = getGeneration(walkmask & BLOCKMASK_WALL);
+
+    std::vector<FlowField*>::iterator slot = mFlowFields.end();
+    bool outdated = false;
+    for (std::vector<FlowField*>::iterator it = mFlowFields.begin();
+         it != mFlowFields.end(); ++it)
+    {
+        const FlowField *field = *it;
+        if (field->getTargetX() == targetX &&
+            field->getTargetY() == targetY &&
+            field->getWalkmask() == walkmask)
+        {
+            if (field->generation == generation &&
+                field->getRadius() >= radius &&
+                tick - field->tick <= flowFieldLifetime)
+                return field;
+
+            slot = it;
+            outdated = true;
+            break;
+        }
+
+        if (slot == mFlowFields.end() || field->tick < (*slot)->tick)
+            slot = it;
+    }
+
+    if (!build)
+        return nullptr;
+
+    FlowField *field = new FlowField(this, targetX, targetY, walkmask, radius);
+    field->tick = tick;
+    field->generation = generation;
+
+    // Replace the outdated field toward the same target, or the oldest one
+    // when it expired or the map has too many
+    if (slot != mFlowFields.end() &&
+        (outdated || mFlowFields.size() >= maxFlowFields ||
+         tick - (*slot)->tick > flowFieldLifetime))
+    {
+        delete *slot;
+        *slot = field;
+    }
+    else
+    {
+        mFlowFields.push_back(field);
+    }
+    return field;
+}
+
+void Map::initializeRegions()
+{
+    mRegions.assign(mWidth * mHeight, 0);
+    mRegionParents.assign(1, 0);
+
+    for (int y = 0; y < mHeight; ++y)
+        for (int x = 0; x < mWidth; ++x)
+            if (!mRegions[x + y * mWidth] && getWalk(x, y, BLOCKMASK_WALL))
+                fillRegion(x, y, newRegion());
+
+    mRegionLimit = 2 * mRegionParents.size() + 64;
+}
+
+unsigned Map::getRegion(int x, int y) const
+{
+    if (mRegions.empty() || !contains(x, y))
+        return 0;
+
+    unsigned region = mRegions[x + y * mWidth];
+    while (mRegionParents[region] != region)
+        region = mRegionParents[region];
+    return region;
+}
+
+bool Map::isReachable(int startX, int startY, int destX, int destY,
+                      unsigned char walkmask) const
+{
+    if (!(walkmask & BLOCKMASK_WALL))
+        return true;
+
+    // Beings may stand on walls, from where the region is unknown
+    const unsigned start = getRegion(startX, startY);
+    const unsigned dest = getRegion(destX, destY);
+    return !start || !dest || start == dest;
+}
+
+unsigned Map::newRegion()
+{
+    const unsigned region = mRegionParents.size();
+    mRegionParents.push_back(region);
+    return region;
+}
+
+/**
+ * Returns the region a label was merged into, halving the chain of labels
+ * on the way so that later lookups are shorter.
+ */
+unsigned Map::findRegion(unsigned region)
+{
+    while (mRegionParents[region] != region)
+    {
+        mRegionParents[region] = mRegionParents[mRegionParents[region]];
+        region = mRegionParents[region];
+    }
+    return region;
+}
+
+/**
+ * Renumbers the regions from 1 and labels the tiles with them directly,
+ * dropping the labels left over by merges and splits.
+ */
+void Map::compactRegions()
+{
+    std::vector<unsigned> labels(mRegionParents.size(), 0);
+    unsigned count = 0;
+    for (unsigned &region : mRegions)
+    {
+        if (!region)
+            continue;
+
+        unsigned &label = labels[findRegion(region)];
+        if (!label)
+            label = ++count;
+        region = label;
+    }
+
+    mRegionParents.resize(count + 1);
+    for (unsigned i = 0; i <= count; ++i)
+        mRegionParents[i] = i;
+    mRegionLimit = 2 * mRegionParents.size() + 64;
+}
+
+/**
+ * Labels the tiles connected to the given one without crossing walls. Only
+ * straight steps are followed, since diagonal steps may not cut corners.
+ */
+void Map::fillRegion(int x, int y, unsigned region)
+{
+    std::vector<int> open;
+    open.push_back(x + y * mWidth);
+    mRegions[open.back()] = region;
+
+    while (!open.empty())
+    {
+        const int tile = open.back();
+        open.pop_back();
+        const int tileX = tile % mWidth, tileY = tile / mWidth;
+
+        static const int dx[4] = { 1, -1, 0, 0 };
+        static const int dy[4] = { 0, 0, 1, -1 };
+        for (int i = 0; i < 4; ++i)
+        {
+            const int nextX = tileX + dx[i], nextY = tileY + dy[i];
+            if (!contains(nextX, nextY))
+                continue;
+
+            const int next = nextX + nextY * mWidth;
+            if (mRegions[next] != region &&
+                getWalk(nextX, nextY, BLOCKMASK_WALL))
+            {
+                mRegions[next] = region;
+                open.push_back(next);
+            }
+        }
+    }
+}
+
+void Map::splitRegion(int x, int y)
+{
+    mRegions[x + y * mWidth] = 0;
+
+    // The ring of tiles around the new wall, each next to the previous one.
+    // When the free sides of the wall are joined along the ring, the region
+    // stays in one piece.
+    static const int ringX[8] = { -1, 0, 1, 1, 1, 0, -1, -1 };
+    static const int ringY[8] = { -1, -1, -1, 0, 1, 1, 1, 0 };
+    bool free[8];
+    for (int i = 0; i < 8; ++i)
+        free[i] = getWalk(x + ringX[i], y + ringY[i], BLOCKMASK_WALL);
+
+    // Number the runs of free tiles along the ring, the last run wrapping
+    // around to the first one
+    int runs[8];
+    int run = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        if (i > 0 && free[i] && !free[i - 1])
+            ++run;
+        runs[i] = run;
+    }
+    if (free[0] && free[7])
+        for (int i = 0; i < 8; ++i)
+            if (runs[i] == runs[7])
+                runs[i] = runs[0];
+
+    int sideRun = -1;
+    bool split = false;
+    for (int i = 1; i < 8; i += 2)
+    {
+        if (!free[i])
+            continue;
+        if (sideRun == -1)
+            sideRun = runs[i];
+        else if (runs[i] != sideRun)
+            split = true;
+    }
+
+    if (!split)
+        return;
+
+    // Relabel the tiles reachable from each side but the first. Sides that
+    // are still connected end up with the same new label.
+    unsigned region = 0;
+    for (int i = 1; i < 8; i += 2)
+    {
+        const int sideX = x + ringX[i], sideY = y + ringY[i];
+        if (!free[i])
+            continue;
+        if (!region)
+            region = getRegion(sideX, sideY);
+        else if (getRegion(sideX, sideY) == region)
+            fillRegion(sideX, sideY, newRegion());
+    }
+
+    if (mRegionParents.size() > mRegionLimit)
+        compactRegions();
+}
+
+void Map::mergeRegions(int x, int y)
+{
+    static const int dx[4] = { 1, -1, 0, 0 };
+    static const int dy[4] = { 0, 0, 1, -1 };
+
+    unsigned region = 0;
+    unsigned sides[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        const int sideX = x + dx[i], sideY = y + dy[i];
+        sides[i] = 0;
+        if (contains(sideX, sideY) && mRegions[sideX + sideY * mWidth])
+            sides[i] = findRegion(mRegions[sideX + sideY * mWidth]);
+        if (sides[i] && (!region || sides[i] < region))
+            region = sides[i];
+    }
+
+    if (!region)
+    {
+        mRegions[x + y * mWidth] = newRegion();
+    }
+    else
+    {
+        // Point the joined regions and the tiles around at the lowest one
+        mRegions[x + y * mWidth] = region;
+        for (int i = 0; i < 4; ++i)
+        {
+            if (!sides[i])
+                continue;
+            mRegionParents[sides[i]] = region;
+            mRegions[x + dx[i] + (y + dy[i]) * mWidth] = region;
+        }
+    }
+
+    if (mRegionParents.size() > mRegionLimit)
+        compactRegions();
+}
+
+unsigned Map::getGeneration(unsigned char walkmask) const
+{
+    // The sum changes whenever one of the relevant counters does
+    unsigned generation = 0;
+    if (walkmask & BLOCKMASK_WALL)
+        generation += mGenerations[BLOCKTYPE_WALL];
+    if (walkmask & BLOCKMASK_CHARACTER)
+        generation += mGenerations[BLOCKTYPE_CHARACTER];
+    if (walkmask & BLOCKMASK_MONSTER)
+        generation += mGenerations[BLOCKTYPE_MONSTER];
+    return generation;
+}
+
 Path FindPath::operator() (int startX, int startY,
                            int destX, int destY,
                            unsigned char walkmask, int maxCost,
@@ -367,15 +989,176 @@ Path FindPath::operator() (int startX, int startY,
 
         while (pathX != startX || pathY != startY)
         {
-            // Add the new path node to the start of the path list
-            path.push_front(Point(pathX, pathY));
+            // Add the new path node, the path is reversed below
+            path.push_back(Point(pathX, pathY));
 
             // Find out the next parent
             PathInfo *tile = getInfo(pathX, pathY);
             pathX = tile->parentX;
             pathY = tile->parentY;
         }
+        std::reverse(path.begin(), path.end());
+    }
+
+    return path;
+}
+
+Path FindPath::nearest(int startX, int startY,
+                       const std::vector<Point> &goals,
+                       unsigned char walkmask, int maxCost,
+                       const Map *map, int &goal)
+{
+    static int const basicCost = 100;
+
+    Path path;
+    goal = -1;
+
+    // Only keep the goals that can be reached at all
+    std::vector<Point> targets;
+    std::vector<int> indices;
+    for (unsigned i = 0; i < goals.size(); ++i)
+    {
+        const Point &target = goals[i];
+        if (target.x == startX && target.y == startY)
+        {
+            goal = i;
+            return path;
+        }
+        if (!map->contains(target.x, target.y) ||
+            !map->getWalk(target.x, target.y, walkmask) ||
+            !map->isReachable(startX, startY, target.x, target.y, walkmask))
+            continue;
+
+        const int dx = std::abs(target.x - startX);
+        const int dy = std::abs(target.y - startY);
+        if (std::abs(dx - dy) * basicCost +
+            std::min(dx, dy) * (basicCost * 362 / 256) > maxCost * basicCost)
+            continue;
+
+        targets.push_back(target);
+        indices.push_back(i);
+    }
+
+    if (targets.empty())
+        return path;
+
+    prepare(map);
+
+    std::priority_queue<Location> openList;
+
+    PathInfo *startTile = getInfo(startX, startY);
+    startTile->Gcost = 0;
+    openList.push(Location(startX, startY, 0));
+
+    int found = -1;
+    int foundX = 0, foundY = 0;
+
+    // Unlike a search for a single goal, stop only once a goal is taken from
+    // the open list, since a goal reached first may not be the closest one.
+    while (!openList.empty())
+    {
+        Location curr = openList.top();
+        openList.pop();
+        PathInfo *currInfo = getInfo(curr.x, curr.y);
+
+        if (currInfo->whichList == mOnClosedList)
+            continue;
+
+        currInfo->whichList = mOnClosedList;
+
+        // The heuristic is only zero on a goal
+        if (currInfo->Hcost == 0 && (curr.x != startX || curr.y != startY))
+        {
+            for (unsigned i = 0; i < targets.size(); ++i)
+            {
+                if (targets[i].x == curr.x && targets[i].y == curr.y)
+                {
+                    found = indices[i];
+                    break;
+                }
+            }
+            foundX = curr.x;
+            foundY = curr.y;
+            break;
+        }
+
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                int x = curr.x + dx;
+                int y = curr.y + dy;
+
+                if ((dx == 0 && dy == 0) || !map->contains(x, y))
+                    continue;
+
+                PathInfo *newTile = getInfo(x, y);
+
+                if (newTile->whichList == mOnClosedList
+                        || !map->getWalk(x, y, walkmask))
+                    continue;
+
+                if (dx != 0 && dy != 0)
+                {
+                    if (!map->getWalk(curr.x, curr.y + dy, walkmask)
+                            || !map->getWalk(curr.x + dx, curr.y, walkmask))
+                        continue;
+                }
+
+                int Gcost = currInfo->Gcost +
+                    (dx == 0 || dy == 0 ? basicCost + 1
+                                        : basicCost * 362 / 256);
+
+                if (Gcost > maxCost * basicCost)
+                    continue;
+
+                if (newTile->whichList != mOnOpenList)
+                {
+                    // The distance to the closest goal never overestimates
+                    // the cost to the best one
+                    int Hcost = INT_MAX;
+                    for (unsigned i = 0; i < targets.size(); ++i)
+                    {
+                        int dx = std::abs(x - targets[i].x);
+                        int dy = std::abs(y - targets[i].y);
+                        Hcost = std::min(Hcost, std::abs(dx - dy) * basicCost +
+                                         std::min(dx, dy) *
+                                         (basicCost * 362 / 256));
+                    }
+                    newTile->Hcost = Hcost;
+                    newTile->parentX = curr.x;
+                    newTile->parentY = curr.y;
+                    newTile->Gcost = Gcost;
+                    newTile->whichList = mOnOpenList;
+                    openList.push(Location(x, y, Gcost + Hcost));
+                }
+                else if (Gcost < newTile->Gcost)
+                {
+                    newTile->Gcost = Gcost;
+                    newTile->parentX = curr.x;
+                    newTile->parentY = curr.y;
+                    openList.push(Location(x, y, Gcost + newTile->Hcost));
+                }
+            }
+        }
+    }
+
+    if (found == -1)
+        return path;
+
+    goal = found;
+
+    int pathX = foundX;
+    int pathY = foundY;
+    while (pathX != startX || pathY != startY)
+    {
+        path.push_back(Point(pathX, pathY));
+
+        PathInfo *tile = getInfo(pathX, pathY);
+        pathX = tile->parentX;
+        pathY = tile->parentY;
     }
+    std::reverse(path.begin(), path.end());
 
     return path;
 }
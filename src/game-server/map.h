@@ -21,7 +21,7 @@
 #ifndef MAP_H
 #define MAP_H
 
-#include <list>
+#include <cstdint>
 #include <map>
 #include <string>
 #include <vector>
@@ -30,7 +30,11 @@
 #include "utils/point.h"
 #include "utils/string.h"
 
-typedef std::list<Point> Path;
+class FlowField;
+class PathCache;
+class PathHierarchy;
+
+typedef std::vector<Point> Path;
 
 enum BlockType
 {
@@ -56,7 +60,7 @@ class MetaTile
                 occupation[i] = 0;
         }
 
-        unsigned occupation[NB_BLOCKTYPES];
+        unsigned short occupation[NB_BLOCKTYPES];
         char blockmask;          /**< walkability bitfield */
 };
 
@@ -108,6 +112,11 @@ class MapObject
 
 /**
  * A tile map.
+ *
+ * Maps may be updated on worker threads (see game_mapThreads), one thread
+ * per map at a time. Path searches on different maps can thus run at the
+ * same time, so the search code keeps its working state per thread rather
+ * than in shared statics.
  */
 class Map
 {
@@ -201,6 +210,176 @@ class Map
                       unsigned char walkmask,
                       int maxCost = 20) const;
 
+        /**
+         * Finds the shortest path to whichever of the given locations is the
+         * closest, with a single search.
+         *
+         * @param goal set to the index of the location reached, or -1 when
+         *             none of them can be reached within \a maxCost.
+         * @return the path, which is empty when already standing on the
+         *         location.
+         */
+        Path findNearestPath(int startX, int startY,
+                             const std::vector<Point> &goals,
+                             unsigned char walkmask, int maxCost,
+                             int &goal) const;
+
+        /**
+         * Creates a copy of the walkability of the map, which other threads
+         * can search for paths while this map changes.
+         */
+        Map *createWalkSnapshot() const;
+
+        /**
+         * Tells whether the straight line between the centres of two tiles
+         * only crosses walkable tiles, not counting the first one. Lines
+         * going exactly through a corner need both tiles beside it.
+         */
+        bool isLineWalkable(int startX, int startY, int destX, int destY,
+                            unsigned char walkmask) const;
+
+        /**
+         * Replaces the tiles of a path starting next to the given tile with
+         * the fewest waypoints that can be joined by walkable straight lines.
+         */
+        void smoothPath(int startX, int startY, Path &path,
+                        unsigned char walkmask) const;
+
+        /**
+         * Chooses between jump point search and plain A* to find the paths
+         * shorter than a cluster of the path hierarchy.
+         */
+        void setJumpPointSearch(bool enabled)
+        { mJumpPointSearch = enabled; }
+
+        /**
+         * Returns the tiles blocked by a block type, one bit per tile, by
+         * rows. Bit i of word y * getRowWords() + w stands for tile
+         * x = 64 * w + i.
+         */
+        const uint64_t *getBlockedRows(BlockType type) const
+        { return &mRowPlanes[type][0]; }
+
+        /**
+         * Returns the tiles blocked by a block type, one bit per tile, by
+         * columns. Bit i of word x * getColumnWords() + w stands for tile
+         * y = 64 * w + i.
+         */
+        const uint64_t *getBlockedColumns(BlockType type) const
+        { return &mColumnPlanes[type][0]; }
+
+        /**
+         * Returns the bits past the end of a row in its last word.
+         */
+        uint64_t getRowPadding() const
+        { return mRowPadding; }
+
+        /**
+         * Returns the bits past the end of a column in its last word.
+         */
+        uint64_t getColumnPadding() const
+        { return mColumnPadding; }
+
+        /**
+         * Returns the blockmask of a block type.
+         */
+        static unsigned char getBlockMask(BlockType type)
+        { return blockMasks[type]; }
+
+        /**
+         * Returns the number of words of each row for getBlockedRows.
+         */
+        int getRowWords() const
+        { return mRowWords; }
+
+        /**
+         * Returns the number of words of each column for
+         * getBlockedColumns.
+         */
+        int getColumnWords() const
+        { return mColumnWords; }
+
+        /**
+         * Builds the abstract graph used to find paths longer than a cluster
+         * of the given size, in tiles. A size of 0 disables it.
+         */
+        void initializePathHierarchy(int clusterSize);
+
+        /**
+         * Finds a path like findPath, reusing the result of a previous search
+         * with the same parameters when no tile it depends on changed since.
+         * The path is copied into \a path, keeping its storage.
+         */
+        void findCachedPath(int startX, int startY,
+                            int destX, int destY,
+                            unsigned char walkmask, int maxCost,
+                            Path &path);
+
+        /**
+         * Returns the number of steps of the path findCachedPath would
+         * return, without copying it.
+         */
+        int getPathLength(int startX, int startY,
+                          int destX, int destY,
+                          unsigned char walkmask,
+                          int maxCost = 20);
+
+        /**
+         * Keeps up to \a capacity paths for findCachedPath. A capacity of 0
+         * disables the cache.
+         */
+        void initializePathCache(unsigned capacity);
+
+        /**
+         * Returns the number of path searches answered by the cache.
+         */
+        unsigned getPathCacheHits() const;
+
+        /**
+         * Returns the number of path searches the cache could not answer.
+         */
+        unsigned getPathCacheMisses() const;
+
+        /**
+         * Returns a flow field toward a tile, covering at least \a radius
+         * tiles around it. Fields are shared by the beings walking to the
+         * same tile, and kept for a few ticks after \a tick. Without
+         * \a build, only a kept field is returned.
+         *
+         * @return the field, or null when the target is outside the map or
+         *         the field would have to be built.
+         *         It is valid until the next call.
+         */
+        const FlowField *getFlowField(int targetX, int targetY,
+                                      unsigned char walkmask, int radius,
+                                      int tick, bool build);
+
+        /**
+         * Labels the parts of the map that are connected without crossing
+         * walls. They are kept up to date as walls are added or removed.
+         */
+        void initializeRegions();
+
+        /**
+         * Returns the label of the part of the map a tile belongs to, or 0
+         * for walls and when the regions are not initialized.
+         */
+        unsigned getRegion(int x, int y) const;
+
+        /**
+         * Tells whether a path could exist between two tiles. Returns false
+         * only when they are separated by walls and the walkmask does not
+         * let beings cross walls.
+         */
+        bool isReachable(int startX, int startY, int destX, int destY,
+                         unsigned char walkmask) const;
+
+        /**
+         * Returns a value that changes whenever the walkability of a tile
+         * changes for the given blocking bitmask.
+         */
+        unsigned getGeneration(unsigned char walkmask) const;
+
         /**
          * Blockmasks for different entities
          */
@@ -209,13 +388,53 @@ class Map
         static const unsigned char BLOCKMASK_MONSTER = 0x02;  // = bin 0000 0010
 
     private:
+        /** Blockmask of each block type. */
+        static const unsigned char blockMasks[NB_BLOCKTYPES];
+
+        void resetWalkPlanes();
+        void setBlocked(int x, int y, BlockType type, bool blocked);
+
+        unsigned newRegion();
+        unsigned findRegion(unsigned region);
+        void compactRegions();
+        void fillRegion(int x, int y, unsigned region);
+        void splitRegion(int x, int y);
+        void mergeRegions(int x, int y);
+
         // map properties
         int mWidth, mHeight;
         int mTileWidth, mTileHeight;
         std::map<std::string, std::string> mProperties;
 
         std::vector<MetaTile> mMetaTiles;
+
+        /**
+         * Tiles blocked by each block type, one bit per tile. Kept both by
+         * rows and by columns so that a search can scan either with word
+         * operations.
+         */
+        std::vector<uint64_t> mRowPlanes[NB_BLOCKTYPES];
+        std::vector<uint64_t> mColumnPlanes[NB_BLOCKTYPES];
+        int mRowWords, mColumnWords;
+        uint64_t mRowPadding, mColumnPadding;
+        bool mJumpPointSearch;
         std::vector<MapObject*> mMapObjects;
+
+        PathHierarchy *mPathHierarchy;
+        PathCache *mPathCache;
+        std::vector<FlowField*> mFlowFields;
+
+        /**
+         * Region label of each tile, with the labels merged since by
+         * joining walls being redirected to the lowest one. The labels are
+         * renumbered once there are more than mRegionLimit.
+         */
+        std::vector<unsigned> mRegions;
+        std::vector<unsigned> mRegionParents;
+        unsigned mRegionLimit;
+
+        /** Number of walkability changes of each block type. */
+        unsigned mGenerations[NB_BLOCKTYPES];
 };
 
 #endif
@@ -32,11 +32,14 @@
 #include "game-server/mapreader.h"
 #include "game-server/monstermanager.h"
 #include "game-server/spawnareacomponent.h"
+#include "game-server/state.h"
 #include "game-server/triggerareacomponent.h"
 #include "scripting/script.h"
 #include "scripting/scriptmanager.h"
 #include "utils/logger.h"
 #include "utils/point.h"
+#include "utils/rangefilter.h"
+#include "utils/string.h"
 
 /******************************************************************************
  * ObjectBucket
@@ -136,19 +139,27 @@ bool ObjectBucket::isAllocated(int i) const
  * MapZone
  *****************************************************************************/
 
-/* TODO: Implement overlapping map zones instead of strict partitioning.
-   Purpose: to decrease the number of zone changes, as overlapping allows for
-   hysteresis effect and prevents an actor from changing zone each server
-   tick. It requires storing the zone in the actor since it will not be
-   uniquely defined any longer. */
+/* Default pixel-based width and height of the squares used in partitioning
+   the map, overridable per map. Squares should be big enough so that an actor
+   cannot cross several ones in one world tick. The higher the value, the
+   closer we regress to quadratic behavior; the lower the value, the more we
+   waste time in dealing with zone changes. */
+static int const defaultZoneDiam = 256;
 
-/* Pixel-based width and height of the squares used in partitioning the map.
-   Squares should be big enough so that an actor cannot cross several ones
-   in one world tick.
-   TODO: Tune for decreasing server load. The higher the value, the closer we
-   regress to quadratic behavior; the lower the value, the more we waste time
-   in dealing with zone changes. */
-static int const zoneDiam = 256;
+/* Default distance in pixels an actor can wander outside of its zone before
+   being moved to another one. This hysteresis prevents an actor moving along
+   a zone border from changing zone each server tick. Since the zones overlap,
+   the zone of an actor is stored in the actor. */
+static int const defaultZoneMargin = 32;
+
+/* Default size in tiles of the clusters used to find long paths. Larger
+   clusters mean fewer entrances to search, but longer searches to compute the
+   costs inside a cluster when a wall changes. 0 disables them. */
+static int const defaultPathClusterSize = 16;
+
+/* Default number of paths kept by each map, so that beings looking for the
+   same path do not search it again while nothing changed on the way. */
+static int const defaultPathCacheSize = 256;
 
 /**
  * Part of a map.
@@ -163,6 +174,18 @@ struct MapZone
      */
     std::vector< Entity * > objects;
 
+    /**
+     * Copies of the position, size, public ID and type of the objects, stored
+     * at the same index as the objects. They allow filtering the objects of a
+     * zone without touching the entities.
+     * The size is copied when the object enters the zone and is assumed not
+     * to change while the object is on the map.
+     */
+    std::vector< int > xs, ys;
+    std::vector< unsigned char > sizes;
+    std::vector< unsigned short > ids;
+    std::vector< unsigned char > types;
+
     /**
      * Destinations of the objects that left this zone.
      * This is necessary in order to have an accurate iterator around moving
@@ -173,106 +196,105 @@ struct MapZone
     MapZone(): nbCharacters(0), nbMovingObjects(0) {}
     void insert(Entity *);
     void remove(Entity *);
+    void setPosition(unsigned slot, const Point &);
+    void swap(unsigned slot1, unsigned slot2);
 };
 
 void MapZone::insert(Entity *obj)
 {
-    int type = obj->getType();
-    switch (type)
+    auto *actorComponent = obj->getComponent<ActorComponent>();
+    const Point &pos = actorComponent->getPosition();
+    const int type = obj->getType();
+
+    unsigned slot = objects.size();
+    objects.push_back(obj);
+    xs.push_back(pos.x);
+    ys.push_back(pos.y);
+    sizes.push_back(actorComponent->getSize());
+    ids.push_back(actorComponent->getPublicID());
+    types.push_back(type);
+    actorComponent->setZoneSlot(slot);
+
+    // Move the object to the start of its partition
+    if (type == OBJECT_CHARACTER || type == OBJECT_MONSTER ||
+        type == OBJECT_NPC)
     {
-        case OBJECT_CHARACTER:
+        swap(slot, nbMovingObjects);
+        slot = nbMovingObjects;
+        ++nbMovingObjects;
+
+        if (type == OBJECT_CHARACTER)
         {
-            if (nbCharacters != nbMovingObjects)
-            {
-                if (nbMovingObjects != objects.size())
-                {
-                    objects.push_back(objects[nbMovingObjects]);
-                    objects[nbMovingObjects] = objects[nbCharacters];
-                }
-                else
-                {
-                    objects.push_back(objects[nbCharacters]);
-                }
-                objects[nbCharacters] = obj;
-                ++nbCharacters;
-                ++nbMovingObjects;
-                break;
-            }
+            swap(slot, nbCharacters);
             ++nbCharacters;
-        } // no break!
-        case OBJECT_MONSTER:
-        case OBJECT_NPC:
-        {
-            if (nbMovingObjects != objects.size())
-            {
-                objects.push_back(objects[nbMovingObjects]);
-                objects[nbMovingObjects] = obj;
-                ++nbMovingObjects;
-                break;
-            }
-            ++nbMovingObjects;
-        } // no break!
-        default:
-        {
-            objects.push_back(obj);
-            break;
         }
     }
 }
 
 void MapZone::remove(Entity *obj)
 {
-    std::vector< Entity * >::iterator i_beg = objects.begin(), i, i_end;
-    int type = obj->getType();
-    switch (type)
-    {
-        case OBJECT_CHARACTER:
-        {
-            i = i_beg;
-            i_end = objects.begin() + nbCharacters;
-        } break;
-        case OBJECT_MONSTER:
-        case OBJECT_NPC:
-        {
-            i = objects.begin() + nbCharacters;
-            i_end = objects.begin() + nbMovingObjects;
-        } break;
-        default:
-        {
-            i = objects.begin() + nbMovingObjects;
-            i_end = objects.end();
-            break;
-        }
-    }
-    i = std::find(i, i_end, obj);
-    assert(i != i_end);
-    unsigned pos = i - i_beg;
-    if (pos < nbCharacters)
+    unsigned slot = obj->getComponent<ActorComponent>()->getZoneSlot();
+    assert(slot < objects.size() && objects[slot] == obj);
+
+    // Move the object to the end of its partition, then of the zone
+    if (slot < nbCharacters)
     {
-        objects[pos] = objects[nbCharacters - 1];
-        pos = nbCharacters - 1;
+        swap(slot, nbCharacters - 1);
+        slot = nbCharacters - 1;
         --nbCharacters;
     }
-    if (pos < nbMovingObjects)
+    if (slot < nbMovingObjects)
     {
-        objects[pos] = objects[nbMovingObjects - 1];
-        pos = nbMovingObjects - 1;
+        swap(slot, nbMovingObjects - 1);
+        slot = nbMovingObjects - 1;
         --nbMovingObjects;
     }
-    objects[pos] = objects[objects.size() - 1];
+    swap(slot, objects.size() - 1);
+
     objects.pop_back();
+    xs.pop_back();
+    ys.pop_back();
+    sizes.pop_back();
+    ids.pop_back();
+    types.pop_back();
+}
+
+void MapZone::setPosition(unsigned slot, const Point &pos)
+{
+    xs[slot] = pos.x;
+    ys[slot] = pos.y;
+}
+
+void MapZone::swap(unsigned slot1, unsigned slot2)
+{
+    if (slot1 == slot2)
+        return;
+
+    std::swap(objects[slot1], objects[slot2]);
+    std::swap(xs[slot1], xs[slot2]);
+    std::swap(ys[slot1], ys[slot2]);
+    std::swap(sizes[slot1], sizes[slot2]);
+    std::swap(ids[slot1], ids[slot2]);
+    std::swap(types[slot1], types[slot2]);
+    objects[slot1]->getComponent<ActorComponent>()->setZoneSlot(slot1);
+    objects[slot2]->getComponent<ActorComponent>()->setZoneSlot(slot2);
 }
 
 /******************************************************************************
  * MapContent
  *****************************************************************************/
 
+/**
+ * Components of one type, with the entities they belong to.
+ */
+typedef std::vector<std::pair<Entity *, Component *> > ComponentList;
+
 /**
  * Entities on a map.
  */
 struct MapContent
 {
-    MapContent(Map *);
+    MapContent(Map *, int zoneDiam, int zoneMargin);
     ~MapContent();
 
     /**
@@ -298,15 +320,44 @@ struct MapContent
     void fillRegion(MapRegion &, const Rectangle &) const;
 
     /**
-     * Gets zone at given position.
+     * Fills a region of zones within the range of the old and new positions
+     * of a being.
+     */
+    void fillRegion(MapRegion &, Entity *, int) const;
+
+    /**
+     * Gets the index of the zone at given position.
+     */
+    unsigned getZoneIndex(const Point &pos) const;
+
+    /**
+     * Returns whether the given position is close enough to a zone for an
+     * actor in that zone to stay in it.
+     */
+    bool isInZone(unsigned zone, const Point &pos) const;
+
+    /**
+     * Adds an actor to the zone at its position.
+     */
+    void insertInZone(Entity *);
+
+    /**
+     * Removes an actor from its zone.
      */
-    MapZone &getZone(const Point &pos) const;
+    void removeFromZone(Entity *);
 
     /**
      * Entities (items, characters, monsters, etc) located on the map.
      */
     std::vector< Entity * > entities;
 
+    /**
+     * Components of the entities, by type, in the order to update them.
+     * Entries of removed entities are nulled and dropped after the update
+     * of their type, so that entities can be removed while updating.
+     */
+    ComponentList components[ComponentTypeCount];
+
     /**
      * Buckets of MovingObjects located on the map, referenced by ID.
      */
@@ -321,10 +372,13 @@ struct MapContent
 
     unsigned short mapWidth;  /**< Width with respect to zones. */
     unsigned short mapHeight; /**< Height with respect to zones. */
+
+    int zoneDiam;   /**< Width and height of the zones, in pixels. */
+    int zoneMargin; /**< How far an actor can be outside of its zone. */
 };
 
-MapContent::MapContent(Map *map)
-  : last_bucket(0), zones(nullptr)
+MapContent::MapContent(Map *map, int zoneDiam, int zoneMargin)
+  : last_bucket(0), zones(nullptr), zoneDiam(zoneDiam), zoneMargin(zoneMargin)
 {
     buckets[0] = new ObjectBucket;
     buckets[0]->allocate(); // Skip ID 0
@@ -427,6 +481,9 @@ static void addZone(MapRegion &r, unsigned z)
 
 void MapContent::fillRegion(MapRegion &r, const Point &p, int radius) const
 {
+    // Actors may be a bit outside of the zone they are stored in
+    radius += zoneMargin;
+
     int ax = p.x > radius ? (p.x - radius) / zoneDiam : 0,
         ay = p.y > radius ? (p.y - radius) / zoneDiam : 0,
         bx = std::min((p.x + radius) / zoneDiam, mapWidth - 1),
@@ -442,10 +499,11 @@ void MapContent::fillRegion(MapRegion &r, const Point &p, int radius) const
 
 void MapContent::fillRegion(MapRegion &r, const Rectangle &p) const
 {
-    int ax = p.x / zoneDiam,
-        ay = p.y / zoneDiam,
-        bx = std::min((p.x + p.w) / zoneDiam, mapWidth - 1),
-        by = std::min((p.y + p.h) / zoneDiam, mapHeight - 1);
+    // Actors may be a bit outside of the zone they are stored in
+    int ax = p.x > zoneMargin ? (p.x - zoneMargin) / zoneDiam : 0,
+        ay = p.y > zoneMargin ? (p.y - zoneMargin) / zoneDiam : 0,
+        bx = std::min((p.x + p.w + zoneMargin) / zoneDiam, mapWidth - 1),
+        by = std::min((p.y + p.h + zoneMargin) / zoneDiam, mapHeight - 1);
     for (int y = ay; y <= by; ++y)
     {
         for (int x = ax; x <= bx; ++x)
@@ -455,9 +513,64 @@ void MapContent::fillRegion(MapRegion &r, const Rectangle &p) const
     }
 }
 
-MapZone& MapContent::getZone(const Point &pos) const
+/**
+ * Adds the zones of \a other to the region \a r.
+ */
+static void mergeRegion(MapRegion &r, const MapRegion &other)
+{
+    if (other.empty())
+        return;
+
+    MapRegion merged;
+    merged.reserve(r.size() + other.size());
+    std::set_union(r.begin(), r.end(), other.begin(), other.end(),
+                   std::back_insert_iterator< MapRegion >(merged));
+    r.swap(merged);
+}
+
+void MapContent::fillRegion(MapRegion &r, Entity *obj, int radius) const
+{
+    MapRegion r1;
+    fillRegion(r1, obj->getComponent<BeingComponent>()->getOldPosition(),
+               radius);
+    mergeRegion(r, r1);
+    for (MapRegion::iterator i = r1.begin(), i_end = r1.end(); i != i_end; ++i)
+    {
+        /* Fills region with destinations taken around the old position.
+           This is necessary to detect two moving objects changing zones at the
+           same time and at the border, and going in opposite directions (or
+           more simply to detect teleportations, if any). */
+        mergeRegion(r, zones[*i].destinations);
+    }
+    fillRegion(r, obj->getComponent<ActorComponent>()->getPosition(), radius);
+}
+
+unsigned MapContent::getZoneIndex(const Point &pos) const
+{
+    return (pos.x / zoneDiam) + (pos.y / zoneDiam) * mapWidth;
+}
+
+bool MapContent::isInZone(unsigned zone, const Point &pos) const
+{
+    const int x = (zone % mapWidth) * zoneDiam;
+    const int y = (zone / mapWidth) * zoneDiam;
+    return pos.x >= x - zoneMargin && pos.x < x + zoneDiam + zoneMargin &&
+           pos.y >= y - zoneMargin && pos.y < y + zoneDiam + zoneMargin;
+}
+
+void MapContent::insertInZone(Entity *obj)
 {
-    return zones[(pos.x / zoneDiam) + (pos.y / zoneDiam) * mapWidth];
+    auto *actorComponent = obj->getComponent<ActorComponent>();
+    const unsigned zone = getZoneIndex(actorComponent->getPosition());
+    zones[zone].insert(obj);
+    actorComponent->setZone(zone);
+}
+
+void MapContent::removeFromZone(Entity *obj)
+{
+    auto *actorComponent = obj->getComponent<ActorComponent>();
+    zones[actorComponent->getZone()].remove(obj);
+    actorComponent->setZone(-1);
 }
 
 
@@ -600,7 +713,8 @@ MapComposite::MapComposite(int id, const std::string &name):
     mContent(0),
     mName(name),
     mID(id),
-    mPvPRules(PVP_NONE)
+    mPvPRules(PVP_NONE),
+    mZoneChanges(0)
 {
 }
 
@@ -627,6 +741,18 @@ bool MapComposite::activate()
 
     initializeContent();
 
+    const std::string &clusterProperty = mMap->getProperty("pathClusterSize");
+    int clusterSize = clusterProperty.empty() ?
+            Configuration::getValue("game_pathClusterSize",
+                                    defaultPathClusterSize) :
+            utils::stringToInt(clusterProperty);
+    mMap->initializePathHierarchy(clusterSize);
+    mMap->setJumpPointSearch(
+            Configuration::getBoolValue("game_jumpPointSearch", true));
+    mMap->initializePathCache(std::max(0,
+            Configuration::getValue("game_pathCacheSize",
+                                    defaultPathCacheSize)));
+
     std::string sPvP = mMap->getProperty("pvp");
     if (sPvP.empty())
         sPvP = Configuration::getValue("game_defaultPvp", std::string());
@@ -638,6 +764,11 @@ bool MapComposite::activate()
 
     mActive = true;
 
+    TimerWheel &timers = GameState::getTimers();
+    for (const TimerWheel::Callback &callback : mParkedTimers)
+        timers.schedule(0, callback);
+    mParkedTimers.clear();
+
     if (!mInitializeCallback.isValid())
     {
         LOG_WARN("No callback for map initialization found");
@@ -676,31 +807,21 @@ ZoneIterator MapComposite::getInsideRectangleIterator(const Rectangle &p) const
 
 ZoneIterator MapComposite::getAroundBeingIterator(Entity *obj, int radius) const
 {
-    MapRegion r1;
-    mContent->fillRegion(r1,
-                         obj->getComponent<BeingComponent>()->getOldPosition(),
-                         radius);
-    MapRegion r2 = r1;
-    for (MapRegion::iterator i = r1.begin(), i_end = r1.end(); i != i_end; ++i)
+    MapRegion r;
+    mContent->fillRegion(r, obj, radius);
+    return ZoneIterator(r, mContent);
+}
+
+ZoneIterator MapComposite::getAroundBeingsIterator(
+        const std::vector<Entity *> &beings, int radius) const
+{
+    MapRegion r;
+    for (std::vector<Entity *>::const_iterator i = beings.begin(),
+         i_end = beings.end(); i != i_end; ++i)
     {
-        /* Fills region with destinations taken around the old position.
-           This is necessary to detect two moving objects changing zones at the
-           same time and at the border, and going in opposite directions (or
-           more simply to detect teleportations, if any). */
-        MapRegion &r4 = mContent->zones[*i].destinations;
-        if (!r4.empty())
-        {
-            MapRegion r3;
-            r3.reserve(r2.size() + r4.size());
-            std::set_union(r2.begin(), r2.end(), r4.begin(), r4.end(),
-                           std::back_insert_iterator< MapRegion >(r3));
-            r2.swap(r3);
-        }
+        mContent->fillRegion(r, *i, radius);
     }
-    mContent->fillRegion(r2,
-                         obj->getComponent<ActorComponent>()->getPosition(),
-                         radius);
-    return ZoneIterator(r2, mContent);
+    return ZoneIterator(r, mContent);
 }
 
 bool MapComposite::insert(Entity *ptr)
@@ -710,13 +831,18 @@ bool MapComposite::insert(Entity *ptr)
         if (ptr->canMove() && !mContent->allocate(ptr))
             return false;
 
-        const Point &point =
-                ptr->getComponent<ActorComponent>()->getPosition();
-        mContent->getZone(point).insert(ptr);
+        mContent->insertInZone(ptr);
     }
 
     ptr->setMap(this);
     mContent->entities.push_back(ptr);
+
+    for (int type = 0; type < ComponentTypeCount; ++type)
+    {
+        if (Component *component = ptr->getComponent(ComponentType(type)))
+            mContent->components[type].push_back(
+                    std::make_pair(ptr, component));
+    }
     return true;
 }
 
@@ -731,11 +857,26 @@ void MapComposite::remove(Entity *ptr)
         }
     }
 
+    for (int type = 0; type < ComponentTypeCount; ++type)
+    {
+        if (!ptr->getComponent(ComponentType(type)))
+            continue;
+
+        ComponentList &components = mContent->components[type];
+        for (ComponentList::iterator i = components.begin(),
+             i_end = components.end(); i != i_end; ++i)
+        {
+            if (i->first == ptr)
+            {
+                *i = ComponentList::value_type(nullptr, nullptr);
+                break;
+            }
+        }
+    }
+
     if (ptr->isVisible())
     {
-        const Point &point =
-                ptr->getComponent<ActorComponent>()->getPosition();
-        mContent->getZone(point).remove(ptr);
+        mContent->removeFromZone(ptr);
 
         if (ptr->canMove())
         {
@@ -749,14 +890,98 @@ Entity *MapComposite::findEntityById(int publicId) const
     return mContent->findEntityById(publicId);
 }
 
-void MapComposite::update()
+void MapComposite::updatePosition(Entity *ptr)
+{
+    auto *actorComponent = ptr->getComponent<ActorComponent>();
+    mContent->zones[actorComponent->getZone()].setPosition(
+            actorComponent->getZoneSlot(), actorComponent->getPosition());
+}
+
+void MapComposite::getCharactersInRange(const Point &p, int range,
+                                        std::vector<Entity *> &result) const
 {
-    // Update object status
-    const std::vector< Entity * > &entities = getEverything();
-    for (std::vector< Entity * >::const_iterator it = entities.begin(),
-         it_end = entities.end(); it != it_end; ++it)
+    MapRegion r;
+    mContent->fillRegion(r, p, range);
+    std::vector<unsigned> hits;
+    for (MapRegion::iterator z = r.begin(), z_end = r.end(); z != z_end; ++z)
+    {
+        const MapZone &zone = mContent->zones[*z];
+        hits.clear();
+        utils::rangefilter::inRange(zone.xs.data(), zone.ys.data(),
+                                    zone.nbCharacters, p, range, hits);
+        for (std::vector<unsigned>::iterator i = hits.begin(),
+             i_end = hits.end(); i != i_end; ++i)
+        {
+            result.push_back(zone.objects[*i]);
+        }
+    }
+}
+
+void MapComposite::getBeingsInRectangle(const Rectangle &rect,
+                                        std::vector<Entity *> &result) const
+{
+    MapRegion r;
+    mContent->fillRegion(r, rect);
+    std::vector<unsigned> hits;
+    for (MapRegion::iterator z = r.begin(), z_end = r.end(); z != z_end; ++z)
+    {
+        const MapZone &zone = mContent->zones[*z];
+        hits.clear();
+        utils::rangefilter::inRectangle(zone.xs.data(), zone.ys.data(),
+                                        zone.nbMovingObjects, rect, hits);
+        for (std::vector<unsigned>::iterator i = hits.begin(),
+             i_end = hits.end(); i != i_end; ++i)
+        {
+            result.push_back(zone.objects[*i]);
+        }
+    }
+}
+
+void MapComposite::getBeingsInCircle(const Point &center, int radius,
+                                     std::vector<Entity *> &result) const
+{
+    MapRegion r;
+    mContent->fillRegion(r, center, radius);
+    std::vector<unsigned> hits;
+    for (MapRegion::iterator z = r.begin(), z_end = r.end(); z != z_end; ++z)
+    {
+        const MapZone &zone = mContent->zones[*z];
+        hits.clear();
+        utils::rangefilter::inCircle(zone.xs.data(), zone.ys.data(),
+                                     zone.sizes.data(), zone.nbMovingObjects,
+                                     center, radius, hits);
+        for (std::vector<unsigned>::iterator i = hits.begin(),
+             i_end = hits.end(); i != i_end; ++i)
+        {
+            result.push_back(zone.objects[*i]);
+        }
+    }
+}
+
+static bool isRemoved(const ComponentList::value_type &entry)
+{
+    return !entry.first;
+}
+
+void MapComposite::updateEntities()
+{
+    // Update object status one component type at a time, so that each loop
+    // runs the same code over components stored close together
+    for (int type = 0; type < ComponentTypeCount; ++type)
     {
-        (*it)->update();
+        ComponentList &components = mContent->components[type];
+
+        // Entities inserted meanwhile wait for the next tick
+        const size_t count = components.size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (Entity *entity = components[i].first)
+                components[i].second->update(*entity);
+        }
+
+        components.erase(std::remove_if(components.begin(), components.end(),
+                                        isRemoved),
+                         components.end());
     }
 
     if (mUpdateCallback.isValid())
@@ -766,7 +991,10 @@ void MapComposite::update()
         s->push(mID);
         s->execute(this);
     }
+}
 
+void MapComposite::updateMovement()
+{
     // Move objects around and update zones.
     for (BeingIterator it(getWholeMapIterator()); it; ++it)
     {
@@ -785,19 +1013,20 @@ void MapComposite::update()
         if (!(*i)->canMove())
             continue;
 
-        const Point &pos1 =
-                (*i)->getComponent<BeingComponent>()->getOldPosition();
-        const Point &pos2 =
-                (*i)->getComponent<ActorComponent>()->getPosition();
+        auto *actorComponent = (*i)->getComponent<ActorComponent>();
+        const Point &pos = actorComponent->getPosition();
+        const unsigned src = actorComponent->getZone();
 
-        MapZone &src = mContent->getZone(pos1),
-                &dst = mContent->getZone(pos2);
-        if (&src != &dst)
-        {
-            addZone(src.destinations, &dst - mContent->zones);
-            src.remove(*i);
-            dst.insert(*i);
-        }
+        // Stay in the current zone while close enough to it
+        if (mContent->isInZone(src, pos))
+            continue;
+
+        const unsigned dst = mContent->getZoneIndex(pos);
+        addZone(mContent->zones[src].destinations, dst);
+        mContent->zones[src].remove(*i);
+        mContent->zones[dst].insert(*i);
+        actorComponent->setZone(dst);
+        ++mZoneChanges;
     }
 }
 
@@ -891,7 +1120,26 @@ const MapObject *MapComposite::findMapObject(const std::string &name,
  */
 void MapComposite::initializeContent()
 {
-    mContent = new MapContent(mMap);
+    // Zone options can be set for each map, using map properties
+    const std::string &diamProperty = mMap->getProperty("zoneDiameter");
+    int zoneDiam = diamProperty.empty() ?
+            Configuration::getValue("game_zoneDiameter", defaultZoneDiam) :
+            utils::stringToInt(diamProperty);
+
+    const std::string &marginProperty = mMap->getProperty("zoneHysteresis");
+    int zoneMargin = marginProperty.empty() ?
+            Configuration::getValue("game_zoneHysteresis", defaultZoneMargin) :
+            utils::stringToInt(marginProperty);
+
+    if (zoneDiam < mMap->getTileWidth() || zoneDiam < mMap->getTileHeight())
+    {
+        LOG_WARN("Zone diameter " << zoneDiam << " of map " << mName
+                 << " is smaller than a tile, using " << defaultZoneDiam);
+        zoneDiam = defaultZoneDiam;
+    }
+    zoneMargin = std::max(0, std::min(zoneMargin, zoneDiam / 2));
+
+    mContent = new MapContent(mMap, zoneDiam, zoneMargin);
 
     const std::vector<MapObject *> &objects = mMap->getObjects();
 
@@ -28,6 +28,7 @@
 
 #include "scripting/script.h"
 #include "game-server/map.h"
+#include "game-server/timerwheel.h"
 
 class Entity;
 class Map;
@@ -158,6 +159,15 @@ class MapComposite
         bool isActive() const
         { return mActive; }
 
+        /**
+         * Keeps the callback of a timer of an entity of this map that fired
+         * while the map is inactive, to call it once the map is activated.
+         * The durations of the entities keep running meanwhile, so the
+         * callbacks are expected to check what is due by then.
+         */
+        void parkTimer(const TimerWheel::Callback &callback)
+        { mParkedTimers.push_back(callback); }
+
         /**
          * Gets the game ID of this map.
          */
@@ -187,9 +197,62 @@ class MapComposite
         Entity *findEntityById(int publicId) const;
 
         /**
-         * Updates zones of every moving beings.
+         * Updates the copy of the position of an actor kept by the map, which
+         * is used by the range queries below. Called when the actor moves.
+         */
+        void updatePosition(Entity *);
+
+        /**
+         * Appends to \a result the characters within \a range pixels of a
+         * point, on both axes.
+         */
+        void getCharactersInRange(const Point &, int range,
+                                  std::vector<Entity *> &result) const;
+
+        /**
+         * Appends to \a result the beings whose position is inside a
+         * rectangle.
+         */
+        void getBeingsInRectangle(const Rectangle &,
+                                  std::vector<Entity *> &result) const;
+
+        /**
+         * Appends to \a result the beings whose bounding circle touches a
+         * circle.
+         */
+        void getBeingsInCircle(const Point &center, int radius,
+                               std::vector<Entity *> &result) const;
+
+        /**
+         * Updates the entities of the map, then moves the beings and updates
+         * their zones.
          */
-        void update();
+        void update()
+        {
+            updateEntities();
+            updateMovement();
+        }
+
+        /**
+         * Updates the status of every entity and runs the map update
+         * callback.
+         */
+        void updateEntities();
+
+        /**
+         * Moves the beings toward their destination and updates the zones
+         * of every moving being.
+         *
+         * @note Only touches the state of this map, so different maps can be
+         *       handled concurrently.
+         */
+        void updateMovement();
+
+        /**
+         * Gets the number of times a being changed zone on this map.
+         */
+        unsigned getZoneChanges() const
+        { return mZoneChanges; }
 
         /**
          * Gets the PvP rules on the map.
@@ -223,6 +286,13 @@ class MapComposite
          */
         ZoneIterator getAroundBeingIterator(Entity *, int radius) const;
 
+        /**
+         * Gets an iterator on the objects around the old and new positions of
+         * several beings, visiting every zone only once.
+         */
+        ZoneIterator getAroundBeingsIterator(const std::vector<Entity *> &,
+                                             int radius) const;
+
         /**
          * Gets everything related to the map.
          */
@@ -286,6 +356,8 @@ class MapComposite
         PvPRules mPvPRules;
         std::map<const std::string, Script::Ref> mMapVariableCallbacks;
         std::map<const std::string, Script::Ref> mWorldVariableCallbacks;
+        unsigned mZoneChanges; /**< Zone changes since the map was loaded. */
+        std::vector<TimerWheel::Callback> mParkedTimers;
 
         static Script::Ref mInitializeCallback;
         static Script::Ref mUpdateCallback;
@@ -144,6 +144,9 @@ Map *MapReader::readMap(xmlNodePtr node)
     // Clean up tilesets
     ::tilesetFirstGids.clear();
 
+    // Label the parts of the map separated by the collision layer
+    map->initializeRegions();
+
     return map;
 }
 
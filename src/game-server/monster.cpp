@@ -29,20 +29,23 @@
 #include "game-server/map.h"
 #include "game-server/mapcomposite.h"
 #include "game-server/state.h"
+#include "game-server/timerwheel.h"
 #include "scripting/scriptmanager.h"
 #include "utils/logger.h"
 #include "utils/speedconv.h"
 
 #include <cmath>
 
+#include <sigc++/adaptors/bind.h>
+
 MonsterComponent::MonsterComponent(Entity &entity, MonsterClass *specy):
-    mSpecy(specy)
+    mSpecy(specy),
+    mDecayTimer(0)
 {
     LOG_DEBUG("Monster spawned! (id: " << mSpecy->getId() << ").");
 
     auto *actorComponent = entity.getComponent<ActorComponent>();
-    actorComponent->setWalkMask(Map::BLOCKMASK_WALL |
-                                Map::BLOCKMASK_CHARACTER);
+    actorComponent->setWalkMask(WALK_MASK);
     actorComponent->setBlockType(BLOCKTYPE_MONSTER);
     actorComponent->setSize(specy->getSize());
 
@@ -82,24 +85,25 @@ MonsterComponent::MonsterComponent(Entity &entity, MonsterClass *specy):
     entity.addComponent(abilityComponent);
     for (auto *abilitiyInfo : specy->getAbilities())
     {
-        abilityComponent->giveAbility(abilitiyInfo);
+        abilityComponent->giveAbility(entity, abilitiyInfo);
     }
 
     beingComponent->signal_died.connect(sigc::mem_fun(this,
                                             &MonsterComponent::monsterDied));
 }
+
+MonsterComponent::~MonsterComponent()
+{
+    GameState::getTimers().cancel(mDecayTimer);
+}
+
 void MonsterComponent::update(Entity &entity)
 {
     auto *beingComponent = entity.getComponent<BeingComponent>();
 
-    // If dead, remove it
+    // Dead monsters are removed by the decay timer
     if (beingComponent->getAction() == DEAD)
-    {
-        if (mDecayTimeout.expired())
-            GameState::enqueueRemove(&entity);
-
         return;
-    }
 
     if (mSpecy->getUpdateCallback().isValid())
     {
@@ -113,6 +117,26 @@ void MonsterComponent::update(Entity &entity)
 
 void MonsterComponent::monsterDied(Entity *monster)
 {
-    mDecayTimeout.set(DECAY_TIME);
+    TimerWheel &timers = GameState::getTimers();
+    timers.cancel(mDecayTimer);
+    mDecayTimer = timers.schedule(DECAY_TIME, sigc::bind(
+            sigc::mem_fun(this, &MonsterComponent::decayed), monster));
+}
+
+void MonsterComponent::decayed(Entity *monster)
+{
+    // A timer parked on an inactive map may fire while a newer one waits
+    if (GameState::getTimers().isPending(mDecayTimer))
+        return;
+    mDecayTimer = 0;
+
+    MapComposite *map = monster->getMap();
+    if (!map->isActive())
+    {
+        map->parkTimer(sigc::bind(
+                sigc::mem_fun(this, &MonsterComponent::decayed), monster));
+        return;
+    }
+    GameState::enqueueRemove(monster);
 }
 
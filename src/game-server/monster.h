@@ -157,12 +157,17 @@ class MonsterClass
 /**
  * The component for a fightable monster with its own AI
  */
-class MonsterComponent : public Component
+class MonsterComponent : public PooledComponent<MonsterComponent>
 {
     public:
         static const ComponentType type = CT_Monster;
 
+        /** Blockmask of the tiles monsters cannot walk on. */
+        static const unsigned char WALK_MASK = Map::BLOCKMASK_WALL |
+                                               Map::BLOCKMASK_CHARACTER;
+
         MonsterComponent(Entity &entity, MonsterClass *);
+        ~MonsterComponent();
 
         /**
          * Returns monster specy.
@@ -181,12 +186,17 @@ class MonsterComponent : public Component
         void monsterDied(Entity *monster);
 
     private:
+        /**
+         * Called by the decay timer to remove the dead monster.
+         */
+        void decayed(Entity *monster);
+
         static const int DECAY_TIME = 50;
 
         MonsterClass *mSpecy;
 
-        /** Time until dead monster is removed */
-        Timeout mDecayTimeout;
+        /** Fires when the dead monster is removed */
+        unsigned mDecayTimer;
 };
 
 inline void MonsterClass::setAttribute(AttributeInfo *attribute, double value)
@@ -30,7 +30,7 @@ class CharacterComponent;
 /**
  * Component describing a non-player character.
  */
-class NpcComponent : public Component
+class NpcComponent : public PooledComponent<NpcComponent>
 {
     public:
         static const ComponentType type = CT_Npc;
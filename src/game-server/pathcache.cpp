@@ -0,0 +1,75 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game-server/pathcache.h"
+
+PathCache::PathCache(unsigned capacity):
+    mCapacity(capacity),
+    mHits(0),
+    mMisses(0)
+{
+    mIndex.reserve(capacity);
+}
+
+const Path *PathCache::find(int start, int dest, unsigned char walkmask,
+                            int maxCost, unsigned generation)
+{
+    const Key key = { start, dest, maxCost, walkmask };
+    auto i = mIndex.find(key);
+    if (i == mIndex.end() || i->second->generation != generation)
+    {
+        ++mMisses;
+        return nullptr;
+    }
+
+    ++mHits;
+    mEntries.splice(mEntries.begin(), mEntries, i->second);
+    return &i->second->path;
+}
+
+const Path &PathCache::insert(int start, int dest, unsigned char walkmask,
+                              int maxCost, unsigned generation, Path &path)
+{
+    const Key key = { start, dest, maxCost, walkmask };
+    auto i = mIndex.find(key);
+    if (i != mIndex.end())
+    {
+        // Outdated path
+        mEntries.splice(mEntries.begin(), mEntries, i->second);
+    }
+    else if (mIndex.size() < mCapacity)
+    {
+        mEntries.push_front(Entry());
+        mIndex[key] = mEntries.begin();
+    }
+    else
+    {
+        // Reuse the least recently used entry
+        mIndex.erase(mEntries.back().key);
+        mEntries.splice(mEntries.begin(), mEntries, --mEntries.end());
+        mIndex[key] = mEntries.begin();
+    }
+
+    Entry &entry = mEntries.front();
+    entry.key = key;
+    entry.generation = generation;
+    entry.path.swap(path);
+    return entry.path;
+}
@@ -0,0 +1,113 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PATHCACHE_H
+#define PATHCACHE_H
+
+#include <list>
+#include <unordered_map>
+
+#include "game-server/map.h"
+
+/**
+ * Bounded cache of the paths found on a map, dropping the least recently
+ * used ones first.
+ *
+ * Every path is stored with the generation of the blocking state it was
+ * found on (see Map::getGeneration). A path found on an older generation is
+ * not returned anymore.
+ */
+class PathCache
+{
+    public:
+        PathCache(unsigned capacity);
+
+        /**
+         * Looks for a path found with the same parameters on the given
+         * generation.
+         *
+         * @return the path, or null when there is none.
+         */
+        const Path *find(int start, int dest, unsigned char walkmask,
+                         int maxCost, unsigned generation);
+
+        /**
+         * Stores a path, replacing any older one found with the same
+         * parameters.
+         *
+         * @return the stored path.
+         */
+        const Path &insert(int start, int dest, unsigned char walkmask,
+                           int maxCost, unsigned generation, Path &path);
+
+        /**
+         * Returns the number of searches answered by the cache.
+         */
+        unsigned getHits() const
+        { return mHits; }
+
+        /**
+         * Returns the number of searches the cache could not answer.
+         */
+        unsigned getMisses() const
+        { return mMisses; }
+
+    private:
+        struct Key
+        {
+            int start, dest, maxCost;
+            unsigned char walkmask;
+
+            bool operator==(const Key &other) const
+            {
+                return start == other.start && dest == other.dest &&
+                       maxCost == other.maxCost && walkmask == other.walkmask;
+            }
+        };
+
+        struct KeyHash
+        {
+            size_t operator()(const Key &key) const
+            {
+                size_t hash = key.start;
+                hash = hash * 31 + key.dest;
+                hash = hash * 31 + key.maxCost;
+                return hash * 31 + key.walkmask;
+            }
+        };
+
+        struct Entry
+        {
+            Key key;
+            unsigned generation;
+            Path path;
+        };
+
+        typedef std::list<Entry> Entries;
+
+        unsigned mCapacity;
+        Entries mEntries;   /**< Most recently used first. */
+        std::unordered_map<Key, Entries::iterator, KeyHash> mIndex;
+
+        unsigned mHits;
+        unsigned mMisses;
+};
+
+#endif // PATHCACHE_H
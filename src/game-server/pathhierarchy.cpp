@@ -0,0 +1,614 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game-server/pathhierarchy.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+
+/* Same costs as the tile search of the map: straight moves get a small
+   defect so that ties are broken the same way. */
+static const int basicCost = 100;
+static const int straightCost = basicCost + 1;
+static const int diagonalCost = basicCost * 362 / 256;
+
+/** Runs of open border tiles at least this long get an entrance at each end
+    instead of a single one in the middle. */
+static const int longEntranceLength = 6;
+
+namespace {
+
+/**
+ * Node of the open list of the abstract search.
+ */
+struct OpenNode
+{
+    OpenNode(int tile, int Fcost): tile(tile), Fcost(Fcost) {}
+
+    bool operator<(const OpenNode &other) const
+    { return Fcost > other.Fcost; }
+
+    int tile;
+    int Fcost;
+};
+
+/**
+ * State of the abstract search, indexed by tile. Lists are told apart with
+ * increasing markers, like in the tile search, so the state does not need to
+ * be cleared between two searches.
+ */
+struct SearchState
+{
+    SearchState(): onClosedList(1), onOpenList(2) {}
+
+    void prepare(unsigned size)
+    {
+        if (onOpenList < UINT_MAX - 2)
+        {
+            onClosedList += 2;
+            onOpenList += 2;
+        }
+        else
+        {
+            onClosedList = 1;
+            onOpenList = 2;
+            std::fill(whichList.begin(), whichList.end(), 0);
+        }
+
+        if (whichList.size() < size)
+        {
+            whichList.resize(size, 0);
+            Gcost.resize(size);
+            parent.resize(size);
+        }
+    }
+
+    std::vector<unsigned> whichList;
+    std::vector<int> Gcost;
+    std::vector<int> parent;
+    unsigned onClosedList, onOpenList;
+};
+
+} // anonymous namespace
+
+/* Per thread, see the threading notes of Map. */
+static thread_local SearchState searchState;
+
+/**
+ * Adds the entrances of a run of open tiles along a border.
+ */
+static void addEntrances(std::vector<int> &entrances, int first, int last)
+{
+    if (last - first + 1 < longEntranceLength)
+    {
+        entrances.push_back((first + last) / 2);
+    }
+    else
+    {
+        entrances.push_back(first);
+        entrances.push_back(last);
+    }
+}
+
+static void addNode(std::vector<int> &nodeIndex, std::vector<int> &nodes,
+                    int tile)
+{
+    if (nodeIndex[tile] < 0)
+    {
+        nodeIndex[tile] = nodes.size();
+        nodes.push_back(tile);
+    }
+}
+
+/**
+ * Lower bound of the cost between two tiles.
+ */
+static int estimateCost(int x1, int y1, int x2, int y2)
+{
+    const int dx = std::abs(x1 - x2), dy = std::abs(y1 - y2);
+    return std::abs(dx - dy) * basicCost + std::min(dx, dy) * diagonalCost;
+}
+
+PathHierarchy::PathHierarchy(const Map *map, int clusterSize):
+    mMap(map),
+    mWidth(map->getWidth()),
+    mHeight(map->getHeight()),
+    mClusterSize(clusterSize),
+    mClustersX((mWidth + clusterSize - 1) / clusterSize),
+    mClustersY((mHeight + clusterSize - 1) / clusterSize),
+    mClusters(mClustersX * mClustersY),
+    mVerticalBorders(mClustersX * mClustersY),
+    mHorizontalBorders(mClustersX * mClustersY),
+    mNodeIndex(mWidth * mHeight, -1),
+    mDirty(true)
+{
+    update();
+}
+
+void PathHierarchy::invalidate(int x, int y)
+{
+    if (!mMap->contains(x, y))
+        return;
+
+    // The borders of the cluster are updated with it, and so are the
+    // neighbours sharing them.
+    mClusters[getCluster(x, y)].dirty = true;
+    mDirty = true;
+}
+
+unsigned PathHierarchy::getNodeCount() const
+{
+    unsigned count = 0;
+    for (std::vector<Cluster>::const_iterator i = mClusters.begin(),
+         i_end = mClusters.end(); i != i_end; ++i)
+    {
+        count += i->nodes.size();
+    }
+    return count;
+}
+
+void PathHierarchy::getBounds(int cx, int cy, int &x0, int &y0,
+                              int &x1, int &y1) const
+{
+    x0 = cx * mClusterSize;
+    y0 = cy * mClusterSize;
+    x1 = std::min(x0 + mClusterSize, mWidth);
+    y1 = std::min(y0 + mClusterSize, mHeight);
+}
+
+void PathHierarchy::update()
+{
+    if (!mDirty)
+        return;
+
+    // Update the borders of the changed clusters, then rebuild them as well
+    // as the clusters on the other side of those borders.
+    std::vector<bool> rebuild(mClusters.size(), false);
+    for (int cy = 0; cy < mClustersY; ++cy)
+    {
+        for (int cx = 0; cx < mClustersX; ++cx)
+        {
+            const int index = cx + cy * mClustersX;
+            if (!mClusters[index].dirty)
+                continue;
+
+            rebuild[index] = true;
+            if (cx > 0)
+            {
+                updateVerticalBorder(cx - 1, cy);
+                rebuild[index - 1] = true;
+            }
+            if (cx + 1 < mClustersX)
+            {
+                updateVerticalBorder(cx, cy);
+                rebuild[index + 1] = true;
+            }
+            if (cy > 0)
+            {
+                updateHorizontalBorder(cx, cy - 1);
+                rebuild[index - mClustersX] = true;
+            }
+            if (cy + 1 < mClustersY)
+            {
+                updateHorizontalBorder(cx, cy);
+                rebuild[index + mClustersX] = true;
+            }
+        }
+    }
+
+    for (int cy = 0; cy < mClustersY; ++cy)
+        for (int cx = 0; cx < mClustersX; ++cx)
+            if (rebuild[cx + cy * mClustersX])
+                updateCluster(cx, cy);
+
+    mDirty = false;
+}
+
+void PathHierarchy::updateVerticalBorder(int cx, int cy)
+{
+    std::vector<int> &entrances = mVerticalBorders[cx + cy * mClustersX];
+    entrances.clear();
+
+    int x0, y0, x1, y1;
+    getBounds(cx, cy, x0, y0, x1, y1);
+
+    // The border is between the last column of the cluster and the first
+    // one of the cluster on its right.
+    const int x = x1 - 1;
+    int first = -1;
+    for (int y = y0; y <= y1; ++y)
+    {
+        const bool open = y < y1 && isWalkable(x, y) && isWalkable(x + 1, y);
+        if (open && first < 0)
+        {
+            first = y;
+        }
+        else if (!open && first >= 0)
+        {
+            addEntrances(entrances, first, y - 1);
+            first = -1;
+        }
+    }
+}
+
+void PathHierarchy::updateHorizontalBorder(int cx, int cy)
+{
+    std::vector<int> &entrances = mHorizontalBorders[cx + cy * mClustersX];
+    entrances.clear();
+
+    int x0, y0, x1, y1;
+    getBounds(cx, cy, x0, y0, x1, y1);
+
+    const int y = y1 - 1;
+    int first = -1;
+    for (int x = x0; x <= x1; ++x)
+    {
+        const bool open = x < x1 && isWalkable(x, y) && isWalkable(x, y + 1);
+        if (open && first < 0)
+        {
+            first = x;
+        }
+        else if (!open && first >= 0)
+        {
+            addEntrances(entrances, first, x - 1);
+            first = -1;
+        }
+    }
+}
+
+void PathHierarchy::updateCluster(int cx, int cy)
+{
+    const int index = cx + cy * mClustersX;
+    Cluster &cluster = mClusters[index];
+
+    for (std::vector<int>::const_iterator i = cluster.nodes.begin(),
+         i_end = cluster.nodes.end(); i != i_end; ++i)
+    {
+        mNodeIndex[*i] = -1;
+    }
+    cluster.nodes.clear();
+
+    int x0, y0, x1, y1;
+    getBounds(cx, cy, x0, y0, x1, y1);
+
+    // Collect the entrances on the four borders of the cluster
+    if (cx > 0)
+    {
+        const std::vector<int> &rows = mVerticalBorders[index - 1];
+        for (unsigned i = 0; i < rows.size(); ++i)
+            addNode(mNodeIndex, cluster.nodes, x0 + rows[i] * mWidth);
+    }
+    if (cx + 1 < mClustersX)
+    {
+        const std::vector<int> &rows = mVerticalBorders[index];
+        for (unsigned i = 0; i < rows.size(); ++i)
+            addNode(mNodeIndex, cluster.nodes, x1 - 1 + rows[i] * mWidth);
+    }
+    if (cy > 0)
+    {
+        const std::vector<int> &columns = mHorizontalBorders[index - mClustersX];
+        for (unsigned i = 0; i < columns.size(); ++i)
+            addNode(mNodeIndex, cluster.nodes, columns[i] + y0 * mWidth);
+    }
+    if (cy + 1 < mClustersY)
+    {
+        const std::vector<int> &columns = mHorizontalBorders[index];
+        for (unsigned i = 0; i < columns.size(); ++i)
+            addNode(mNodeIndex, cluster.nodes, columns[i] + (y1 - 1) * mWidth);
+    }
+
+    // Cost of the paths between the entrances, inside the cluster
+    const int count = cluster.nodes.size();
+    const int width = x1 - x0;
+    cluster.costs.assign(count * count, -1);
+    std::vector<int> tileCosts;
+    for (int i = 0; i < count; ++i)
+    {
+        const int x = cluster.nodes[i] % mWidth;
+        const int y = cluster.nodes[i] / mWidth;
+        searchCluster(x, y, tileCosts);
+
+        for (int j = 0; j < count; ++j)
+        {
+            const int nx = cluster.nodes[j] % mWidth;
+            const int ny = cluster.nodes[j] / mWidth;
+            cluster.costs[i * count + j] =
+                    tileCosts[(nx - x0) + (ny - y0) * width];
+        }
+    }
+
+    cluster.dirty = false;
+}
+
+void PathHierarchy::searchCluster(int x, int y,
+                                  std::vector<int> &costs) const
+{
+    int x0, y0, x1, y1;
+    getBounds(x / mClusterSize, y / mClusterSize, x0, y0, x1, y1);
+    const int width = x1 - x0;
+
+    costs.assign(width * (y1 - y0), -1);
+
+    typedef std::pair<int, int> Entry;  // Cost and tile in the cluster
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+
+    costs[(x - x0) + (y - y0) * width] = 0;
+    open.push(Entry(0, (x - x0) + (y - y0) * width));
+
+    while (!open.empty())
+    {
+        const Entry curr = open.top();
+        open.pop();
+        if (curr.first > costs[curr.second])
+            continue;
+
+        const int currX = x0 + curr.second % width;
+        const int currY = y0 + curr.second / width;
+
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                const int nx = currX + dx, ny = currY + dy;
+                if ((dx == 0 && dy == 0) ||
+                    nx < x0 || ny < y0 || nx >= x1 || ny >= y1 ||
+                    !isWalkable(nx, ny))
+                    continue;
+
+                // Corners cannot be cut, as in the tile search
+                const bool diagonal = dx != 0 && dy != 0;
+                if (diagonal && (!isWalkable(currX, ny) ||
+                                 !isWalkable(nx, currY)))
+                    continue;
+
+                const int cost = curr.first +
+                        (diagonal ? diagonalCost : straightCost);
+                int &tileCost = costs[(nx - x0) + (ny - y0) * width];
+                if (tileCost < 0 || cost < tileCost)
+                {
+                    tileCost = cost;
+                    open.push(Entry(cost, (nx - x0) + (ny - y0) * width));
+                }
+            }
+        }
+    }
+}
+
+void PathHierarchy::getNodeCosts(int x, int y,
+                                 std::vector<int> &nodeCosts) const
+{
+    const Cluster &cluster = mClusters[getCluster(x, y)];
+    int x0, y0, x1, y1;
+    getBounds(x / mClusterSize, y / mClusterSize, x0, y0, x1, y1);
+
+    std::vector<int> tileCosts;
+    searchCluster(x, y, tileCosts);
+
+    nodeCosts.resize(cluster.nodes.size());
+    for (unsigned i = 0; i < cluster.nodes.size(); ++i)
+    {
+        const int nx = cluster.nodes[i] % mWidth;
+        const int ny = cluster.nodes[i] / mWidth;
+        nodeCosts[i] = tileCosts[(nx - x0) + (ny - y0) * (x1 - x0)];
+    }
+}
+
+Path PathHierarchy::findPath(int startX, int startY,
+                             int destX, int destY,
+                             unsigned char walkmask,
+                             int maxCost)
+{
+    Path path;
+
+    if (!mMap->contains(startX, startY) ||
+        !mMap->getWalk(destX, destY, walkmask))
+        return path;
+
+    update();
+
+    const int start = startX + startY * mWidth;
+    const int goal = destX + destY * mWidth;
+    const int startCluster = getCluster(startX, startY);
+    const int goalCluster = getCluster(destX, destY);
+    const std::vector<int> &startNodes = mClusters[startCluster].nodes;
+
+    // Link the start and the goal to the entrances of their clusters
+    std::vector<int> startCosts, goalCosts;
+    getNodeCosts(startX, startY, startCosts);
+    getNodeCosts(destX, destY, goalCosts);
+
+    int directCost = -1;
+    if (startCluster == goalCluster)
+    {
+        std::vector<int> tileCosts;
+        searchCluster(startX, startY, tileCosts);
+        int x0, y0, x1, y1;
+        getBounds(startX / mClusterSize, startY / mClusterSize,
+                  x0, y0, x1, y1);
+        directCost = tileCosts[(destX - x0) + (destY - y0) * (x1 - x0)];
+    }
+
+    SearchState &state = searchState;
+    state.prepare(mWidth * mHeight);
+
+    std::priority_queue<OpenNode> openList;
+    state.Gcost[start] = 0;
+    state.parent[start] = start;
+    state.whichList[start] = state.onOpenList;
+    openList.push(OpenNode(start, 0));
+
+    const int costLimit = maxCost * basicCost;
+    bool foundPath = false;
+
+    // Edges of the expanded node, as pairs of tile and cost
+    std::vector< std::pair<int, int> > links;
+
+    while (!openList.empty())
+    {
+        const OpenNode curr = openList.top();
+        openList.pop();
+
+        if (state.whichList[curr.tile] == state.onClosedList)
+            continue;
+        state.whichList[curr.tile] = state.onClosedList;
+
+        if (curr.tile == goal)
+        {
+            foundPath = true;
+            break;
+        }
+
+        const int currCost = state.Gcost[curr.tile];
+        const int x = curr.tile % mWidth, y = curr.tile / mWidth;
+
+        int edges[4][2];
+        int edgeCount = 0;
+        links.clear();
+
+        if (curr.tile == start)
+        {
+            for (unsigned i = 0; i < startNodes.size(); ++i)
+                if (startCosts[i] >= 0 && startNodes[i] != start)
+                    links.push_back(std::make_pair(startNodes[i],
+                                                   startCosts[i]));
+            if (directCost >= 0)
+                links.push_back(std::make_pair(goal, directCost));
+        }
+
+        const int nodeIndex = mNodeIndex[curr.tile];
+        if (nodeIndex >= 0)
+        {
+            const int clusterIndex = getCluster(x, y);
+            const Cluster &cluster = mClusters[clusterIndex];
+            const int count = cluster.nodes.size();
+
+            if (curr.tile != start)
+            {
+                for (int j = 0; j < count; ++j)
+                {
+                    const int cost = cluster.costs[nodeIndex * count + j];
+                    if (cost > 0)
+                        links.push_back(std::make_pair(cluster.nodes[j],
+                                                       cost));
+                }
+            }
+            if (clusterIndex == goalCluster && goalCosts[nodeIndex] >= 0)
+                links.push_back(std::make_pair(goal, goalCosts[nodeIndex]));
+
+            // Entrances facing this one in the neighbouring clusters
+            if (x > 0 && x % mClusterSize == 0)
+            {
+                edges[edgeCount][0] = curr.tile - 1;
+                edges[edgeCount++][1] = straightCost;
+            }
+            if (x + 1 < mWidth && (x + 1) % mClusterSize == 0)
+            {
+                edges[edgeCount][0] = curr.tile + 1;
+                edges[edgeCount++][1] = straightCost;
+            }
+            if (y > 0 && y % mClusterSize == 0)
+            {
+                edges[edgeCount][0] = curr.tile - mWidth;
+                edges[edgeCount++][1] = straightCost;
+            }
+            if (y + 1 < mHeight && (y + 1) % mClusterSize == 0)
+            {
+                edges[edgeCount][0] = curr.tile + mWidth;
+                edges[edgeCount++][1] = straightCost;
+            }
+            for (int i = 0; i < edgeCount; ++i)
+                if (mNodeIndex[edges[i][0]] >= 0)
+                    links.push_back(std::make_pair(edges[i][0],
+                                                   edges[i][1]));
+        }
+
+        for (std::vector< std::pair<int, int> >::const_iterator
+             i = links.begin(), i_end = links.end(); i != i_end; ++i)
+        {
+            const int tile = i->first;
+            const int Gcost = currCost + i->second;
+            if (Gcost > costLimit ||
+                state.whichList[tile] == state.onClosedList)
+                continue;
+
+            if (state.whichList[tile] != state.onOpenList ||
+                Gcost < state.Gcost[tile])
+            {
+                state.whichList[tile] = state.onOpenList;
+                state.Gcost[tile] = Gcost;
+                state.parent[tile] = curr.tile;
+                openList.push(OpenNode(tile, Gcost +
+                        estimateCost(tile % mWidth, tile / mWidth,
+                                     destX, destY)));
+            }
+        }
+    }
+
+    if (!foundPath)
+        return path;
+
+    // Extract the entrances crossed on the way
+    std::vector<int> steps;
+    for (int tile = goal; tile != start; tile = state.parent[tile])
+        steps.push_back(tile);
+    std::reverse(steps.begin(), steps.end());
+
+    // Turn each step into tiles. The steps stay inside a cluster, so the
+    // tile search they need is short.
+    int prevX = startX, prevY = startY, prevCost = 0;
+    for (std::vector<int>::const_iterator i = steps.begin(),
+         i_end = steps.end(); i != i_end; ++i)
+    {
+        const int x = *i % mWidth, y = *i / mWidth;
+        const int stepCost = state.Gcost[*i] - prevCost;
+
+        if (std::abs(x - prevX) + std::abs(y - prevY) == 1 &&
+            mMap->getWalk(x, y, walkmask))
+        {
+            path.push_back(Point(x, y));
+        }
+        else
+        {
+            // Leave room to walk around beings in the way
+            Path part = mMap->findPath(prevX, prevY, x, y, walkmask,
+                                       stepCost / basicCost + 2);
+            if (part.empty())
+                part = mMap->findPath(prevX, prevY, x, y, walkmask,
+                                      stepCost / basicCost + mClusterSize);
+            if (part.empty())
+                return Path();
+
+            path.insert(path.end(), part.begin(), part.end());
+        }
+
+        // The detours of the tile searches may add up past the limit
+        if (path.size() > unsigned(maxCost))
+            return Path();
+
+        prevX = x;
+        prevY = y;
+        prevCost = state.Gcost[*i];
+    }
+
+    return path;
+}
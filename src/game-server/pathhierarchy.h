@@ -0,0 +1,129 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PATHHIERARCHY_H
+#define PATHHIERARCHY_H
+
+#include <vector>
+
+#include "game-server/map.h"
+
+/**
+ * Abstract graph of a map, used to find long paths without searching every
+ * tile on the way (hierarchical A*).
+ *
+ * The map is split into square clusters. Entrances are placed where walkable
+ * tiles face each other across the border of two clusters, and the costs of
+ * the paths between the entrances of a cluster are computed in advance. A
+ * long path is first searched from entrance to entrance, then every step of
+ * it is turned into tiles with a short search.
+ *
+ * Only walls are taken into account by the graph. Tiles blocked by beings
+ * are avoided when refining the path.
+ */
+class PathHierarchy
+{
+    public:
+        PathHierarchy(const Map *map, int clusterSize);
+
+        /**
+         * Returns the size of the clusters, in tiles.
+         */
+        int getClusterSize() const
+        { return mClusterSize; }
+
+        /**
+         * Records that a tile became or stopped being a wall. The clusters
+         * around it are updated before the next search.
+         */
+        void invalidate(int x, int y);
+
+        /**
+         * Finds a path from one location to the next.
+         *
+         * @return the path, or an empty path when there is none cheaper than
+         *         \a maxCost.
+         */
+        Path findPath(int startX, int startY,
+                      int destX, int destY,
+                      unsigned char walkmask,
+                      int maxCost);
+
+        /**
+         * Returns the number of entrances of the graph.
+         */
+        unsigned getNodeCount() const;
+
+    private:
+        struct Cluster
+        {
+            Cluster(): dirty(true) {}
+
+            std::vector<int> nodes;     /**< Tile indexes of the entrances. */
+            std::vector<int> costs;     /**< Between the nodes, -1 if none. */
+            bool dirty;
+        };
+
+        void update();
+
+        void updateVerticalBorder(int cx, int cy);
+        void updateHorizontalBorder(int cx, int cy);
+        void updateCluster(int cx, int cy);
+
+        /**
+         * Gets the tiles covered by a cluster, clamped to the map.
+         */
+        void getBounds(int cx, int cy, int &x0, int &y0,
+                       int &x1, int &y1) const;
+
+        /**
+         * Computes the cost from a tile to every tile of its cluster, only
+         * going through the cluster. Unreachable tiles get -1.
+         */
+        void searchCluster(int x, int y, std::vector<int> &costs) const;
+
+        /**
+         * Gets the cost from a tile of a cluster to each of its entrances.
+         */
+        void getNodeCosts(int x, int y, std::vector<int> &nodeCosts) const;
+
+        int getCluster(int x, int y) const
+        { return x / mClusterSize + (y / mClusterSize) * mClustersX; }
+
+        bool isWalkable(int x, int y) const
+        { return mMap->getWalk(x, y, Map::BLOCKMASK_WALL); }
+
+        const Map *mMap;
+        int mWidth, mHeight;
+        int mClusterSize;
+        int mClustersX, mClustersY;
+        std::vector<Cluster> mClusters;
+
+        /** Entrance rows between each cluster and the one on its right. */
+        std::vector< std::vector<int> > mVerticalBorders;
+        /** Entrance columns between each cluster and the one below it. */
+        std::vector< std::vector<int> > mHorizontalBorders;
+
+        /** Index of each tile in the nodes of its cluster, or -1. */
+        std::vector<int> mNodeIndex;
+        bool mDirty;
+};
+
+#endif // PATHHIERARCHY_H
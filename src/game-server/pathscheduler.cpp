@@ -0,0 +1,330 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game-server/pathscheduler.h"
+
+#include "common/configuration.h"
+#include "game-server/tickprofiler.h"
+#include "utils/logger.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <thread>
+
+namespace
+{
+
+struct Request
+{
+    unsigned id;
+    int priority;
+    Map *map;
+    std::shared_ptr<const Map> snapshot;    /**< Searched by the workers. */
+    int startX, startY, destX, destY;
+    unsigned char walkmask;
+    int maxCost;
+    TickProfiler::Clock::time_point submitted;
+
+    /** Highest priority first, then oldest first. */
+    bool operator<(const Request &other) const
+    {
+        if (priority != other.priority)
+            return priority < other.priority;
+        return id > other.id;
+    }
+};
+
+struct Result
+{
+    Path path;
+    TickProfiler::Clock::time_point submitted;
+};
+
+/**
+ * Latest snapshot taken of a map, shared by the requests queued while the
+ * map does not change.
+ */
+struct Snapshot
+{
+    std::shared_ptr<const Map> map;
+    int tick;
+};
+
+} // anonymous namespace
+
+static std::mutex mutex;
+static std::condition_variable requestQueued;
+static std::priority_queue<Request> requests;
+static std::map<unsigned, Result> completed;    /**< Not handed out yet. */
+static std::map<unsigned, Path> results;        /**< Handed out. */
+static std::set<unsigned> cancelled;            /**< Still being solved. */
+static std::map<const Map *, Snapshot> snapshots;
+static std::vector<std::thread> workers;
+static unsigned nextId = 1;
+static unsigned solving;                        /**< Requests being solved. */
+static bool quit;
+
+static int currentTick;
+static unsigned budget;                         /**< Per tick, microseconds. */
+static std::atomic<int> budgetLeft(0);
+
+/**
+ * Ticks a snapshot is used for while only the tiles taken by beings changed.
+ * The beings keep moving while the requests wait anyway.
+ */
+static const int snapshotBeingTicks = 5;
+
+/**
+ * Records the result of a request, unless it was cancelled meanwhile.
+ * @note The mutex must be held.
+ */
+static void complete(const Request &request, Path &path)
+{
+    --solving;
+    if (cancelled.erase(request.id))
+        return;
+
+    Result &result = completed[request.id];
+    result.path.swap(path);
+    result.submitted = request.submitted;
+}
+
+/**
+ * Returns a copy of the walkability of a map, recent enough for a search
+ * with the given walkmask. A copy is made once per tick at most when walls
+ * changed, and once every few ticks when only the beings did. Only the
+ * thread updating a map asks for its snapshot, so the copy is made without
+ * holding the mutex.
+ */
+static std::shared_ptr<const Map> getSnapshot(Map *map,
+                                              unsigned char walkmask)
+{
+    Snapshot *snapshot;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        snapshot = &snapshots[map];
+    }
+
+    const Map *copy = snapshot->map.get();
+    const unsigned char wallmask = walkmask & Map::BLOCKMASK_WALL;
+    bool outdated;
+    if (!copy)
+        outdated = true;
+    else if (copy->getGeneration(walkmask) == map->getGeneration(walkmask))
+        outdated = false;
+    else if (copy->getGeneration(wallmask) != map->getGeneration(wallmask))
+        outdated = snapshot->tick != currentTick;
+    else
+        outdated = currentTick - snapshot->tick >= snapshotBeingTicks;
+
+    if (outdated)
+    {
+        snapshot->map.reset(map->createWalkSnapshot());
+        snapshot->tick = currentTick;
+    }
+    return snapshot->map;
+}
+
+static void workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        requestQueued.wait(lock, [] { return quit || !requests.empty(); });
+        if (quit)
+            return;
+
+        const Request request = requests.top();
+        requests.pop();
+        ++solving;
+
+        lock.unlock();
+        Path path = request.snapshot->findPath(request.startX, request.startY,
+                                               request.destX, request.destY,
+                                               request.walkmask,
+                                               request.maxCost);
+        lock.lock();
+
+        complete(request, path);
+    }
+}
+
+void PathScheduler::initialize()
+{
+    budget = std::max(0, Configuration::getValue("game_pathBudget", 20)) * 1000;
+    budgetLeft = budget;
+    quit = false;
+
+    const int threads = Configuration::getValue("game_pathThreads", 0);
+    if (threads > 0)
+    {
+        LOG_INFO("Finding paths over the budget using " << threads
+                 << " worker threads.");
+        for (int i = 0; i < threads; ++i)
+            workers.push_back(std::thread(workerLoop));
+    }
+}
+
+void PathScheduler::deinitialize()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    requestQueued.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+    workers.clear();
+
+    requests = std::priority_queue<Request>();
+    completed.clear();
+    results.clear();
+    cancelled.clear();
+    snapshots.clear();
+    solving = 0;
+}
+
+void PathScheduler::update(int tick)
+{
+    currentTick = tick;
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // Without workers, the queued requests go first in the budget
+    const TickProfiler::Clock::time_point start = TickProfiler::Clock::now();
+    while (workers.empty() && !requests.empty() &&
+           TickProfiler::elapsed(start) < budget)
+    {
+        const Request request = requests.top();
+        requests.pop();
+        ++solving;
+
+        lock.unlock();
+        Path path;
+        request.map->findCachedPath(request.startX, request.startY,
+                                    request.destX, request.destY,
+                                    request.walkmask, request.maxCost, path);
+        lock.lock();
+
+        complete(request, path);
+    }
+    budgetLeft = budget - std::min(budget, TickProfiler::elapsed(start));
+
+    // Hand out the completed requests
+    std::vector<unsigned> latencies;
+    for (std::map<unsigned, Result>::iterator it = completed.begin(),
+         it_end = completed.end(); it != it_end; ++it)
+    {
+        latencies.push_back(TickProfiler::elapsed(it->second.submitted));
+        results[it->first].swap(it->second.path);
+    }
+    completed.clear();
+
+    TickProfiler::addPathSamples(requests.size() + solving, latencies);
+
+    // Snapshots are not needed anymore once the requests using them are done
+    if (requests.empty() && !solving)
+        snapshots.clear();
+}
+
+unsigned PathScheduler::findPath(Map *map,
+                                 int startX, int startY,
+                                 int destX, int destY,
+                                 unsigned char walkmask, int maxCost,
+                                 int priority, Path &path)
+{
+    if (!map->isReachable(startX, startY, destX, destY, walkmask))
+    {
+        path.clear();
+        return 0;
+    }
+
+    if (budgetLeft > 0)
+    {
+        const TickProfiler::Clock::time_point start =
+                TickProfiler::Clock::now();
+        map->findCachedPath(startX, startY, destX, destY, walkmask, maxCost,
+                            path);
+        budgetLeft -= TickProfiler::elapsed(start);
+        return 0;
+    }
+
+    Request request;
+    request.priority = priority;
+    request.map = map;
+    request.startX = startX;
+    request.startY = startY;
+    request.destX = destX;
+    request.destY = destY;
+    request.walkmask = walkmask;
+    request.maxCost = maxCost;
+    request.submitted = TickProfiler::Clock::now();
+
+    // The map may only be read by its own thread, the workers search a copy
+    if (!workers.empty())
+        request.snapshot = getSnapshot(map, walkmask);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    request.id = nextId++;
+    if (!nextId)
+        nextId = 1;
+
+    requests.push(request);
+    requestQueued.notify_one();
+    return request.id;
+}
+
+bool PathScheduler::hasBudget()
+{
+    return budgetLeft > 0;
+}
+
+void PathScheduler::charge(unsigned microseconds)
+{
+    budgetLeft -= microseconds;
+}
+
+bool PathScheduler::takeResult(unsigned id, Path &path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<unsigned, Path>::iterator it = results.find(id);
+    if (it == results.end())
+        return false;
+
+    path.assign(it->second.begin(), it->second.end());
+    results.erase(it);
+    return true;
+}
+
+void PathScheduler::cancel(unsigned id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (results.erase(id) || completed.erase(id))
+        return;
+
+    // Still queued or being solved. The queue cannot be searched, so the
+    // request is solved anyway and its result dropped.
+    cancelled.insert(id);
+}
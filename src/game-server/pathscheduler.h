@@ -0,0 +1,92 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PATHSCHEDULER_H
+#define PATHSCHEDULER_H
+
+#include "game-server/map.h"
+
+/**
+ * Spreads the path searches of the beings over time, so that a burst of
+ * expensive searches cannot make a tick overrun.
+ *
+ * Searches run right away on the thread asking for them as long as the time
+ * budget of the tick allows it (game_pathBudget). The other ones are queued
+ * and solved by worker threads on a snapshot of the walkability of the map
+ * (game_pathThreads), or on the main thread at the start of the next ticks
+ * when there are no workers. Results are handed out at the start of the tick
+ * following their completion.
+ */
+namespace PathScheduler
+{
+    /**
+     * Reads the options and starts the worker threads.
+     */
+    void initialize();
+
+    /**
+     * Stops the worker threads and drops the pending requests.
+     */
+    void deinitialize();
+
+    /**
+     * Resets the time budget, hands out the results completed since the last
+     * call and, without worker threads, solves queued requests within the
+     * budget. Called from the main thread at the start of every tick.
+     */
+    void update(int tick);
+
+    /**
+     * Finds a path on a map, right away if the budget of the tick allows
+     * it. Requests with a higher priority are solved first.
+     *
+     * @return 0 when \a path was filled right away, otherwise the id of the
+     *         queued request to pass to takeResult.
+     */
+    unsigned findPath(Map *map, int startX, int startY, int destX, int destY,
+                      unsigned char walkmask, int maxCost, int priority,
+                      Path &path);
+
+    /**
+     * Returns whether the time budget of the tick is not spent yet.
+     */
+    bool hasBudget();
+
+    /**
+     * Charges path finding work done outside of the scheduler, like building
+     * a flow field, against the time budget of the tick.
+     */
+    void charge(unsigned microseconds);
+
+    /**
+     * Takes the result of a queued request.
+     *
+     * @return whether the request was solved, in which case \a path is set
+     *         (empty when there is no path) and the id is released.
+     */
+    bool takeResult(unsigned id, Path &path);
+
+    /**
+     * Drops a queued request, or its result.
+     */
+    void cancel(unsigned id);
+}
+
+#endif // PATHSCHEDULER_H
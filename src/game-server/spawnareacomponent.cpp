@@ -25,6 +25,9 @@
 #include "game-server/state.h"
 #include "utils/logger.h"
 
+#include <algorithm>
+#include <map>
+
 SpawnAreaComponent::SpawnAreaComponent(MonsterClass *specy,
                                        const Rectangle &zone,
                                        int maxBeings,
@@ -34,7 +37,9 @@ SpawnAreaComponent::SpawnAreaComponent(MonsterClass *specy,
     mMaxBeings(maxBeings),
     mSpawnRate(spawnRate),
     mNumBeings(0),
-    mNextSpawn(0)
+    mNextSpawn(0),
+    mSpawnTilesValid(false),
+    mSpawnTilesGeneration(0)
 {
 }
 
@@ -57,42 +62,61 @@ void SpawnAreaComponent::update(Entity &entity)
             mZone.h = realMap->getHeight() * realMap->getTileHeight();
         }
 
-        // Find a free spawn location. Give up after 10 tries
-        Point position;
-        const int x = mZone.x;
-        const int y = mZone.y;
-        const int width = mZone.w;
-        const int height = mZone.h;
-
-        Entity *being = new Entity(OBJECT_MONSTER);
-        auto *actorComponent = new ActorComponent(*being);
-        being->addComponent(actorComponent);
-        auto *beingComponent = new BeingComponent(*being);
-        being->addComponent(beingComponent);
-        being->addComponent(new MonsterComponent(*being, mSpecy));
-
-        auto *hpAttribute = attributeManager->getAttributeInfo(ATTR_MAX_HP);
-        if (beingComponent->getModifiedAttribute(hpAttribute) <= 0)
+        const unsigned generation = realMap->getGeneration(Map::BLOCKMASK_WALL);
+        if (!mSpawnTilesValid || generation != mSpawnTilesGeneration)
         {
-            LOG_WARN("Refusing to spawn dead monster " << mSpecy->getId());
-            delete being;
-            being = 0;
+            updateSpawnTiles(realMap);
+
+            if (mSpawnTiles.empty())
+            {
+                LOG_WARN("No free spawn location for monster "
+                         << mSpecy->getId() << " on map " << map->getName()
+                         << " (" << mZone.x << ',' << mZone.y << ','
+                         << mZone.w << ',' << mZone.h << ')');
+            }
         }
 
-        if (being)
+        // Find a tile not taken by a character. Give up after 10 tries.
+        const int tileWidth = realMap->getTileWidth();
+        const int tileHeight = realMap->getTileHeight();
+        const Point *tile = nullptr;
+        for (int triesLeft = mSpawnTiles.empty() ? 0 : 10;
+             triesLeft && !tile; --triesLeft)
         {
-            int triesLeft = 10;
-            do
+            const Point &candidate = mSpawnTiles[rand() % mSpawnTiles.size()];
+            if (realMap->getWalk(candidate.x, candidate.y,
+                                 MonsterComponent::WALK_MASK))
+                tile = &candidate;
+        }
+
+        if (tile)
+        {
+            // Pick a pixel of the tile that lies within the zone
+            const int left = std::max(tile->x * tileWidth, mZone.x);
+            const int top = std::max(tile->y * tileHeight, mZone.y);
+            const int right = std::min((tile->x + 1) * tileWidth,
+                                       mZone.x + mZone.w);
+            const int bottom = std::min((tile->y + 1) * tileHeight,
+                                        mZone.y + mZone.h);
+            const Point position(left + rand() % (right - left),
+                                 top + rand() % (bottom - top));
+
+            Entity *being = new Entity(OBJECT_MONSTER);
+            auto *actorComponent = new ActorComponent(*being);
+            being->addComponent(actorComponent);
+            auto *beingComponent = new BeingComponent(*being);
+            being->addComponent(beingComponent);
+            being->addComponent(new MonsterComponent(*being, mSpecy));
+
+            // The attributes of the specy may derive the maximum hitpoints
+            beingComponent->updateDerivedAttributes(*being);
+            auto *hpAttribute = attributeManager->getAttributeInfo(ATTR_MAX_HP);
+            if (beingComponent->getModifiedAttribute(hpAttribute) <= 0)
             {
-                position = Point(x + rand() % width, y + rand() % height);
-                triesLeft--;
+                LOG_WARN("Refusing to spawn dead monster " << mSpecy->getId());
+                delete being;
             }
-            while (!realMap->getWalk(position.x / realMap->getTileWidth(),
-                                     position.y / realMap->getTileHeight(),
-                                     actorComponent->getWalkMask())
-                   && triesLeft);
-
-            if (triesLeft)
+            else
             {
                 being->signal_removed.connect(
                             sigc::mem_fun(this, &SpawnAreaComponent::decrease));
@@ -104,14 +128,6 @@ void SpawnAreaComponent::update(Entity &entity)
 
                 mNumBeings++;
             }
-            else
-            {
-                LOG_WARN("Unable to find a free spawn location for monster "
-                         << mSpecy->getId() << " on map " << map->getName()
-                         << " (" << x << ',' << y << ','
-                         << width << ',' << height << ')');
-                delete being;
-            }
         }
 
         // Predictable respawn intervals (can be randomized later)
@@ -119,6 +135,53 @@ void SpawnAreaComponent::update(Entity &entity)
     }
 }
 
+/**
+ * Lists the tiles of the zone that are not walls. Only the largest part of
+ * the zone that is not closed off by walls is kept, so that monsters do not
+ * spawn where they cannot leave nor be reached.
+ */
+void SpawnAreaComponent::updateSpawnTiles(const Map *map)
+{
+    mSpawnTilesGeneration = map->getGeneration(Map::BLOCKMASK_WALL);
+    mSpawnTilesValid = true;
+    mSpawnTiles.clear();
+
+    const int tileWidth = map->getTileWidth();
+    const int tileHeight = map->getTileHeight();
+    const int startX = std::max(0, mZone.x / tileWidth);
+    const int startY = std::max(0, mZone.y / tileHeight);
+    const int endX = std::min(map->getWidth(),
+                              (mZone.x + mZone.w - 1) / tileWidth + 1);
+    const int endY = std::min(map->getHeight(),
+                              (mZone.y + mZone.h - 1) / tileHeight + 1);
+
+    std::map<unsigned, int> sizes;
+    unsigned largestRegion = 0;
+    int largest = 0;
+    for (int y = startY; y < endY; ++y)
+    {
+        for (int x = startX; x < endX; ++x)
+        {
+            const unsigned region = map->getRegion(x, y);
+            if (region && ++sizes[region] > largest)
+            {
+                largest = sizes[region];
+                largestRegion = region;
+            }
+        }
+    }
+
+    for (int y = startY; y < endY; ++y)
+    {
+        for (int x = startX; x < endX; ++x)
+        {
+            if (map->getWalk(x, y, Map::BLOCKMASK_WALL) &&
+                (!largestRegion || map->getRegion(x, y) == largestRegion))
+                mSpawnTiles.push_back(Point(x, y));
+        }
+    }
+}
+
 void SpawnAreaComponent::decrease(Entity *)
 {
     --mNumBeings;
@@ -26,13 +26,16 @@
 
 #include "utils/point.h"
 
+#include <vector>
+
+class Map;
 class MonsterClass;
 
 /**
  * A spawn area, where monsters spawn. The area is a rectangular field and will
  * spawn a certain number of a given monster type.
  */
-class SpawnAreaComponent : public Component
+class SpawnAreaComponent : public PooledComponent<SpawnAreaComponent>
 {
     public:
         static const ComponentType type = CT_SpawnArea;
@@ -49,6 +52,8 @@ class SpawnAreaComponent : public Component
         void decrease(Entity *);
 
     private:
+        void updateSpawnTiles(const Map *map);
+
         MonsterClass *mSpecy; /**< Specy of monster that spawns in this area. */
         Rectangle mZone;
         int mMaxBeings;    /**< Maximum population of this area. */
@@ -56,6 +61,11 @@ class SpawnAreaComponent : public Component
         int mNumBeings;    /**< Current population of this area. */
         int mNextSpawn;    /**< The time until next being spawn. */
 
+        /** Tiles of the zone monsters can spawn on, not counting beings. */
+        std::vector<Point> mSpawnTiles;
+        bool mSpawnTilesValid;
+        unsigned mSpawnTilesGeneration; /**< Walls mSpawnTiles is valid for. */
+
         friend struct SpawnAreaEventDispatch;
 };
 
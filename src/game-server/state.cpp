@@ -24,6 +24,7 @@
 #include "game-server/accountconnection.h"
 #include "game-server/effect.h"
 #include "game-server/gamehandler.h"
+#include "game-server/interestmanager.h"
 #include "game-server/inventory.h"
 #include "game-server/item.h"
 #include "game-server/itemmanager.h"
@@ -32,12 +33,16 @@
 #include "game-server/mapmanager.h"
 #include "game-server/monster.h"
 #include "game-server/npc.h"
+#include "game-server/pathscheduler.h"
+#include "game-server/tickprofiler.h"
+#include "game-server/timerwheel.h"
 #include "game-server/trade.h"
 #include "net/messageout.h"
 #include "scripting/script.h"
 #include "scripting/scriptmanager.h"
 #include "utils/logger.h"
 #include "utils/speedconv.h"
+#include "utils/workerpool.h"
 
 #include <cassert>
 
@@ -65,6 +70,11 @@ typedef std::map< Entity *, DelayedEvent > DelayedEvents;
  */
 static int currentTick;
 
+/**
+ * Modifier expiry, status effects, ability recharge and the like.
+ */
+static TimerWheel timers;
+
 /**
  * List of delayed events.
  */
@@ -76,434 +86,175 @@ static DelayedEvents delayedEvents;
 static std::map< std::string, std::string > mScriptVariables;
 
 /**
- * Sets message fields describing character look.
+ * Threads updating the maps in parallel, or null when the maps are updated on
+ * the main thread.
  */
-static void serializeLooks(Entity *ch, MessageOut &msg)
-{
-    auto *characterComponent = ch->getComponent<CharacterComponent>();
-    msg.writeInt8(characterComponent->getHairStyle());
-    msg.writeInt8(characterComponent->getHairColor());
-    const EquipData &equipData =
-            characterComponent->getPossessions().getEquipment();
-    const InventoryData &inventoryData =
-            characterComponent->getPossessions().getInventory();
-
-    // The map storing the info about the look changes to send
-    //{ slot type id, item id }
-    std::map<unsigned, unsigned> lookChanges;
-
-    // Note that we can send several updates on the same slot type as different
-    // items may have been equipped.
-    for (EquipData::const_iterator it = equipData.begin(),
-         it_end = equipData.end(); it != it_end; ++it)
-    {
-        InventoryData::const_iterator itemIt = inventoryData.find(*it);
-
-        if (!itemManager->isEquipSlotVisible(itemIt->second.equipmentSlot))
-            continue;
+static utils::WorkerPool *mapWorkers;
 
-        lookChanges.insert(std::make_pair(
-                itemIt->second.equipmentSlot,
-                itemIt->second.itemId));
-    }
-
-    if (!lookChanges.empty())
-    {
-        // Number of look changes to send
-        msg.writeInt8(lookChanges.size());
-
-        for (std::map<unsigned, unsigned>::const_iterator it =
-             lookChanges.begin(), it_end = lookChanges.end();
-             it != it_end; ++it)
-        {
-            msg.writeInt8(it->first);
-            msg.writeInt16(it->second);
-        }
-    }
-}
+/**
+ * Messages built for each active map during a parallel update. They are sent
+ * from the main thread once all the maps have been handled.
+ */
+static std::vector< DeferredMessages > mapMessages;
 
 /**
- * Informs a player of what happened around the character.
+ * Informs the characters of a map about what happened around them and clears
+ * the update flags of the actors.
  */
-static void informPlayer(MapComposite *map, Entity *p)
+static void informPlayers(MapComposite *map, int visualRange)
 {
-    MessageOut moveMsg(GPMSG_BEINGS_MOVE);
-    MessageOut damageMsg(GPMSG_BEINGS_DAMAGE);
-    const Point &pold = p->getComponent<BeingComponent>()->getOldPosition();
-    const Point &ppos = p->getComponent<ActorComponent>()->getPosition();
-    int pflags = p->getComponent<ActorComponent>()->getUpdateFlags();
-    int visualRange = Configuration::getValue("game_visualRange", 448);
+    InterestManager::informPlayers(map, visualRange, currentTick);
 
-    // Inform client about activities of other beings near its character
-    for (BeingIterator it(map->getAroundBeingIterator(p, visualRange));
-         it; ++it)
+    for (ActorIterator it(map->getWholeMapIterator()); it; ++it)
     {
-        Entity *o = *it;
-
-        const Point &oold =
-                o->getComponent<BeingComponent>()->getOldPosition();
-        const Point &opos = o->getComponent<ActorComponent>()->getPosition();
-        int otype = o->getType();
-        int oid = o->getComponent<ActorComponent>()->getPublicID();
-        int oflags = o->getComponent<ActorComponent>()->getUpdateFlags();
-        int flags = 0;
-
-        // Check if the character p and the moving object o are around.
-        bool wereInRange = pold.inRangeOf(oold, visualRange) &&
-                           !((pflags | oflags) & UPDATEFLAG_NEW_ON_MAP);
-        bool willBeInRange = ppos.inRangeOf(opos, visualRange);
-
-        if (!wereInRange && !willBeInRange)
+        Entity *a = *it;
+        a->getComponent<ActorComponent>()->clearUpdateFlags();
+        if (a->canFight())
         {
-            // Nothing to report: o and p are far away from each other.
-            continue;
+            a->getComponent<BeingComponent>()->clearHitsTaken();
         }
+    }
+}
 
+#ifndef NDEBUG
+static bool dbgLockObjects;
+#endif
 
-        if (wereInRange && willBeInRange)
-        {
-            // Send action change messages.
-            if ((oflags & UPDATEFLAG_ACTIONCHANGE))
-            {
-                MessageOut actionMsg(GPMSG_BEING_ACTION_CHANGE);
-                actionMsg.writeInt16(oid);
-                actionMsg.writeInt8(
-                        o->getComponent<BeingComponent>()->getAction());
-                gameHandler->sendTo(p, actionMsg);
-            }
-
-            // Send looks change messages.
-            if (oflags & UPDATEFLAG_LOOKSCHANGE)
-            {
-                MessageOut looksMsg(GPMSG_BEING_LOOKS_CHANGE);
-                looksMsg.writeInt16(oid);
-                serializeLooks(o, looksMsg);
-                gameHandler->sendTo(p, looksMsg);
-            }
-
-            // Send emote messages.
-            if (oflags & UPDATEFLAG_EMOTE)
-            {
-                int emoteId =
-                        o->getComponent<BeingComponent>()->getLastEmote();
-                if (emoteId > -1)
-                {
-                    MessageOut emoteMsg(GPMSG_BEING_EMOTE);
-                    emoteMsg.writeInt16(oid);
-                    emoteMsg.writeInt16(emoteId);
-                    gameHandler->sendTo(p, emoteMsg);
-                }
-            }
-
-            // Send direction change messages.
-            if (oflags & UPDATEFLAG_DIRCHANGE && o != p)
-            {
-                MessageOut dirMsg(GPMSG_BEING_DIR_CHANGE);
-                dirMsg.writeInt16(oid);
-                dirMsg.writeInt8(
-                        o->getComponent<BeingComponent>()->getDirection());
-                gameHandler->sendTo(p, dirMsg);
-            }
-
-            // Send ability uses
-            if (oflags & UPDATEFLAG_ABILITY_ON_POINT)
-            {
-                MessageOut abilityMsg(GPMSG_BEING_ABILITY_POINT);
-                abilityMsg.writeInt16(oid);
-                auto *abilityComponent = o->getComponent<AbilityComponent>();
-                const Point &point = abilityComponent->getLastTargetPoint();
-                abilityMsg.writeInt8(abilityComponent->getLastUsedAbilityId());
-                abilityMsg.writeInt16(point.x);
-                abilityMsg.writeInt16(point.y);
-                gameHandler->sendTo(p, abilityMsg);
-            }
+void GameState::initialize()
+{
+    int threads = Configuration::getValue("game_mapThreads", 0);
+    if (threads > 0)
+    {
+        LOG_INFO("Updating maps in parallel using " << threads
+                 << " worker threads.");
+        mapWorkers = new utils::WorkerPool(threads);
+    }
 
-            if (oflags & UPDATEFLAG_ABILITY_ON_BEING)
-            {
-                MessageOut abilityMsg(GPMSG_BEING_ABILITY_BEING);
-                abilityMsg.writeInt16(oid);
-                auto *abilityComponent = o->getComponent<AbilityComponent>();
-                abilityMsg.writeInt8(abilityComponent->getLastUsedAbilityId());
-                abilityMsg.writeInt16(
-                        abilityComponent->getLastTargetBeingId());
-                gameHandler->sendTo(p, abilityMsg);
-            }
+    PathScheduler::initialize();
+}
 
-            if (oflags & UPDATEFLAG_ABILITY_ON_DIRECTION)
-            {
-                MessageOut abilityMsg(GPMSG_BEING_ABILITY_DIRECTION);
-                abilityMsg.writeInt16(oid);
-                auto *abilityComponent = o->getComponent<AbilityComponent>();
-                abilityMsg.writeInt8(abilityComponent->getLastUsedAbilityId());
-                abilityMsg.writeInt8(
-                        abilityComponent->getLastTargetDirection());
-                gameHandler->sendTo(p, abilityMsg);
-            }
+void GameState::deinitialize()
+{
+    PathScheduler::deinitialize();
 
-            // Send damage messages.
-            if (o->canFight())
-            {
-                auto *beingComponent = o->getComponent<BeingComponent>();
-                const Hits &hits = beingComponent->getHitsTaken();
-                for (Hits::const_iterator j = hits.begin(),
-                     j_end = hits.end(); j != j_end; ++j)
-                {
-                    damageMsg.writeInt16(oid);
-                    damageMsg.writeInt16(*j);
-                }
-            }
+    delete mapWorkers;
+    mapWorkers = nullptr;
+}
 
-            if (oold == opos)
-            {
-                // o does not move, nothing more to report.
-                continue;
-            }
-        }
+void GameState::update(int tick)
+{
+    currentTick = tick;
 
-        if (!willBeInRange)
-        {
-            // o is no longer visible from p. Send leave message.
-            MessageOut leaveMsg(GPMSG_BEING_LEAVE);
-            leaveMsg.writeInt16(oid);
-            gameHandler->sendTo(p, leaveMsg);
-            continue;
-        }
+    PathScheduler::update(tick);
 
-        if (!wereInRange)
-        {
-            // o is now visible by p. Send enter message.
-            MessageOut enterMsg(GPMSG_BEING_ENTER);
-            enterMsg.writeInt8(otype);
-            enterMsg.writeInt16(oid);
-            enterMsg.writeInt8(o->getComponent<BeingComponent>()->getAction());
-            enterMsg.writeInt16(opos.x);
-            enterMsg.writeInt16(opos.y);
-            enterMsg.writeInt8(
-                    o->getComponent<BeingComponent>()->getDirection());
-            enterMsg.writeInt8(o->getComponent<BeingComponent>()->getGender());
-            switch (otype)
-            {
-                case OBJECT_CHARACTER:
-                {
-                    enterMsg.writeString(
-                            o->getComponent<BeingComponent>()->getName());
-                    serializeLooks(o, enterMsg);
-                } break;
+#ifndef NDEBUG
+    dbgLockObjects = true;
+#endif
 
-                case OBJECT_MONSTER:
-                {
-                    MonsterComponent *monsterComponent =
-                            o->getComponent<MonsterComponent>();
-                    enterMsg.writeInt16(monsterComponent->getSpecy()->getId());
-                    enterMsg.writeString(
-                            o->getComponent<BeingComponent>()->getName());
-                } break;
-
-                case OBJECT_NPC:
-                {
-                    NpcComponent *npcComponent =
-                            o->getComponent<NpcComponent>();
-                    enterMsg.writeInt16(npcComponent->getNpcId());
-                    enterMsg.writeString(
-                            o->getComponent<BeingComponent>()->getName());
-                } break;
-
-                default:
-                    assert(false); // TODO
-                    break;
-            }
-            gameHandler->sendTo(p, enterMsg);
-        }
+    {
+        TickProfiler::PhaseTimer timer(TickProfiler::PHASE_SCRIPT);
+        ScriptManager::currentState()->update();
+    }
 
-        if (opos != oold)
-        {
-            // Add position check coords every 5 seconds.
-            if (currentTick % 50 == 0)
-                flags |= MOVING_POSITION;
+    {
+        TickProfiler::PhaseTimer timer(TickProfiler::PHASE_TIMERS);
+        timers.advance(tick);
+    }
 
-            flags |= MOVING_DESTINATION;
-        }
+    const int visualRange = Configuration::getValue("game_visualRange", 448);
 
-        // Send move messages.
-        moveMsg.writeInt16(oid);
-        moveMsg.writeInt8(flags);
-        if (flags & MOVING_POSITION)
+    // Update game state (update AI, etc.)
+    const MapManager::Maps &maps = MapManager::getMaps();
+    if (!mapWorkers)
+    {
+        unsigned updateTime = 0;
+        unsigned informTime = 0;
+        for (MapManager::Maps::const_iterator m = maps.begin(),
+             m_end = maps.end(); m != m_end; ++m)
         {
-            moveMsg.writeInt16(oold.x);
-            moveMsg.writeInt16(oold.y);
-        }
+            MapComposite *map = m->second;
+            if (!map->isActive())
+                continue;
 
-        if (flags & MOVING_DESTINATION)
-        {
-            moveMsg.writeInt16(opos.x);
-            moveMsg.writeInt16(opos.y);
-            // We multiply the sent speed (in tiles per second) by ten
-            // to get it within a byte with decimal precision.
-            // For instance, a value of 4.5 will be sent as 45.
-            auto *tpsSpeedAttribute = attributeManager->getAttributeInfo(ATTR_MOVE_SPEED_TPS);
-            moveMsg.writeInt8((unsigned short)
-                (o->getComponent<BeingComponent>()
-                        ->getModifiedAttribute(tpsSpeedAttribute) * 10));
+            TickProfiler::Clock::time_point start = TickProfiler::Clock::now();
+            map->update();
+            const unsigned mapUpdateTime = TickProfiler::elapsed(start);
+
+            start = TickProfiler::Clock::now();
+            informPlayers(map, visualRange);
+            const unsigned mapInformTime = TickProfiler::elapsed(start);
+
+            TickProfiler::addMapSample(map->getID(),
+                                       TickProfiler::MAP_PHASE_UPDATE,
+                                       mapUpdateTime);
+            TickProfiler::addMapSample(map->getID(),
+                                       TickProfiler::MAP_PHASE_INFORM,
+                                       mapInformTime);
+            updateTime += mapUpdateTime;
+            informTime += mapInformTime;
         }
+        TickProfiler::addSample(TickProfiler::PHASE_MAPS, updateTime);
+        TickProfiler::addSample(TickProfiler::PHASE_INFORM, informTime);
     }
-
-    // Do not send a packet if nothing happened in p's range.
-    if (moveMsg.getLength() > 2)
-        gameHandler->sendTo(p, moveMsg);
-
-    if (damageMsg.getLength() > 2)
-        gameHandler->sendTo(p, damageMsg);
-
-    // Inform client about status change.
-    p->getComponent<CharacterComponent>()->sendStatus(*p);
-
-    // Inform client about health change of party members
-    for (CharacterIterator i(map->getWholeMapIterator()); i; ++i)
+    else
     {
-        Entity *c = *i;
-
-        // Make sure its not the same character
-        if (c == p)
-            continue;
-
-        // make sure they are in the same party
-        if (c->getComponent<CharacterComponent>()->getParty() ==
-                p->getComponent<CharacterComponent>()->getParty())
+        std::vector<MapComposite *> activeMaps;
+        std::vector<unsigned> updateTimes;
         {
-            int cflags = c->getComponent<ActorComponent>()->getUpdateFlags();
-            if (cflags & UPDATEFLAG_HEALTHCHANGE)
+            TickProfiler::PhaseTimer timer(TickProfiler::PHASE_MAPS);
+            for (MapManager::Maps::const_iterator m = maps.begin(),
+                 m_end = maps.end(); m != m_end; ++m)
             {
-                auto *beingComponent = c->getComponent<BeingComponent>();
-
-                MessageOut healthMsg(GPMSG_BEING_HEALTH_CHANGE);
-                healthMsg.writeInt16(
-                        c->getComponent<ActorComponent>()->getPublicID());
-                auto *hpAttribute = attributeManager->getAttributeInfo(ATTR_HP);
-                healthMsg.writeInt16(
-                        beingComponent->getModifiedAttribute(hpAttribute));
-                auto *maxHpAttribute = attributeManager->getAttributeInfo(ATTR_MAX_HP);
-                healthMsg.writeInt16(
-                        beingComponent->getModifiedAttribute(maxHpAttribute));
-                gameHandler->sendTo(p, healthMsg);
+                MapComposite *map = m->second;
+                if (!map->isActive())
+                    continue;
+
+                // Entity updates call into the scripts, which are not
+                // thread-safe. Unlike the serial path, all maps are updated
+                // before the beings of any map move.
+                const TickProfiler::Clock::time_point start =
+                        TickProfiler::Clock::now();
+                map->updateEntities();
+                updateTimes.push_back(TickProfiler::elapsed(start));
+                activeMaps.push_back(map);
             }
         }
-    }
 
-    // Inform client about items on the ground around its character
-    MessageOut itemMsg(GPMSG_ITEMS);
-    for (FixedActorIterator it(map->getAroundBeingIterator(p, visualRange));
-         it; ++it)
-    {
-        Entity *o = *it;
-
-        assert(o->getType() == OBJECT_ITEM ||
-               o->getType() == OBJECT_EFFECT);
-
-        Point opos = o->getComponent<ActorComponent>()->getPosition();
-        int oflags = o->getComponent<ActorComponent>()->getUpdateFlags();
-        bool willBeInRange = ppos.inRangeOf(opos, visualRange);
-        bool wereInRange = pold.inRangeOf(opos, visualRange) &&
-                           !((pflags | oflags) & UPDATEFLAG_NEW_ON_MAP);
-
-        if (willBeInRange ^ wereInRange)
+        // Movement and visibility only involve the map itself. Messages are
+        // collected per map and sent in map order.
+        mapMessages.resize(activeMaps.size());
+        std::vector<unsigned> informTimes(activeMaps.size());
         {
-            switch (o->getType())
-            {
-                case OBJECT_ITEM:
-                {
-                    ItemComponent *item = o->getComponent<ItemComponent>();
-                    ItemClass *itemClass = item->getItemClass();
-
-                    if (oflags & UPDATEFLAG_NEW_ON_MAP)
-                    {
-                        /* Send a specific message to the client when an item appears
-                           out of nowhere, so that a sound/animation can be performed. */
-                        MessageOut appearMsg(GPMSG_ITEM_APPEAR);
-                        appearMsg.writeInt16(itemClass->getDatabaseID());
-                        appearMsg.writeInt16(opos.x);
-                        appearMsg.writeInt16(opos.y);
-                        gameHandler->sendTo(p, appearMsg);
-                    }
-                    else
-                    {
-                        itemMsg.writeInt16(willBeInRange ? itemClass->getDatabaseID() : 0);
-                        itemMsg.writeInt16(opos.x);
-                        itemMsg.writeInt16(opos.y);
-                    }
-                }
-                break;
-                case OBJECT_EFFECT:
-                {
-                    EffectComponent *e = o->getComponent<EffectComponent>();
-                    // Don't show old effects
-                    if (!(oflags & UPDATEFLAG_NEW_ON_MAP))
-                        break;
-
-                    if (Entity *b = e->getBeing())
-                    {
-                        auto *actorComponent =
-                                b->getComponent<ActorComponent>();
-                        MessageOut effectMsg(GPMSG_CREATE_EFFECT_BEING);
-                        effectMsg.writeInt16(e->getEffectId());
-                        effectMsg.writeInt16(actorComponent->getPublicID());
-                        gameHandler->sendTo(p, effectMsg);
-                    } else {
-                        MessageOut effectMsg(GPMSG_CREATE_EFFECT_POS);
-                        effectMsg.writeInt16(e->getEffectId());
-                        effectMsg.writeInt16(opos.x);
-                        effectMsg.writeInt16(opos.y);
-                        gameHandler->sendTo(p, effectMsg);
-                    }
-                }
-                break;
-                default: break;
-            } // Switch
+            TickProfiler::PhaseTimer timer(TickProfiler::PHASE_WORKERS);
+            mapWorkers->run(activeMaps.size(), [&](unsigned i) {
+                GameHandler::setDeferredQueue(&mapMessages[i]);
+                TickProfiler::Clock::time_point start =
+                        TickProfiler::Clock::now();
+                activeMaps[i]->updateMovement();
+                updateTimes[i] += TickProfiler::elapsed(start);
+
+                start = TickProfiler::Clock::now();
+                informPlayers(activeMaps[i], visualRange);
+                informTimes[i] = TickProfiler::elapsed(start);
+                GameHandler::setDeferredQueue(nullptr);
+            });
         }
-    }
-
-    // Do not send a packet if nothing happened in p's range.
-    if (itemMsg.getLength() > 2)
-        gameHandler->sendTo(p, itemMsg);
-}
 
-#ifndef NDEBUG
-static bool dbgLockObjects;
-#endif
-
-void GameState::update(int tick)
-{
-    currentTick = tick;
-
-#ifndef NDEBUG
-    dbgLockObjects = true;
-#endif
-
-    ScriptManager::currentState()->update();
-
-    // Update game state (update AI, etc.)
-    const MapManager::Maps &maps = MapManager::getMaps();
-    for (MapManager::Maps::const_iterator m = maps.begin(),
-         m_end = maps.end(); m != m_end; ++m)
-    {
-        MapComposite *map = m->second;
-        if (!map->isActive())
-            continue;
-
-        map->update();
-
-        for (CharacterIterator p(map->getWholeMapIterator()); p; ++p)
         {
-            informPlayer(map, *p);
+            TickProfiler::PhaseTimer timer(TickProfiler::PHASE_INFORM);
+            for (DeferredMessages &messages : mapMessages)
+                gameHandler->sendDeferred(messages);
         }
 
-        for (ActorIterator it(map->getWholeMapIterator()); it; ++it)
+        // The profiler is not thread-safe, record the map timings here
+        for (unsigned i = 0; i < activeMaps.size(); ++i)
         {
-            Entity *a = *it;
-            a->getComponent<ActorComponent>()->clearUpdateFlags();
-            if (a->canFight())
-            {
-                a->getComponent<BeingComponent>()->clearHitsTaken();
-            }
+            TickProfiler::addMapSample(activeMaps[i]->getID(),
+                                       TickProfiler::MAP_PHASE_UPDATE,
+                                       updateTimes[i]);
+            TickProfiler::addMapSample(activeMaps[i]->getID(),
+                                       TickProfiler::MAP_PHASE_INFORM,
+                                       informTimes[i]);
         }
     }
 
@@ -511,6 +262,8 @@ void GameState::update(int tick)
     dbgLockObjects = false;
 #   endif
 
+    TickProfiler::PhaseTimer timer(TickProfiler::PHASE_EVENTS);
+
     // Take care of events that were delayed because of their side effects.
     for (DelayedEvents::iterator it = delayedEvents.begin(),
          it_end = delayedEvents.end(); it != it_end; ++it)
@@ -642,6 +395,11 @@ int GameState::getCurrentTick()
     return currentTick;
 }
 
+TimerWheel &GameState::getTimers()
+{
+    return timers;
+}
+
 bool GameState::insertOrDelete(Entity *ptr)
 {
     if (insert(ptr)) return true;
@@ -706,19 +464,25 @@ void GameState::remove(Entity *ptr)
                     characterComponent->getDatabaseID(), false);
         }
 
+        const int publicId =
+                ptr->getComponent<ActorComponent>()->getPublicID();
         MessageOut msg(GPMSG_BEING_LEAVE);
-        msg.writeInt16(ptr->getComponent<ActorComponent>()->getPublicID());
+        msg.writeInt16(publicId);
         Point objectPos = ptr->getComponent<ActorComponent>()->getPosition();
 
-        for (CharacterIterator p(map->getAroundActorIterator(ptr, visualRange));
-             p; ++p)
+        std::vector<Entity *> characters;
+        map->getCharactersInRange(objectPos, visualRange, characters);
+        gameHandler->sendTo(characters, msg, ptr);
+
+        // Forget the last movement sent, like the interest pass does when
+        // the being leaves the sight of a client
+        for (Entity *character : characters)
         {
-            if (*p != ptr && objectPos.inRangeOf(
-                    (*p)->getComponent<ActorComponent>()->getPosition(),
-                visualRange))
-            {
-                gameHandler->sendTo(*p, msg);
-            }
+            GameClient *client =
+                    character->getComponent<CharacterComponent>()->getClient();
+            if (client && client->capabilities != -1 &&
+                (client->capabilities & CAPABILITY_MOVE_DELTA))
+                client->movementBaselines.erase(publicId);
         }
     }
     else if (ptr->getType() == OBJECT_ITEM)
@@ -729,15 +493,9 @@ void GameState::remove(Entity *ptr)
         msg.writeInt16(pos.x);
         msg.writeInt16(pos.y);
 
-        for (CharacterIterator p(map->getAroundActorIterator(ptr, visualRange)); p; ++p)
-        {
-            const Point &point =
-                    (*p)->getComponent<ActorComponent>()->getPosition();
-            if (pos.inRangeOf(point, visualRange))
-            {
-                gameHandler->sendTo(*p, msg);
-            }
-        }
+        std::vector<Entity *> characters;
+        map->getCharactersInRange(pos, visualRange, characters);
+        gameHandler->sendTo(characters, msg);
     }
 
     map->remove(ptr);
@@ -830,27 +588,11 @@ void GameState::enqueueWarp(Entity *ptr,
     enqueueEvent(ptr, event);
 }
 
-void GameState::sayAround(Entity *entity, const std::string &text)
-{
-    Point speakerPosition = entity->getComponent<ActorComponent>()->getPosition();
-    int visualRange = Configuration::getValue("game_visualRange", 448);
-
-    for (CharacterIterator i(entity->getMap()->getAroundActorIterator(entity, visualRange)); i; ++i)
-    {
-        const Point &point =
-                (*i)->getComponent<ActorComponent>()->getPosition();
-        if (speakerPosition.inRangeOf(point, visualRange))
-        {
-            sayTo(*i, entity, text);
-        }
-    }
-}
-
-void GameState::sayTo(Entity *destination, Entity *source, const std::string &text)
+/**
+ * Builds the message showing \a text as said by \a source.
+ */
+static MessageOut makeSayMessage(Entity *source, const std::string &text)
 {
-    if (destination->getType() != OBJECT_CHARACTER)
-        return; //only characters will read it anyway
-
     MessageOut msg(GPMSG_SAY);
     if (source == nullptr)
     {
@@ -865,7 +607,29 @@ void GameState::sayTo(Entity *destination, Entity *source, const std::string &te
         msg.writeInt16(source->getComponent<ActorComponent>()->getPublicID());
     }
     msg.writeString(text);
+    return msg;
+}
+
+void GameState::sayAround(Entity *entity, const std::string &text)
+{
+    Point speakerPosition = entity->getComponent<ActorComponent>()->getPosition();
+    int visualRange = Configuration::getValue("game_visualRange", 448);
+
+    std::vector<Entity *> characters;
+    entity->getMap()->getCharactersInRange(speakerPosition, visualRange,
+                                           characters);
+    if (characters.empty())
+        return;
+
+    gameHandler->sendTo(characters, makeSayMessage(entity, text));
+}
+
+void GameState::sayTo(Entity *destination, Entity *source, const std::string &text)
+{
+    if (destination->getType() != OBJECT_CHARACTER)
+        return; //only characters will read it anyway
 
+    MessageOut msg = makeSayMessage(source, text);
     gameHandler->sendTo(destination, msg);
 }
 
@@ -28,9 +28,21 @@
 class Entity;
 class ItemClass;
 class MapComposite;
+class TimerWheel;
 
 namespace GameState
 {
+    /**
+     * Starts the map worker threads when parallel map updates are enabled
+     * (game_mapThreads), and the path scheduler.
+     */
+    void initialize();
+
+    /**
+     * Stops the map worker threads and the path scheduler.
+     */
+    void deinitialize();
+
     /**
      * Updates game state (contains core server logic).
      */
@@ -38,6 +50,12 @@ namespace GameState
 
     int getCurrentTick();
 
+    /**
+     * Returns the timers of the game world, which fire at the start of
+     * each update.
+     */
+    TimerWheel &getTimers();
+
     /**
      * Inserts an entity in the game world.
      * @return false if the insertion failed and the entity is in limbo.
@@ -39,6 +39,9 @@ class StatusEffect
         void setTickCallback(Script *script)
         { script->assignCallback(mTickCallback); }
 
+        bool hasTickCallback() const
+        { return mTickCallback.isValid(); }
+
     private:
         int mId;
         Script::Ref mTickCallback;
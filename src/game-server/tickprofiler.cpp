@@ -0,0 +1,372 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "game-server/tickprofiler.h"
+
+#include "common/configuration.h"
+#include "common/defines.h"
+#include "game-server/mapcomposite.h"
+#include "game-server/mapmanager.h"
+#include "net/messageout.h"
+#include "utils/logger.h"
+#include "utils/string.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+
+namespace
+{
+
+/**
+ * Statistics about the samples of a series.
+ */
+struct Stats
+{
+    Stats(): p50(0), p99(0), max(0), count(0) {}
+
+    unsigned p50;
+    unsigned p99;
+    unsigned max;
+    unsigned count;
+};
+
+/**
+ * Rolling window of samples, in microseconds.
+ */
+class Series
+{
+    public:
+        Series(): mNext(0) {}
+
+        void add(unsigned sample, unsigned window)
+        {
+            if (mSamples.size() < window)
+            {
+                mSamples.push_back(sample);
+                return;
+            }
+            if (mNext >= mSamples.size())
+                mNext = 0;
+            mSamples[mNext++] = sample;
+        }
+
+        Stats getStats() const
+        {
+            Stats stats;
+            if (mSamples.empty())
+                return stats;
+
+            std::vector<unsigned> sorted(mSamples);
+            const unsigned size = sorted.size();
+            std::vector<unsigned>::iterator p50 = sorted.begin() + size / 2;
+            std::vector<unsigned>::iterator p99 = sorted.begin() +
+                                                  (size * 99) / 100;
+            std::nth_element(sorted.begin(), p99, sorted.end());
+            stats.p99 = *p99;
+            stats.max = *std::max_element(p99, sorted.end());
+            std::nth_element(sorted.begin(), p50, p99);
+            stats.p50 = *p50;
+            stats.count = size;
+            return stats;
+        }
+
+        void clear()
+        {
+            mSamples.clear();
+            mNext = 0;
+        }
+
+    private:
+        std::vector<unsigned> mSamples;
+        unsigned mNext;     /**< Oldest sample once the window is full. */
+};
+
+struct MapSeries
+{
+    Series phases[TickProfiler::MAP_PHASE_COUNT];
+};
+
+const char *phaseNames[TickProfiler::PHASE_COUNT] =
+{
+    "account",
+    "game",
+    "script",
+    "timers",
+    "maps",
+    "workers",
+    "inform",
+    "events",
+    "flush",
+    "tick"
+};
+
+const char *mapPhaseNames[TickProfiler::MAP_PHASE_COUNT] =
+{
+    "update",
+    "inform"
+};
+
+} // anonymous namespace
+
+static unsigned window;             /**< Number of ticks kept. */
+static int dumpInterval;            /**< Ticks between dumps, 0 disables. */
+static std::string dumpFile;
+static unsigned overruns;           /**< Ticks over budget in the window. */
+static std::vector<bool> overrunWindow;
+static unsigned overrunNext;
+
+static Series phaseSeries[TickProfiler::PHASE_COUNT];
+static Series allocationSeries;     /**< Message buffers allocated per tick. */
+static unsigned long allocationCount;
+static Series pathQueueSeries;      /**< Path requests queued per tick. */
+static Series pathLatencySeries;    /**< Delay of the queued path requests. */
+static std::map<int, MapSeries> mapSeries;
+
+void TickProfiler::initialize()
+{
+    window = std::max(1, Configuration::getValue("profiler_window", 600));
+    dumpInterval = Configuration::getValue("profiler_dumpInterval", 0);
+    dumpFile = Configuration::getValue("profiler_dumpFile",
+                                       "manaserv-game.profile");
+
+    for (int i = 0; i < PHASE_COUNT; ++i)
+        phaseSeries[i].clear();
+    mapSeries.clear();
+    allocationSeries.clear();
+    pathQueueSeries.clear();
+    pathLatencySeries.clear();
+    allocationCount = MessageOut::getAllocationCount();
+    overruns = 0;
+    overrunWindow.clear();
+    overrunNext = 0;
+
+    if (dumpInterval > 0)
+    {
+        LOG_INFO("Writing tick profile to " << dumpFile << " every "
+                 << dumpInterval << " ticks.");
+    }
+}
+
+void TickProfiler::addSample(Phase phase, unsigned micros)
+{
+    phaseSeries[phase].add(micros, window);
+}
+
+void TickProfiler::addMapSample(int mapId, MapPhase phase, unsigned micros)
+{
+    mapSeries[mapId].phases[phase].add(micros, window);
+}
+
+void TickProfiler::addPathSamples(unsigned queued,
+                                  const std::vector<unsigned> &latencies)
+{
+    pathQueueSeries.add(queued, window);
+    for (unsigned latency : latencies)
+        pathLatencySeries.add(latency, window);
+}
+
+static void writeStats(std::ostream &os, const Stats &stats)
+{
+    os << "{\"p50\":" << stats.p50
+       << ",\"p99\":" << stats.p99
+       << ",\"max\":" << stats.max << '}';
+}
+
+/**
+ * Appends the current statistics to the dump file, as a single JSON object
+ * on its own line. Durations are in microseconds.
+ */
+static void dump(int tick)
+{
+    std::ofstream os(dumpFile.c_str(), std::ios::app);
+    if (!os)
+    {
+        LOG_WARN("Unable to write tick profile to " << dumpFile);
+        return;
+    }
+
+    os << "{\"tick\":" << tick
+       << ",\"window\":" << phaseSeries[TickProfiler::PHASE_TICK]
+                               .getStats().count
+       << ",\"overruns\":" << overruns
+       << ",\"messageAllocations\":";
+    writeStats(os, allocationSeries.getStats());
+    os << ",\"pathQueue\":";
+    writeStats(os, pathQueueSeries.getStats());
+    os << ",\"pathLatency\":";
+    writeStats(os, pathLatencySeries.getStats());
+    os << ",\"phases\":{";
+    for (int i = 0; i < TickProfiler::PHASE_COUNT; ++i)
+    {
+        if (i)
+            os << ',';
+        os << '"' << phaseNames[i] << "\":";
+        writeStats(os, phaseSeries[i].getStats());
+    }
+    os << "},\"maps\":{";
+    for (std::map<int, MapSeries>::const_iterator it = mapSeries.begin(),
+         it_end = mapSeries.end(); it != it_end; ++it)
+    {
+        if (it != mapSeries.begin())
+            os << ',';
+        os << '"' << it->first << "\":{";
+        for (int i = 0; i < TickProfiler::MAP_PHASE_COUNT; ++i)
+        {
+            if (i)
+                os << ',';
+            os << '"' << mapPhaseNames[i] << "\":";
+            writeStats(os, it->second.phases[i].getStats());
+        }
+        if (MapComposite *map = MapManager::getMap(it->first))
+            os << ",\"zoneChanges\":" << map->getZoneChanges();
+        os << '}';
+    }
+    os << "}}\n";
+}
+
+void TickProfiler::endTick(int tick, unsigned micros)
+{
+    addSample(PHASE_TICK, micros);
+
+    const unsigned long allocations = MessageOut::getAllocationCount();
+    allocationSeries.add(allocations - allocationCount, window);
+    allocationCount = allocations;
+
+    // Keep track of the ticks which did not fit in the budget
+    const bool overrun = micros > WORLD_TICK_MS * 1000;
+    if (overrunWindow.size() < window)
+    {
+        overrunWindow.push_back(overrun);
+    }
+    else
+    {
+        if (overrunNext >= overrunWindow.size())
+            overrunNext = 0;
+        if (overrunWindow[overrunNext])
+            --overruns;
+        overrunWindow[overrunNext++] = overrun;
+    }
+    if (overrun)
+        ++overruns;
+
+    if (dumpInterval > 0 && tick % dumpInterval == 0)
+        dump(tick);
+}
+
+/**
+ * Formats a duration given in microseconds as milliseconds.
+ */
+static std::string toMs(unsigned micros)
+{
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%u.%02u", micros / 1000,
+             (micros % 1000) / 10);
+    return buffer;
+}
+
+static std::string formatStats(const std::string &name, const Stats &stats)
+{
+    return name + ": p50 " + toMs(stats.p50) +
+                  " p99 " + toMs(stats.p99) +
+                  " max " + toMs(stats.max) + " ms";
+}
+
+std::vector<std::string> TickProfiler::getPhaseReport()
+{
+    std::vector<std::string> lines;
+
+    const Stats tick = phaseSeries[PHASE_TICK].getStats();
+    lines.push_back("Last " + utils::toString(tick.count) + " ticks, " +
+                    utils::toString(overruns) + " over the " +
+                    utils::toString(WORLD_TICK_MS) + " ms budget");
+
+    for (int i = 0; i < PHASE_COUNT; ++i)
+    {
+        const Stats stats = phaseSeries[i].getStats();
+        if (stats.count)
+            lines.push_back(formatStats(phaseNames[i], stats));
+    }
+
+    const Stats allocations = allocationSeries.getStats();
+    lines.push_back("message buffer allocations per tick: p50 " +
+                    utils::toString(allocations.p50) + " p99 " +
+                    utils::toString(allocations.p99) + " max " +
+                    utils::toString(allocations.max));
+
+    const Stats queued = pathQueueSeries.getStats();
+    lines.push_back("queued path requests per tick: p50 " +
+                    utils::toString(queued.p50) + " p99 " +
+                    utils::toString(queued.p99) + " max " +
+                    utils::toString(queued.max));
+
+    const Stats latency = pathLatencySeries.getStats();
+    if (latency.count)
+        lines.push_back(formatStats("queued path request latency", latency));
+    return lines;
+}
+
+std::vector<std::string> TickProfiler::getMapReport(unsigned count)
+{
+    struct MapCost
+    {
+        int id;
+        unsigned cost;  /**< Sum of the p99 of the phases. */
+        Stats stats[MAP_PHASE_COUNT];
+
+        bool operator<(const MapCost &other) const
+        { return cost > other.cost; }
+    };
+
+    std::vector<MapCost> costs;
+    for (std::map<int, MapSeries>::const_iterator it = mapSeries.begin(),
+         it_end = mapSeries.end(); it != it_end; ++it)
+    {
+        MapCost cost;
+        cost.id = it->first;
+        cost.cost = 0;
+        for (int i = 0; i < MAP_PHASE_COUNT; ++i)
+        {
+            cost.stats[i] = it->second.phases[i].getStats();
+            cost.cost += cost.stats[i].p99;
+        }
+        costs.push_back(cost);
+    }
+    std::sort(costs.begin(), costs.end());
+
+    std::vector<std::string> lines;
+    for (unsigned i = 0; i < costs.size() && i < count; ++i)
+    {
+        const MapCost &cost = costs[i];
+        std::string name = utils::toString(cost.id);
+        if (MapComposite *map = MapManager::getMap(cost.id))
+        {
+            name += " (" + map->getName() + "), " +
+                    utils::toString(map->getZoneChanges()) + " zone changes";
+        }
+        lines.push_back("Map " + name);
+        for (int p = 0; p < MAP_PHASE_COUNT; ++p)
+            lines.push_back("  " + formatStats(mapPhaseNames[p],
+                                               cost.stats[p]));
+    }
+    return lines;
+}
@@ -0,0 +1,141 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TICKPROFILER_H
+#define TICKPROFILER_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+/**
+ * Keeps track of the time spent in the phases of the world ticks, so that the
+ * phases (and maps) eating the tick budget can be found.
+ *
+ * Samples are kept over a rolling window of ticks, from which the median,
+ * 99th percentile and maximum are reported.
+ */
+namespace TickProfiler
+{
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     * Phases of a world tick.
+     */
+    enum Phase
+    {
+        PHASE_ACCOUNT = 0,  /**< Handling account server messages. */
+        PHASE_GAME,         /**< Handling client messages. */
+        PHASE_SCRIPT,       /**< Script engine update. */
+        PHASE_TIMERS,       /**< Timers firing, see TimerWheel. */
+        PHASE_MAPS,         /**< Entity updates (and movement, when serial). */
+        PHASE_WORKERS,      /**< Parallel map updates, see game_mapThreads. */
+        PHASE_INFORM,       /**< Building the messages sent to the players
+                                 (sending them, with parallel maps). */
+        PHASE_EVENTS,       /**< Delayed inserts, removals and warps. */
+        PHASE_FLUSH,        /**< Handing outgoing messages to ENet. */
+        PHASE_TICK,         /**< The whole tick. */
+        PHASE_COUNT
+    };
+
+    /**
+     * Phases measured for each map.
+     */
+    enum MapPhase
+    {
+        MAP_PHASE_UPDATE = 0,   /**< Entity update and movement. */
+        MAP_PHASE_INFORM,       /**< Building the messages for the players. */
+        MAP_PHASE_COUNT
+    };
+
+    /**
+     * Reads the profiler options from the configuration.
+     */
+    void initialize();
+
+    /**
+     * Returns the microseconds elapsed since \a start.
+     */
+    inline unsigned elapsed(Clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                    Clock::now() - start).count();
+    }
+
+    /**
+     * Records the duration of a phase of the current tick, in microseconds.
+     */
+    void addSample(Phase phase, unsigned micros);
+
+    /**
+     * Records the duration of a phase of the current tick for the given map,
+     * in microseconds.
+     * @note Must be called from the main thread.
+     */
+    void addMapSample(int mapId, MapPhase phase, unsigned micros);
+
+    /**
+     * Records the number of path requests waiting for a worker at the start
+     * of the tick, and the latencies of the requests handed out, in
+     * microseconds.
+     */
+    void addPathSamples(unsigned queued, const std::vector<unsigned> &latencies);
+
+    /**
+     * Records the duration of a whole tick and the number of message buffers
+     * allocated during it, and writes the periodic dump when it is due.
+     */
+    void endTick(int tick, unsigned micros);
+
+    /**
+     * Returns human readable lines describing the timings of the phases, the
+     * message buffer allocations and the queued path requests.
+     */
+    std::vector<std::string> getPhaseReport();
+
+    /**
+     * Returns human readable lines describing the timings of the maps, the
+     * most expensive ones first.
+     *
+     * @param count the maximum number of maps to report.
+     */
+    std::vector<std::string> getMapReport(unsigned count);
+
+    /**
+     * Measures the time spent in a scope and records it for a phase.
+     */
+    class PhaseTimer
+    {
+        public:
+            PhaseTimer(Phase phase):
+                mPhase(phase),
+                mStart(Clock::now())
+            {}
+
+            ~PhaseTimer()
+            { addSample(mPhase, elapsed(mStart)); }
+
+        private:
+            Phase mPhase;
+            Clock::time_point mStart;
+    };
+}
+
+#endif // TICKPROFILER_H
@@ -0,0 +1,209 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "game-server/timerwheel.h"
+
+#include <cassert>
+
+// Ids hold the index of the timer and a generation, so that the id of a
+// timer that fired does not match the next timer stored at the same index.
+static const unsigned INDEX_BITS = 20;
+static const unsigned INDEX_MASK = (1u << INDEX_BITS) - 1;
+static const unsigned GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+
+TimerWheel::TimerWheel():
+    mCurrentTick(0),
+    mPending(0)
+{
+    for (int i = 0; i < SLOT_COUNT; ++i)
+        mSlots[i] = -1;
+}
+
+unsigned TimerWheel::schedule(int ticks, const Callback &callback)
+{
+    int index;
+    if (mFreeTimers.empty())
+    {
+        index = mTimers.size();
+        assert(unsigned(index) <= INDEX_MASK);
+        mTimers.push_back(Timer());
+        mTimers.back().generation = 1;
+    }
+    else
+    {
+        index = mFreeTimers.back();
+        mFreeTimers.pop_back();
+    }
+
+    // Keep the deadline within the range of the last level
+    const int maxTicks = (FIRST_SLOTS << (LEVEL_BITS * (LEVELS - 1))) - 1;
+    if (ticks < 1)
+        ticks = 1;
+    else if (ticks > maxTicks)
+        ticks = maxTicks;
+
+    Timer &timer = mTimers[index];
+    timer.callback = callback;
+    timer.deadline = mCurrentTick + ticks;
+    insert(index);
+    ++mPending;
+
+    return (timer.generation << INDEX_BITS) | index;
+}
+
+void TimerWheel::cancel(unsigned id)
+{
+    if (find(id))
+    {
+        const int index = id & INDEX_MASK;
+        unlink(index);
+        release(index);
+    }
+}
+
+bool TimerWheel::isPending(unsigned id) const
+{
+    return find(id);
+}
+
+const TimerWheel::Timer *TimerWheel::find(unsigned id) const
+{
+    const unsigned index = id & INDEX_MASK;
+    if (!id || index >= mTimers.size())
+        return nullptr;
+
+    const Timer &timer = mTimers[index];
+    if (timer.slot == -1 || timer.generation != id >> INDEX_BITS)
+        return nullptr;
+    return &timer;
+}
+
+void TimerWheel::advance(int tick)
+{
+    while (mCurrentTick < tick)
+    {
+        if (!mPending)
+        {
+            mCurrentTick = tick;
+            break;
+        }
+
+        ++mCurrentTick;
+
+        // Move down the timers of the higher levels whose slot comes up
+        const int slot = mCurrentTick & (FIRST_SLOTS - 1);
+        if (slot == 0)
+        {
+            for (int level = 1; level < LEVELS; ++level)
+            {
+                const int shift = FIRST_BITS + (level - 1) * LEVEL_BITS;
+                const int levelSlot =
+                        (mCurrentTick >> shift) & (LEVEL_SLOTS - 1);
+                cascade(level, levelSlot);
+                if (levelSlot != 0)
+                    break;
+            }
+        }
+
+        // Timers scheduled by the callbacks are never due on this tick, so
+        // they do not end up in this slot.
+        while (mSlots[slot] != -1)
+        {
+            const int index = mSlots[slot];
+            unlink(index);
+
+            // Timers do not move while others are added, so the callback
+            // can be called in place.
+            Timer &timer = mTimers[index];
+            timer.slot = -1;
+            timer.callback();
+            release(index);
+        }
+    }
+}
+
+void TimerWheel::insert(int index)
+{
+    Timer &timer = mTimers[index];
+    const int ticks = timer.deadline - mCurrentTick;
+
+    int slot;
+    if (ticks < FIRST_SLOTS)
+    {
+        slot = timer.deadline & (FIRST_SLOTS - 1);
+    }
+    else
+    {
+        int level = 1;
+        int shift = FIRST_BITS;
+        while (level < LEVELS - 1 && ticks >= 1 << (shift + LEVEL_BITS))
+        {
+            ++level;
+            shift += LEVEL_BITS;
+        }
+        slot = FIRST_SLOTS + (level - 1) * LEVEL_SLOTS
+               + ((timer.deadline >> shift) & (LEVEL_SLOTS - 1));
+    }
+
+    timer.slot = slot;
+    timer.prev = -1;
+    timer.next = mSlots[slot];
+    if (timer.next != -1)
+        mTimers[timer.next].prev = index;
+    mSlots[slot] = index;
+}
+
+void TimerWheel::unlink(int index)
+{
+    Timer &timer = mTimers[index];
+    if (timer.prev != -1)
+        mTimers[timer.prev].next = timer.next;
+    else
+        mSlots[timer.slot] = timer.next;
+    if (timer.next != -1)
+        mTimers[timer.next].prev = timer.prev;
+}
+
+void TimerWheel::release(int index)
+{
+    Timer &timer = mTimers[index];
+    timer.callback = Callback();
+    timer.slot = -1;
+    timer.generation = (timer.generation + 1) & GENERATION_MASK;
+    if (!timer.generation)
+        timer.generation = 1;
+    mFreeTimers.push_back(index);
+    --mPending;
+}
+
+void TimerWheel::cascade(int level, int slot)
+{
+    int &first = mSlots[FIRST_SLOTS + (level - 1) * LEVEL_SLOTS + slot];
+    int index = first;
+    first = -1;
+
+    while (index != -1)
+    {
+        const int next = mTimers[index].next;
+        insert(index);
+        index = next;
+    }
+}
@@ -0,0 +1,115 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <deque>
+#include <vector>
+
+#include <sigc++/functors/slot.h>
+
+/**
+ * Calls callbacks at given ticks. Timers are kept in a hierarchical wheel:
+ * the first level has a slot for each of the next 256 ticks, and each
+ * further level has 64 slots covering 64 times the range of the level
+ * below. Timers move down a level when their slot comes up, so advancing a
+ * tick only touches the timers that are due, plus an occasional move.
+ *
+ * Callbacks bound to a trackable object, like a component, are not called
+ * once the object is gone. Cancelling such timers still frees them early.
+ */
+class TimerWheel
+{
+    public:
+        typedef sigc::slot<void> Callback;
+
+        TimerWheel();
+
+        /**
+         * Calls \a callback once \a ticks ticks have passed, at the earliest
+         * on the next tick. Deadlines further away than about 77 days are
+         * brought closer.
+         *
+         * @return the id of the timer, never 0.
+         */
+        unsigned schedule(int ticks, const Callback &callback);
+
+        /**
+         * Cancels a timer. Ids of timers that already fired are ignored, as
+         * is 0.
+         */
+        void cancel(unsigned id);
+
+        /**
+         * Returns whether a timer is still waiting to fire.
+         */
+        bool isPending(unsigned id) const;
+
+        /**
+         * Moves the time to \a tick, calling the callbacks of the timers due
+         * by then in order of their deadline. Callbacks may schedule and
+         * cancel timers.
+         */
+        void advance(int tick);
+
+        /**
+         * Returns the number of timers waiting to fire.
+         */
+        unsigned getPending() const
+        { return mPending; }
+
+    private:
+        TimerWheel(const TimerWheel &) = delete;
+        TimerWheel &operator=(const TimerWheel &) = delete;
+
+        struct Timer
+        {
+            Callback callback;
+            int deadline;
+            int slot;               /**< Slot of the wheel, -1 when free. */
+            int prev, next;         /**< Timers in the same slot. */
+            unsigned generation;
+        };
+
+        void insert(int index);
+        void unlink(int index);
+        void release(int index);
+        void cascade(int level, int slot);
+
+        const Timer *find(unsigned id) const;
+
+        static const int LEVELS = 4;
+        static const int FIRST_BITS = 8;
+        static const int LEVEL_BITS = 6;
+        static const int FIRST_SLOTS = 1 << FIRST_BITS;
+        static const int LEVEL_SLOTS = 1 << LEVEL_BITS;
+        static const int SLOT_COUNT = FIRST_SLOTS
+                                      + (LEVELS - 1) * LEVEL_SLOTS;
+
+        int mCurrentTick;
+        unsigned mPending;
+        int mSlots[SLOT_COUNT];     /**< First timer of each slot, or -1. */
+        std::deque<Timer> mTimers;  /**< Does not move timers when growing. */
+        std::vector<int> mFreeTimers;
+};
+
+#endif // TIMERWHEEL_H
@@ -103,26 +103,20 @@ void TriggerAreaComponent::update(Entity &entity)
     MapComposite *map = entity.getMap();
     std::set<Entity *> insideNow;
 
-    for (BeingIterator i(map->getInsideRectangleIterator(mZone)); i; ++i)
+    std::vector<Entity *> beings;
+    map->getBeingsInRectangle(mZone, beings);
+    for (std::vector<Entity *>::const_iterator i = beings.begin(),
+         i_end = beings.end(); i != i_end; ++i)
     {
         // Don't deal with uninitialized actors
-        if (!(*i) || !(*i)->getComponent<ActorComponent>()->isPublicIdValid())
+        if (!(*i)->getComponent<ActorComponent>()->isPublicIdValid())
             continue;
 
-        // The BeingIterator returns the mapZones in touch with the rectangle
-        // area. On the other hand, the beings contained in the map zones
-        // may not be within the rectangle area. Hence, this additional
-        // contains() condition.
-        const Point &point =
-                (*i)->getComponent<ActorComponent>()->getPosition();
-        if (mZone.contains(point))
-        {
-            insideNow.insert(*i);
+        insideNow.insert(*i);
 
-            if (!mOnce || mInside.find(*i) == mInside.end())
-            {
-                mAction->process(*i);
-            }
+        if (!mOnce || mInside.find(*i) == mInside.end())
+        {
+            mAction->process(*i);
         }
     }
     mInside.swap(insideNow); //swapping is faster than assigning
@@ -96,7 +96,7 @@ class ScriptAction : public TriggerAction
         int mArg;               // Argument passed to script function (meaning is function-specific)
 };
 
-class TriggerAreaComponent : public Component
+class TriggerAreaComponent : public PooledComponent<TriggerAreaComponent>
 {
     public:
         static const ComponentType type = CT_TriggerArea;
@@ -26,7 +26,9 @@ BandwidthMonitor::BandwidthMonitor():
     mAmountServerOutput(0),
     mAmountServerInput(0),
     mAmountClientOutput(0),
-    mAmountClientInput(0)
+    mAmountClientInput(0),
+    mBatchedMessages(0),
+    mBatchPackets(0)
 {
 }
 
@@ -76,3 +78,8 @@ void BandwidthMonitor::increaseClientInput(NetComputer *nc, int size)
     itr->second.second += size;
 }
 
+void BandwidthMonitor::increaseBatchedMessages(int messages)
+{
+    mBatchedMessages += messages;
+    ++mBatchPackets;
+}
@@ -38,11 +38,20 @@ public:
     int totalClientOut() const { return mAmountClientOutput; }
     int totalClientIn() const { return mAmountClientInput; }
 
+    /**
+     * Records a packet gathering \a messages client messages.
+     */
+    void increaseBatchedMessages(int messages);
+    int totalBatchedMessages() const { return mBatchedMessages; }
+    int totalPacketsSaved() const { return mBatchedMessages - mBatchPackets; }
+
 private:
     int mAmountServerOutput;
     int mAmountServerInput;
     int mAmountClientOutput;
     int mAmountClientInput;
+    int mBatchedMessages;
+    int mBatchPackets;
     // map of client to output and input
     typedef std::map<NetComputer*, std::pair<int, int> > ClientBandwidth;
     ClientBandwidth mClientBandwidth;
@@ -88,6 +88,11 @@ void ConnectionHandler::stopListen()
 
 void ConnectionHandler::flush()
 {
+    for (NetComputers::iterator i = clients.begin(), i_end = clients.end();
+         i != i_end; ++i)
+    {
+        (*i)->flushBatch();
+    }
     enet_host_flush(host);
 }
 
@@ -155,10 +160,11 @@ void ConnectionHandler::process(enet_uint32 timeout)
 
 void ConnectionHandler::sendToEveryone(const MessageOut &msg)
 {
+    SharedPacket packet(msg);
     for (NetComputers::iterator i = clients.begin(), i_end = clients.end();
          i != i_end; ++i)
     {
-        (*i)->send(msg);
+        (*i)->send(packet);
     }
 }
 
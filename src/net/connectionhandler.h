@@ -62,7 +62,8 @@ class ConnectionHandler
         virtual void process(enet_uint32 timeout = 0);
 
         /**
-         * Process outgoing messages.
+         * Process outgoing messages, including the batches of messages
+         * gathered for the clients.
          */
         void flush();
 
@@ -72,7 +73,8 @@ class ConnectionHandler
         //void receivePacket(NetComputer *computer, Packet *packet);
 
         /**
-         * Send packet to every client, used for announcements.
+         * Send packet to every client, used for announcements. The message
+         * is serialized once and the packet shared between the clients.
          */
         void sendToEveryone(const MessageOut &msg);
 
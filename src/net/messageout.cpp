@@ -21,6 +21,8 @@
 #include "net/messageout.h"
 #include "net/messagein.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
@@ -28,25 +30,150 @@
 #include <limits>
 #include <sstream>
 #endif
+#include <mutex>
 #include <stdint.h>
 #include <string>
 #include <enet/enet.h>
 
-/** Initial amount of bytes allocated for the messageout data buffer. */
-const unsigned INITIAL_DATA_CAPACITY = 16;
+#if defined(ENET_VERSION_CREATE) && ENET_VERSION >= ENET_VERSION_CREATE(1,3,0)
+#define PACKET_FREE_CALLBACK
+#endif
+
+/** Size of the smallest pooled buffer. Sizes double from there. */
+const unsigned MIN_POOLED_CAPACITY = MessageOut::INLINE_CAPACITY * 2;
+
+/** Number of pooled buffer sizes. Larger buffers are not pooled. */
+const unsigned POOL_SIZES = 8;
+
+/** Buffers of each size cached by a thread. */
+const unsigned THREAD_CACHE_CAPACITY = 32;
 
-/** Factor by which the messageout data buffer is increased when too small. */
-const unsigned CAPACITY_GROW_FACTOR = 2;
+/** Buffers of each size kept for all threads. */
+const unsigned DEPOT_CAPACITY = 256;
 
 static bool debugModeEnabled = false;
 
+static std::atomic<unsigned long> allocationCount(0);
+
+namespace {
+
+/**
+ * Stack of free buffers for each pooled size.
+ */
+template<unsigned Capacity>
+struct BufferCache
+{
+    char *buffers[POOL_SIZES][Capacity];
+    unsigned counts[POOL_SIZES];
+};
+
+} // anonymous namespace
+
+/*
+ * Buffers are taken from and given back to a cache private to the thread.
+ * Since messages built by map workers are sent by the main thread, buffers
+ * flow between threads through a shared depot, in batches to keep locking
+ * rare.
+ */
+static thread_local BufferCache<THREAD_CACHE_CAPACITY> threadCache;
+static BufferCache<DEPOT_CAPACITY> depot;
+static std::mutex depotMutex;
+
+/**
+ * Returns the index of the smallest pooled size holding \a bytes, or
+ * POOL_SIZES when the buffer is too large to be pooled.
+ */
+static unsigned poolIndex(size_t bytes)
+{
+    unsigned index = 0;
+    while (index < POOL_SIZES && (MIN_POOLED_CAPACITY << index) < bytes)
+        ++index;
+    return index;
+}
+
+/**
+ * Gets a buffer of at least \a bytes, and sets \a capacity to its actual
+ * size.
+ */
+static char *acquireBuffer(size_t bytes, unsigned &capacity)
+{
+    const unsigned index = poolIndex(bytes);
+    if (index == POOL_SIZES)
+    {
+        ++allocationCount;
+        capacity = bytes;
+        return (char*) malloc(bytes);
+    }
+
+    capacity = MIN_POOLED_CAPACITY << index;
+
+    unsigned &count = threadCache.counts[index];
+    if (count == 0)
+    {
+        // Refill half of the thread cache from the depot
+        std::lock_guard<std::mutex> lock(depotMutex);
+        unsigned &depotCount = depot.counts[index];
+        while (depotCount && count < THREAD_CACHE_CAPACITY / 2)
+        {
+            threadCache.buffers[index][count++] =
+                    depot.buffers[index][--depotCount];
+        }
+    }
+
+    if (count)
+        return threadCache.buffers[index][--count];
+
+    ++allocationCount;
+    return (char*) malloc(capacity);
+}
+
+/**
+ * Gives back a buffer obtained from acquireBuffer().
+ */
+static void releaseBuffer(char *data, unsigned capacity)
+{
+    const unsigned index = poolIndex(capacity);
+    if (index == POOL_SIZES || (MIN_POOLED_CAPACITY << index) != capacity)
+    {
+        free(data);
+        return;
+    }
+
+    unsigned &count = threadCache.counts[index];
+    if (count == THREAD_CACHE_CAPACITY)
+    {
+        // Move half of the thread cache to the depot
+        std::lock_guard<std::mutex> lock(depotMutex);
+        unsigned &depotCount = depot.counts[index];
+        while (count > THREAD_CACHE_CAPACITY / 2)
+        {
+            char *buffer = threadCache.buffers[index][--count];
+            if (depotCount < DEPOT_CAPACITY)
+                depot.buffers[index][depotCount++] = buffer;
+            else
+                free(buffer);
+        }
+    }
+
+    threadCache.buffers[index][count++] = data;
+}
+
+#ifdef PACKET_FREE_CALLBACK
+/**
+ * Called by ENet when a packet made by MessageOut::toPacket() is destroyed.
+ */
+static void freePacketData(ENetPacket *packet)
+{
+    releaseBuffer((char*) packet->data, (uintptr_t) packet->userData);
+}
+#endif
+
 MessageOut::MessageOut(int id):
+    mData(mInline),
     mPos(0),
+    mDataSize(INLINE_CAPACITY),
     mDebugMode(false)
 {
-    mData = (char*) malloc(INITIAL_DATA_CAPACITY);
-    mDataSize = INITIAL_DATA_CAPACITY;
-
     if (debugModeEnabled)
         id |= ManaServ::XXMSG_DEBUG_FLAG;
 
@@ -54,23 +181,110 @@ MessageOut::MessageOut(int id):
     mDebugMode = debugModeEnabled;
 }
 
+MessageOut::MessageOut(const MessageOut &other):
+    mData(mInline),
+    mPos(other.mPos),
+    mDataSize(INLINE_CAPACITY),
+    mDebugMode(other.mDebugMode)
+{
+    if (mPos > INLINE_CAPACITY)
+        mData = acquireBuffer(mPos, mDataSize);
+    memcpy(mData, other.mData, mPos);
+}
+
+MessageOut::MessageOut(MessageOut &&other):
+    mData(other.mData),
+    mPos(other.mPos),
+    mDataSize(other.mDataSize),
+    mDebugMode(other.mDebugMode)
+{
+    if (other.mData == other.mInline)
+    {
+        mData = mInline;
+        memcpy(mData, other.mData, mPos);
+    }
+
+    other.mData = other.mInline;
+    other.mPos = 0;
+    other.mDataSize = INLINE_CAPACITY;
+}
+
+MessageOut &MessageOut::operator=(MessageOut &&other)
+{
+    releaseData();
+
+    mPos = other.mPos;
+    mDebugMode = other.mDebugMode;
+    if (other.mData == other.mInline)
+    {
+        memcpy(mData, other.mData, mPos);
+    }
+    else
+    {
+        mData = other.mData;
+        mDataSize = other.mDataSize;
+    }
+
+    other.mData = other.mInline;
+    other.mPos = 0;
+    other.mDataSize = INLINE_CAPACITY;
+    return *this;
+}
+
 MessageOut::~MessageOut()
 {
-    free(mData);
+    releaseData();
+}
+
+void MessageOut::releaseData()
+{
+    if (mData != mInline)
+        releaseBuffer(mData, mDataSize);
+
+    mData = mInline;
+    mDataSize = INLINE_CAPACITY;
 }
 
 void MessageOut::expand(size_t bytes)
 {
     if (bytes > mDataSize)
     {
-        do
+        unsigned capacity;
+        char *data = acquireBuffer(std::max<size_t>(bytes, mDataSize * 2),
+                                   capacity);
+        memcpy(data, mData, mPos);
+        releaseData();
+
+        mData = data;
+        mDataSize = capacity;
+    }
+}
+
+ENetPacket *MessageOut::toPacket(unsigned flags)
+{
+    ENetPacket *packet;
+
+#ifdef PACKET_FREE_CALLBACK
+    if (mData != mInline)
+    {
+        packet = enet_packet_create(mData, mPos,
+                                    flags | ENET_PACKET_FLAG_NO_ALLOCATE);
+        if (packet)
         {
-            mDataSize *= CAPACITY_GROW_FACTOR;
+            // The packet owns the buffer from now on
+            packet->userData = (void*) (uintptr_t) mDataSize;
+            packet->freeCallback = freePacketData;
+            mData = mInline;
+            mDataSize = INLINE_CAPACITY;
         }
-        while (bytes > mDataSize);
-
-        mData = (char*) realloc(mData, mDataSize);
+        mPos = 0;
+        return packet;
     }
+#endif
+
+    packet = enet_packet_create(mData, mPos, flags);
+    mPos = 0;
+    return packet;
 }
 
 void MessageOut::writeInt8(int value)
@@ -160,6 +374,33 @@ void MessageOut::writeString(const std::string &string, int length)
     mPos += length;
 }
 
+void MessageOut::append(const MessageOut &other)
+{
+    // Skip the message ID
+    if (other.mPos <= 2)
+        return;
+
+    const unsigned length = other.mPos - 2;
+    expand(mPos + length);
+    memcpy(mData + mPos, other.mData + 2, length);
+    mPos += length;
+}
+
+void MessageOut::writeMessage(const MessageOut &other)
+{
+    // Same layout as a string of fixed length, which it is in debug mode
+    writeInt16(other.mPos);
+    if (mDebugMode)
+    {
+        writeValueType(ManaServ::String);
+        writeInt16(other.mPos);
+    }
+
+    expand(mPos + other.mPos);
+    memcpy(mData + mPos, other.mData, other.mPos);
+    mPos += other.mPos;
+}
+
 void MessageOut::writeValueType(ManaServ::ValueType type)
 {
     expand(mPos + 1);
@@ -187,3 +428,8 @@ void MessageOut::setDebugModeEnabled(bool enabled)
 {
     debugModeEnabled = enabled;
 }
+
+unsigned long MessageOut::getAllocationCount()
+{
+    return allocationCount;
+}
@@ -25,8 +25,15 @@
 
 #include <iosfwd>
 
+typedef struct _ENetPacket ENetPacket;
+
 /**
  * Used for building an outgoing message.
+ *
+ * Small messages are built in a buffer inside the object. Larger ones use
+ * buffers taken from a pool, which are reused once the message or the packet
+ * made from it is destroyed, so that building messages does not allocate
+ * memory once the server runs in a steady state.
  */
 class MessageOut
 {
@@ -38,8 +45,25 @@ class MessageOut
          */
         MessageOut(int id);
 
+        /**
+         * Copies the contents of another message.
+         */
+        MessageOut(const MessageOut &other);
+
+        /**
+         * Takes over the buffer of another message.
+         */
+        MessageOut(MessageOut &&other);
+
         ~MessageOut();
 
+        MessageOut &operator=(const MessageOut &) = delete;
+
+        /**
+         * Takes over the buffer of another message.
+         */
+        MessageOut &operator=(MessageOut &&other);
+
         /**
          * Writes an 8-bit integer to the message.
          */
@@ -67,6 +91,29 @@ class MessageOut
          */
         void writeString(const std::string &string, int length = -1);
 
+        /**
+         * Appends the content of another message, without its message ID.
+         * This allows serializing parts of a message once and reusing them
+         * in several messages.
+         */
+        void append(const MessageOut &other);
+
+        /**
+         * Writes a whole message, including its ID, preceded by its length.
+         * Used to gather several messages into a single one.
+         */
+        void writeMessage(const MessageOut &other);
+
+        /**
+         * Turns the message into an ENet packet with the given flags. A
+         * pooled buffer is handed over to the packet without being copied,
+         * and goes back to the pool when ENet destroys the packet. The
+         * message is left empty.
+         *
+         * @return the packet, or null on failure.
+         */
+        ENetPacket *toPacket(unsigned flags);
+
         /**
          * Returns the content of the message.
          */
@@ -86,6 +133,15 @@ class MessageOut
          */
         static void setDebugModeEnabled(bool enabled);
 
+        /**
+         * Returns the number of times a message buffer had to be allocated
+         * from the heap, because none was available in the pool.
+         */
+        static unsigned long getAllocationCount();
+
+        /** Size of the buffer inside the message object. */
+        static const unsigned INLINE_CAPACITY = 64;
+
     private:
         /**
          * Ensures the capacity of the data buffer is large enough to hold the
@@ -93,12 +149,19 @@ class MessageOut
          */
         void expand(size_t size);
 
+        /**
+         * Gives back the pooled buffer, if any, and makes the message use its
+         * inline buffer again.
+         */
+        void releaseData();
+
         void writeValueType(ManaServ::ValueType type);
 
         char *mData;                /**< Data building up. */
         unsigned mPos;              /**< Position in the data. */
         unsigned mDataSize;         /**< Allocated datasize. */
         bool mDebugMode;            /**< Include debugging information. */
+        char mInline[INLINE_CAPACITY]; /**< Storage for small messages. */
 
         /**
          * Streams message ID and length to the given output stream.
@@ -29,8 +29,30 @@
 #include "../utils/logger.h"
 #include "../utils/processorutils.h"
 
+SharedPacket::SharedPacket(const MessageOut &msg, bool reliable):
+    mMessage(msg),
+    mPacket(enet_packet_create(msg.getData(), msg.getLength(),
+                               reliable ? ENET_PACKET_FLAG_RELIABLE : 0))
+{
+    if (!mPacket)
+        LOG_ERROR("Failure to create packet!");
+}
+
+SharedPacket::~SharedPacket()
+{
+    if (mPacket && mPacket->referenceCount == 0)
+        enet_packet_destroy(mPacket);
+}
+
 NetComputer::NetComputer(ENetPeer *peer):
-    mPeer(peer)
+    mPeer(peer),
+    mBatchCount(0),
+    mMaxBatchSize(0),
+    mBatchId(0)
+{
+}
+
+NetComputer::~NetComputer()
 {
 }
 
@@ -61,6 +83,15 @@ void NetComputer::send(const MessageOut &msg, bool reliable,
 {
     LOG_DEBUG("Sending message " << msg << " to " << *this);
 
+    if (mBatch)
+    {
+        if (reliable && channel == 0 && addToBatch(msg))
+            return;
+
+        // Keep the messages in order
+        flushBatch();
+    }
+
     gBandwidth->increaseClientOutput(this, msg.getLength());
 
     ENetPacket *packet;
@@ -68,9 +99,36 @@ void NetComputer::send(const MessageOut &msg, bool reliable,
                                 msg.getLength(),
                                 reliable ? ENET_PACKET_FLAG_RELIABLE : 0);
 
+    sendPacket(packet, channel);
+}
+
+void NetComputer::send(MessageOut &&msg, bool reliable, unsigned channel)
+{
+    LOG_DEBUG("Sending message " << msg << " to " << *this);
+
+    if (mBatch)
+    {
+        if (reliable && channel == 0 && addToBatch(msg))
+            return;
+
+        flushBatch();
+    }
+
+    gBandwidth->increaseClientOutput(this, msg.getLength());
+
+    sendPacket(msg.toPacket(reliable ? ENET_PACKET_FLAG_RELIABLE : 0),
+               channel);
+}
+
+void NetComputer::sendPacket(ENetPacket *packet, unsigned channel)
+{
     if (packet)
     {
-        enet_peer_send(mPeer, channel, packet);
+        if (enet_peer_send(mPeer, channel, packet) < 0 &&
+            packet->referenceCount == 0)
+        {
+            enet_packet_destroy(packet);
+        }
     }
     else
     {
@@ -78,6 +136,65 @@ void NetComputer::send(const MessageOut &msg, bool reliable,
     }
 }
 
+void NetComputer::send(const SharedPacket &packet, unsigned channel)
+{
+    ENetPacket *enetPacket = packet.getPacket();
+    if (!enetPacket)
+        return;
+
+    LOG_DEBUG("Sending message " << packet.getMessage() << " to " << *this);
+
+    if (mBatch)
+    {
+        if ((enetPacket->flags & ENET_PACKET_FLAG_RELIABLE) && channel == 0 &&
+            addToBatch(packet.getMessage()))
+            return;
+
+        flushBatch();
+    }
+
+    gBandwidth->increaseClientOutput(this, enetPacket->dataLength);
+
+    enet_peer_send(mPeer, channel, enetPacket);
+}
+
+void NetComputer::enableBatching(int batchId, unsigned maxSize)
+{
+    mBatchId = batchId;
+    mMaxBatchSize = maxSize;
+    mBatchCount = 0;
+    mBatch.reset(new MessageOut(batchId));
+}
+
+bool NetComputer::addToBatch(const MessageOut &msg)
+{
+    // Leave room for the length prefix and the annotations of debug mode
+    const unsigned size = msg.getLength() + 8;
+    if (size > mMaxBatchSize)
+        return false;
+
+    if (mBatch->getLength() + size > mMaxBatchSize)
+        flushBatch();
+
+    mBatch->writeMessage(msg);
+    ++mBatchCount;
+    return true;
+}
+
+void NetComputer::flushBatch()
+{
+    if (!mBatch || mBatchCount == 0)
+        return;
+
+    gBandwidth->increaseClientOutput(this, mBatch->getLength());
+    gBandwidth->increaseBatchedMessages(mBatchCount);
+
+    sendPacket(mBatch->toPacket(ENET_PACKET_FLAG_RELIABLE), 0);
+
+    *mBatch = MessageOut(mBatchId);
+    mBatchCount = 0;
+}
+
 std::ostream &operator <<(std::ostream &os, const NetComputer &comp)
 {
     // address.host contains the ip-address in network-byte-order
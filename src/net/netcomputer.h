@@ -22,10 +22,41 @@
 #define NETCOMPUTER_H
 
 #include <iostream>
+#include <memory>
 #include <enet/enet.h>
 
 class MessageOut;
 
+/**
+ * A message serialized once into an ENet packet, which can then be queued to
+ * any number of computers without copying its data. ENet counts the peers
+ * referencing the packet and frees it once all of them are done with it.
+ */
+class SharedPacket
+{
+    public:
+        SharedPacket(const MessageOut &msg, bool reliable = true);
+        SharedPacket(const SharedPacket &) = delete;
+
+        /**
+         * Frees the packet if it was not queued to any computer.
+         */
+        ~SharedPacket();
+
+        SharedPacket &operator=(const SharedPacket &) = delete;
+
+        ENetPacket *getPacket() const { return mPacket; }
+
+        /**
+         * Returns the message the packet was made from, for logging.
+         */
+        const MessageOut &getMessage() const { return mMessage; }
+
+    private:
+        const MessageOut &mMessage;
+        ENetPacket *mPacket;
+};
+
 /**
  * This class represents a known computer on the network. For example a
  * connected client or a server we're connected to.
@@ -35,7 +66,7 @@ class NetComputer
     public:
         NetComputer(ENetPeer *peer);
 
-        virtual ~NetComputer() {}
+        virtual ~NetComputer();
 
         /**
          * Returns <code>true</code> if this computer is connected.
@@ -70,13 +101,54 @@ class NetComputer
         void send(const MessageOut &msg, bool reliable = true,
                   unsigned channel = 0);
 
+        /**
+         * Queues a message for sending, handing its buffer over to the
+         * packet instead of copying it. The message is left empty.
+         */
+        void send(MessageOut &&msg, bool reliable = true,
+                  unsigned channel = 0);
+
+        /**
+         * Queues a packet shared with other computers. The packet data is
+         * not copied.
+         */
+        void send(const SharedPacket &packet, unsigned channel = 0);
+
+        /**
+         * Makes the reliable messages sent to this computer on channel 0 be
+         * gathered into messages of type \a batchId, instead of being sent
+         * in a packet each. The batches are sent by flushBatch(), or when
+         * they reach \a maxSize bytes.
+         */
+        void enableBatching(int batchId, unsigned maxSize);
+
+        /**
+         * Sends the messages gathered since the last call, if any.
+         */
+        void flushBatch();
+
         /**
          * Returns IP address of computer in 32bit int form
          */
         int getIP() const;
 
     private:
+        /**
+         * Queues a packet to the peer, and frees it if that failed.
+         */
+        void sendPacket(ENetPacket *packet, unsigned channel);
+
+        /**
+         * Adds a message to the current batch.
+         * @return false if the message is too large to be batched.
+         */
+        bool addToBatch(const MessageOut &msg);
+
         ENetPeer *mPeer;              /**< Client peer */
+        std::unique_ptr<MessageOut> mBatch; /**< Null unless batching. */
+        unsigned mBatchCount;         /**< Messages in the batch. */
+        unsigned mMaxBatchSize;
+        int mBatchId;
 
         /**
          * Converts the ip-address of the peer to a stringstream.
@@ -27,7 +27,6 @@
 #include "game-server/accountconnection.h"
 #include "game-server/buysell.h"
 #include "game-server/charactercomponent.h"
-#include "game-server/collisiondetection.h"
 #include "game-server/effect.h"
 #include "game-server/gamehandler.h"
 #include "game-server/inventory.h"
@@ -1275,7 +1274,8 @@ static int entity_set_ability_cooldown(lua_State *s)
     Entity *c = checkCharacter(s, 1);
     auto *abilityInfo = checkAbility(s, 2);
     const int ticks = luaL_checkint(s, 3);
-    c->getComponent<AbilityComponent>()->setAbilityCooldown(abilityInfo->id, ticks);
+    auto *abilityComponent = c->getComponent<AbilityComponent>();
+    abilityComponent->setAbilityCooldown(*c, abilityInfo->id, ticks);
     return 0;
 }
 
@@ -1357,6 +1357,40 @@ static int entity_walk(lua_State *s)
     return 0;
 }
 
+/** LUA entity:walk_flow (being)
+ * entity:walk_flow(handle target)
+ * entity:walk_flow(int pixelX, int pixelY)
+ **
+ * Valid only for being entities.
+ *
+ * Sets the destination of the being to the position of **target**, or to
+ * the given coordinates in pixels.
+ *
+ * Instead of searching its own path, the being follows a flow field shared
+ * by all the beings walking to the same tile. This is much cheaper when many
+ * monsters chase the same character.
+ */
+static int entity_walk_flow(lua_State *s)
+{
+    Entity *being = checkBeing(s, 1);
+
+    Point destination;
+    if (lua_isnumber(s, 2))
+    {
+        destination.x = luaL_checkint(s, 2);
+        destination.y = luaL_checkint(s, 3);
+    }
+    else
+    {
+        Entity *target = checkActor(s, 2);
+        destination = target->getComponent<ActorComponent>()->getPosition();
+    }
+
+    being->getComponent<BeingComponent>()->setFlowDestination(*being,
+                                                              destination);
+    return 0;
+}
+
 /** LUA entity:destination (being)
  * local x, y = entity:destination()
  **
@@ -1705,8 +1739,10 @@ static int entity_get_base_attribute(lua_State *s)
 {
     Entity *being = checkBeing(s, 1);
     auto *attribute = checkAttribute(s, 2);
+    auto *beingComponent = being->getComponent<BeingComponent>();
 
-    lua_pushinteger(s, being->getComponent<BeingComponent>()->getAttributeBase(attribute));
+    beingComponent->updateDerivedAttributes(*being);
+    lua_pushinteger(s, beingComponent->getAttributeBase(attribute));
     return 1;
 }
 
@@ -1752,9 +1788,10 @@ static int entity_get_modified_attribute(lua_State *s)
 {
     Entity *being = checkBeing(s, 1);
     auto *attribute = checkAttribute(s, 2);
+    auto *beingComponent = being->getComponent<BeingComponent>();
 
-    const double value =
-            being->getComponent<BeingComponent>()->getModifiedAttribute(attribute);
+    beingComponent->updateDerivedAttributes(*being);
+    const double value = beingComponent->getModifiedAttribute(attribute);
     lua_pushinteger(s, value);
     return 1;
 }
@@ -2260,7 +2297,7 @@ static int entity_give_ability(lua_State *s)
     Entity *b = checkBeing(s, 1);
     auto *abilityInfo = checkAbility(s, 2);
 
-    b->getComponent<AbilityComponent>()->giveAbility(abilityInfo->id);
+    b->getComponent<AbilityComponent>()->giveAbility(*b, abilityInfo->id);
     return 0;
 }
 
@@ -2464,7 +2501,7 @@ static int entity_apply_status(lua_State *s)
     const int id = luaL_checkint(s, 2);
     const int time = luaL_checkint(s, 3);
 
-    being->getComponent<BeingComponent>()->applyStatusEffect(id, time);
+    being->getComponent<BeingComponent>()->applyStatusEffect(*being, id, time);
     return 0;
 }
 
@@ -2480,7 +2517,7 @@ static int entity_remove_status(lua_State *s)
     Entity *being = checkBeing(s, 1);
     const int id = luaL_checkint(s, 2);
 
-    being->getComponent<BeingComponent>()->removeStatusEffect(id);
+    being->getComponent<BeingComponent>()->removeStatusEffect(*being, id);
     return 0;
 }
 
@@ -2529,7 +2566,7 @@ static int entity_set_status_time(lua_State *s)
     const int id = luaL_checkint(s, 2);
     const int time = luaL_checkint(s, 3);
 
-    being->getComponent<BeingComponent>()->setStatusEffectTime(id, time);
+    being->getComponent<BeingComponent>()->setStatusEffectTime(*being, id, time);
     return 0;
 }
 
@@ -2610,20 +2647,82 @@ static int get_path_length(lua_State *s)
     const int destX = luaL_checkint(s, 3);
     const int destY = luaL_checkint(s, 4);
     unsigned maxRange = luaL_checkint(s, 5);
-    unsigned char walkmask = BLOCKTYPE_WALL;
+    unsigned char walkmask = Map::BLOCKMASK_WALL;
     if (lua_gettop(s) > 5)
         walkmask = checkWalkMask(s, 6);
 
     Map *map = checkCurrentMap(s)->getMap();
-    Path path = map->findPath(startX / map->getTileWidth(),
-                              startY / map->getTileHeight(),
-                              destX / map->getTileWidth(),
-                              destY / map->getTileHeight(),
-                              walkmask, maxRange);
-    lua_pushinteger(s, path.size());
+    lua_pushinteger(s, map->getPathLength(startX / map->getTileWidth(),
+                                          startY / map->getTileHeight(),
+                                          destX / map->getTileWidth(),
+                                          destY / map->getTileHeight(),
+                                          walkmask, maxRange));
     return 1;
 }
 
+/** LUA get_nearest_path (mapinformation)
+ * get_nearest_path(int startX, int startY, table targets, int maxRange)
+ * get_nearest_path(int startX, int startY, table targets, int maxRange,
+ *                  string walkmask)
+ **
+ * Finds which of the ''targets'' can be reached with the fewest steps from
+ * the start coordinates, with a maximum of ''maxRange'' steps (in tiles).
+ * ''targets'' is a list of tables with ''x'' and ''y'' fields, in pixels.
+ * All the targets are searched at once, which is cheaper than calling
+ * ''get_path_length'' for each of them.
+ *
+ * If no ''walkmask'' is passed '''w''' is used.
+ *
+ * **Return value:** The index of the nearest target in ''targets'' and the
+ * number of steps (in tiles) required to reach it, or nil if none of them
+ * can be reached.
+ */
+static int get_nearest_path(lua_State *s)
+{
+    const int startX = luaL_checkint(s, 1);
+    const int startY = luaL_checkint(s, 2);
+    luaL_checktype(s, 3, LUA_TTABLE);
+    const int maxRange = luaL_checkint(s, 4);
+    unsigned char walkmask = Map::BLOCKMASK_WALL;
+    if (lua_gettop(s) > 4)
+        walkmask = checkWalkMask(s, 5);
+
+    Map *map = checkCurrentMap(s)->getMap();
+    const int tileWidth = map->getTileWidth();
+    const int tileHeight = map->getTileHeight();
+
+    std::vector<Point> targets;
+    for (int i = 1; ; ++i)
+    {
+        lua_rawgeti(s, 3, i);
+        if (lua_isnil(s, -1))
+        {
+            lua_pop(s, 1);
+            break;
+        }
+        luaL_argcheck(s, lua_istable(s, -1), 3,
+                      "targets must be tables with x and y fields");
+        lua_getfield(s, -1, "x");
+        lua_getfield(s, -2, "y");
+        luaL_argcheck(s, lua_isnumber(s, -2) && lua_isnumber(s, -1), 3,
+                      "targets must be tables with x and y fields");
+        targets.push_back(Point(lua_tointeger(s, -2) / tileWidth,
+                                lua_tointeger(s, -1) / tileHeight));
+        lua_pop(s, 3);
+    }
+
+    int goal;
+    Path path = map->findNearestPath(startX / tileWidth,
+                                     startY / tileHeight,
+                                     targets, walkmask, maxRange, goal);
+    if (goal == -1)
+        return 0;
+
+    lua_pushinteger(s, goal + 1);
+    lua_pushinteger(s, path.size());
+    return 2;
+}
+
 /** LUA map_get_pvp (mapinformation)
  * map_get_pvp()
  **
@@ -2829,22 +2928,14 @@ static int get_beings_in_circle(lua_State *s)
     lua_newtable(s);
     int tableStackPosition = lua_gettop(s);
     int tableIndex = 1;
-    for (BeingIterator i(m->getAroundPointIterator(Point(x, y), r)); i; ++i)
+    std::vector<Entity *> beings;
+    m->getBeingsInCircle(Point(x, y), r, beings);
+    for (std::vector<Entity *>::const_iterator i = beings.begin(),
+         i_end = beings.end(); i != i_end; ++i)
     {
-        Entity *b = *i;
-        char t = b->getType();
-        if (t == OBJECT_NPC || t == OBJECT_CHARACTER || t == OBJECT_MONSTER)
-        {
-            auto *actorComponent = b->getComponent<ActorComponent>();
-            if (Collision::circleWithCircle(actorComponent->getPosition(),
-                                            actorComponent->getSize(),
-                                            Point(x, y), r))
-            {
-                push(s, b);
-                lua_rawseti(s, tableStackPosition, tableIndex);
-                tableIndex++;
-            }
-        }
+        push(s, *i);
+        lua_rawseti(s, tableStackPosition, tableIndex);
+        tableIndex++;
     }
 
     return 1;
@@ -2870,17 +2961,14 @@ static int get_beings_in_rectangle(lua_State *s)
     int tableStackPosition = lua_gettop(s);
     int tableIndex = 1;
     Rectangle rect = {x, y ,w, h};
-    for (BeingIterator i(m->getInsideRectangleIterator(rect)); i; ++i)
+    std::vector<Entity *> beings;
+    m->getBeingsInRectangle(rect, beings);
+    for (std::vector<Entity *>::const_iterator i = beings.begin(),
+         i_end = beings.end(); i != i_end; ++i)
     {
-        Entity *b = *i;
-        char t = b->getType();
-        if ((t == OBJECT_NPC || t == OBJECT_CHARACTER || t == OBJECT_MONSTER) &&
-            rect.contains(b->getComponent<ActorComponent>()->getPosition()))
-        {
-            push(s, b);
-            lua_rawseti(s, tableStackPosition, tableIndex);
-            tableIndex++;
-        }
+        push(s, *i);
+        lua_rawseti(s, tableStackPosition, tableIndex);
+        tableIndex++;
     }
      return 1;
  }
@@ -3435,6 +3523,7 @@ LuaScript::LuaScript():
         { "get_map_property",               get_map_property                  },
         { "is_walkable",                    is_walkable                       },
         { "get_path_length",                get_path_length                   },
+        { "get_nearest_path",               get_nearest_path                  },
         { "map_get_pvp",                    map_get_pvp                       },
         { "item_drop",                      item_drop                         },
         { "log",                            log                               },
@@ -3471,6 +3560,7 @@ LuaScript::LuaScript():
         { "set_global_ability_cooldown",    entity_set_global_ability_cooldown},
         { "global_ability_cooldown",        entity_get_global_ability_cooldown},
         { "walk",                           entity_walk                       },
+        { "walk_flow",                      entity_walk_flow                  },
         { "destination",                    entity_destination                },
         { "look_at",                        entity_look_at                    },
         { "heal",                           entity_heal                       },
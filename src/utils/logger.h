@@ -37,7 +37,8 @@ namespace utils
  * configured to not prefix the messages with a timestamp.
  *
  * Limitations:
- *     - not thread-safe.
+ *     - messages may be logged from several threads at once, but the
+ *       settings must only be changed while no other thread logs.
  *
  * Example of use:
  *
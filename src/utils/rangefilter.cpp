@@ -0,0 +1,448 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "utils/rangefilter.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define RANGEFILTER_X86
+#  include <immintrin.h>
+#endif
+
+namespace utils {
+namespace rangefilter {
+
+typedef void (*InRangeFunc)(const int *, const int *, unsigned,
+                            const Point &, int, std::vector<unsigned> &);
+typedef void (*InRectangleFunc)(const int *, const int *, unsigned,
+                                const Rectangle &, std::vector<unsigned> &);
+typedef void (*InCircleFunc)(const int *, const int *, const unsigned char *,
+                             unsigned, const Point &, int,
+                             std::vector<unsigned> &);
+
+/**
+ * Functions implementing the filters with a given instruction set.
+ */
+struct Kernels
+{
+    InRangeFunc inRange;
+    InRectangleFunc inRectangle;
+    InCircleFunc inCircle;
+};
+
+/*
+ * Scalar versions, also used for the points left over by the vector versions.
+ */
+
+static void scalarInRange(const int *xs, const int *ys, unsigned begin,
+                          unsigned count, const Point &center, int range,
+                          std::vector<unsigned> &result)
+{
+    for (unsigned i = begin; i < count; ++i)
+    {
+        if (std::abs(xs[i] - center.x) <= range &&
+            std::abs(ys[i] - center.y) <= range)
+        {
+            result.push_back(i);
+        }
+    }
+}
+
+static void scalarInRectangle(const int *xs, const int *ys, unsigned begin,
+                              unsigned count, const Rectangle &rect,
+                              std::vector<unsigned> &result)
+{
+    for (unsigned i = begin; i < count; ++i)
+    {
+        if (rect.contains(Point(xs[i], ys[i])))
+            result.push_back(i);
+    }
+}
+
+static void scalarInCircle(const int *xs, const int *ys,
+                           const unsigned char *sizes, unsigned begin,
+                           unsigned count, const Point &center, int radius,
+                           std::vector<unsigned> &result)
+{
+    for (unsigned i = begin; i < count; ++i)
+    {
+        const int touchDistance = sizes[i] + radius;
+        const int distX = xs[i] - center.x;
+        const int distY = ys[i] - center.y;
+        if (distX * distX + distY * distY < touchDistance * touchDistance)
+            result.push_back(i);
+    }
+}
+
+static void scalarInRange(const int *xs, const int *ys, unsigned count,
+                          const Point &center, int range,
+                          std::vector<unsigned> &result)
+{
+    scalarInRange(xs, ys, 0, count, center, range, result);
+}
+
+static void scalarInRectangle(const int *xs, const int *ys, unsigned count,
+                              const Rectangle &rect,
+                              std::vector<unsigned> &result)
+{
+    scalarInRectangle(xs, ys, 0, count, rect, result);
+}
+
+static void scalarInCircle(const int *xs, const int *ys,
+                           const unsigned char *sizes, unsigned count,
+                           const Point &center, int radius,
+                           std::vector<unsigned> &result)
+{
+    scalarInCircle(xs, ys, sizes, 0, count, center, radius, result);
+}
+
+static const Kernels scalarKernels = {
+    &scalarInRange, &scalarInRectangle, &scalarInCircle
+};
+
+#ifdef RANGEFILTER_X86
+
+/**
+ * Coordinate differences are clamped to this value by the circle filters, so
+ * that squared distances fit in 32 bits. Larger radii use the scalar filter.
+ */
+static const int MAX_VECTOR_DISTANCE = 32767;
+
+/**
+ * Appends the indices of the bits set in \a mask, offset by \a base.
+ */
+static inline void appendMask(unsigned mask, unsigned base,
+                              std::vector<unsigned> &result)
+{
+    while (mask)
+    {
+        result.push_back(base + __builtin_ctz(mask));
+        mask &= mask - 1;
+    }
+}
+
+/*
+ * SSE2 versions, handling 4 points at a time.
+ */
+
+__attribute__((target("sse2")))
+static void sse2InRange(const int *xs, const int *ys, unsigned count,
+                        const Point &center, int range,
+                        std::vector<unsigned> &result)
+{
+    const __m128i minX = _mm_set1_epi32(center.x - range);
+    const __m128i maxX = _mm_set1_epi32(center.x + range);
+    const __m128i minY = _mm_set1_epi32(center.y - range);
+    const __m128i maxY = _mm_set1_epi32(center.y + range);
+
+    unsigned i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128i x = _mm_loadu_si128((const __m128i *) (xs + i));
+        const __m128i y = _mm_loadu_si128((const __m128i *) (ys + i));
+        const __m128i outside = _mm_or_si128(
+                _mm_or_si128(_mm_cmplt_epi32(x, minX),
+                             _mm_cmpgt_epi32(x, maxX)),
+                _mm_or_si128(_mm_cmplt_epi32(y, minY),
+                             _mm_cmpgt_epi32(y, maxY)));
+        appendMask(~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF, i,
+                   result);
+    }
+    scalarInRange(xs, ys, i, count, center, range, result);
+}
+
+__attribute__((target("sse2")))
+static void sse2InRectangle(const int *xs, const int *ys, unsigned count,
+                            const Rectangle &rect,
+                            std::vector<unsigned> &result)
+{
+    const __m128i minX = _mm_set1_epi32(rect.x);
+    const __m128i endX = _mm_set1_epi32(rect.x + rect.w);
+    const __m128i minY = _mm_set1_epi32(rect.y);
+    const __m128i endY = _mm_set1_epi32(rect.y + rect.h);
+
+    unsigned i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128i x = _mm_loadu_si128((const __m128i *) (xs + i));
+        const __m128i y = _mm_loadu_si128((const __m128i *) (ys + i));
+        const __m128i inside = _mm_and_si128(
+                _mm_andnot_si128(_mm_cmplt_epi32(x, minX),
+                                 _mm_cmplt_epi32(x, endX)),
+                _mm_andnot_si128(_mm_cmplt_epi32(y, minY),
+                                 _mm_cmplt_epi32(y, endY)));
+        appendMask(_mm_movemask_ps(_mm_castsi128_ps(inside)), i, result);
+    }
+    scalarInRectangle(xs, ys, i, count, rect, result);
+}
+
+__attribute__((target("sse2")))
+static void sse2InCircle(const int *xs, const int *ys,
+                         const unsigned char *sizes, unsigned count,
+                         const Point &center, int radius,
+                         std::vector<unsigned> &result)
+{
+    if (radius < 0 || radius > MAX_VECTOR_DISTANCE - 255)
+    {
+        scalarInCircle(xs, ys, sizes, count, center, radius, result);
+        return;
+    }
+
+    const __m128i centerX = _mm_set1_epi32(center.x);
+    const __m128i centerY = _mm_set1_epi32(center.y);
+    const __m128i radii = _mm_set1_epi32(radius);
+    const __m128i minDistance = _mm_set1_epi16(-MAX_VECTOR_DISTANCE);
+    const __m128i zero = _mm_setzero_si128();
+
+    unsigned i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128i x = _mm_loadu_si128((const __m128i *) (xs + i));
+        const __m128i y = _mm_loadu_si128((const __m128i *) (ys + i));
+
+        // Saturate the distances to 16 bits and interleave them, so that
+        // madd computes distX * distX + distY * distY for each point.
+        __m128i distX = _mm_packs_epi32(_mm_sub_epi32(x, centerX), zero);
+        __m128i distY = _mm_packs_epi32(_mm_sub_epi32(y, centerY), zero);
+        distX = _mm_max_epi16(distX, minDistance);
+        distY = _mm_max_epi16(distY, minDistance);
+        const __m128i dist = _mm_unpacklo_epi16(distX, distY);
+        const __m128i distSquared = _mm_madd_epi16(dist, dist);
+
+        int packedSizes;
+        memcpy(&packedSizes, sizes + i, sizeof(packedSizes));
+        __m128i touch = _mm_cvtsi32_si128(packedSizes);
+        touch = _mm_unpacklo_epi16(_mm_unpacklo_epi8(touch, zero), zero);
+        touch = _mm_add_epi32(touch, radii);
+        const __m128i touchSquared = _mm_madd_epi16(touch, touch);
+
+        const __m128i hit = _mm_cmplt_epi32(distSquared, touchSquared);
+        appendMask(_mm_movemask_ps(_mm_castsi128_ps(hit)), i, result);
+    }
+    scalarInCircle(xs, ys, sizes, i, count, center, radius, result);
+}
+
+static const Kernels sse2Kernels = {
+    &sse2InRange, &sse2InRectangle, &sse2InCircle
+};
+
+/*
+ * AVX2 versions, handling 8 points at a time.
+ */
+
+__attribute__((target("avx2")))
+static void avx2InRange(const int *xs, const int *ys, unsigned count,
+                        const Point &center, int range,
+                        std::vector<unsigned> &result)
+{
+    const __m256i belowX = _mm256_set1_epi32(center.x - range - 1);
+    const __m256i maxX = _mm256_set1_epi32(center.x + range);
+    const __m256i belowY = _mm256_set1_epi32(center.y - range - 1);
+    const __m256i maxY = _mm256_set1_epi32(center.y + range);
+
+    unsigned i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256i x = _mm256_loadu_si256((const __m256i *) (xs + i));
+        const __m256i y = _mm256_loadu_si256((const __m256i *) (ys + i));
+        const __m256i inside = _mm256_and_si256(
+                _mm256_andnot_si256(_mm256_cmpgt_epi32(x, maxX),
+                                    _mm256_cmpgt_epi32(x, belowX)),
+                _mm256_andnot_si256(_mm256_cmpgt_epi32(y, maxY),
+                                    _mm256_cmpgt_epi32(y, belowY)));
+        appendMask(_mm256_movemask_ps(_mm256_castsi256_ps(inside)), i,
+                   result);
+    }
+    scalarInRange(xs, ys, i, count, center, range, result);
+}
+
+__attribute__((target("avx2")))
+static void avx2InRectangle(const int *xs, const int *ys, unsigned count,
+                            const Rectangle &rect,
+                            std::vector<unsigned> &result)
+{
+    const __m256i belowX = _mm256_set1_epi32(rect.x - 1);
+    const __m256i endX = _mm256_set1_epi32(rect.x + rect.w);
+    const __m256i belowY = _mm256_set1_epi32(rect.y - 1);
+    const __m256i endY = _mm256_set1_epi32(rect.y + rect.h);
+
+    unsigned i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256i x = _mm256_loadu_si256((const __m256i *) (xs + i));
+        const __m256i y = _mm256_loadu_si256((const __m256i *) (ys + i));
+        const __m256i inside = _mm256_and_si256(
+                _mm256_and_si256(_mm256_cmpgt_epi32(x, belowX),
+                                 _mm256_cmpgt_epi32(endX, x)),
+                _mm256_and_si256(_mm256_cmpgt_epi32(y, belowY),
+                                 _mm256_cmpgt_epi32(endY, y)));
+        appendMask(_mm256_movemask_ps(_mm256_castsi256_ps(inside)), i,
+                   result);
+    }
+    scalarInRectangle(xs, ys, i, count, rect, result);
+}
+
+__attribute__((target("avx2")))
+static void avx2InCircle(const int *xs, const int *ys,
+                         const unsigned char *sizes, unsigned count,
+                         const Point &center, int radius,
+                         std::vector<unsigned> &result)
+{
+    if (radius < 0 || radius > MAX_VECTOR_DISTANCE - 255)
+    {
+        scalarInCircle(xs, ys, sizes, count, center, radius, result);
+        return;
+    }
+
+    const __m256i centerX = _mm256_set1_epi32(center.x);
+    const __m256i centerY = _mm256_set1_epi32(center.y);
+    const __m256i radii = _mm256_set1_epi32(radius);
+    const __m256i maxDistance = _mm256_set1_epi32(MAX_VECTOR_DISTANCE);
+    const __m256i minDistance = _mm256_set1_epi32(-MAX_VECTOR_DISTANCE);
+
+    unsigned i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256i x = _mm256_loadu_si256((const __m256i *) (xs + i));
+        const __m256i y = _mm256_loadu_si256((const __m256i *) (ys + i));
+
+        __m256i distX = _mm256_sub_epi32(x, centerX);
+        __m256i distY = _mm256_sub_epi32(y, centerY);
+        distX = _mm256_max_epi32(_mm256_min_epi32(distX, maxDistance),
+                                 minDistance);
+        distY = _mm256_max_epi32(_mm256_min_epi32(distY, maxDistance),
+                                 minDistance);
+        const __m256i distSquared = _mm256_add_epi32(
+                _mm256_mullo_epi32(distX, distX),
+                _mm256_mullo_epi32(distY, distY));
+
+        const __m256i touch = _mm256_add_epi32(
+                _mm256_cvtepu8_epi32(
+                        _mm_loadl_epi64((const __m128i *) (sizes + i))),
+                radii);
+        const __m256i touchSquared = _mm256_mullo_epi32(touch, touch);
+
+        const __m256i hit = _mm256_cmpgt_epi32(touchSquared, distSquared);
+        appendMask(_mm256_movemask_ps(_mm256_castsi256_ps(hit)), i, result);
+    }
+    scalarInCircle(xs, ys, sizes, i, count, center, radius, result);
+}
+
+static const Kernels avx2Kernels = {
+    &avx2InRange, &avx2InRectangle, &avx2InCircle
+};
+
+#endif // RANGEFILTER_X86
+
+static Implementation currentImplementation = SCALAR;
+static const Kernels *kernels = &scalarKernels;
+
+static const Kernels *getKernels(Implementation implementation)
+{
+    switch (implementation)
+    {
+#ifdef RANGEFILTER_X86
+        case SSE2:
+            return &sse2Kernels;
+        case AVX2:
+            return &avx2Kernels;
+#endif
+        default:
+            return &scalarKernels;
+    }
+}
+
+bool isSupported(Implementation implementation)
+{
+    switch (implementation)
+    {
+        case SCALAR:
+            return true;
+#ifdef RANGEFILTER_X86
+        case SSE2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2");
+        case AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+void init()
+{
+    if (!setImplementation(AVX2) && !setImplementation(SSE2))
+        setImplementation(SCALAR);
+}
+
+bool setImplementation(Implementation implementation)
+{
+    if (!isSupported(implementation))
+        return false;
+
+    currentImplementation = implementation;
+    kernels = getKernels(implementation);
+    return true;
+}
+
+Implementation getImplementation()
+{
+    return currentImplementation;
+}
+
+const char *getName(Implementation implementation)
+{
+    switch (implementation)
+    {
+        case SSE2:
+            return "SSE2";
+        case AVX2:
+            return "AVX2";
+        default:
+            return "scalar";
+    }
+}
+
+void inRange(const int *xs, const int *ys, unsigned count,
+             const Point &center, int range, std::vector<unsigned> &result)
+{
+    kernels->inRange(xs, ys, count, center, range, result);
+}
+
+void inRectangle(const int *xs, const int *ys, unsigned count,
+                 const Rectangle &rect, std::vector<unsigned> &result)
+{
+    kernels->inRectangle(xs, ys, count, rect, result);
+}
+
+void inCircle(const int *xs, const int *ys, const unsigned char *sizes,
+              unsigned count, const Point &center, int radius,
+              std::vector<unsigned> &result)
+{
+    kernels->inCircle(xs, ys, sizes, count, center, radius, result);
+}
+
+} // namespace rangefilter
+} // namespace utils
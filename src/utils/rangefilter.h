@@ -0,0 +1,95 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef RANGEFILTER_H
+#define RANGEFILTER_H
+
+#include "utils/point.h"
+
+#include <vector>
+
+namespace utils
+{
+/**
+ * Filters batches of points packed in coordinate arrays, using SIMD
+ * instructions when the processor supports them.
+ *
+ * Every filter appends the indices of the matching points to a list, in
+ * increasing order, and gives the same results as the corresponding scalar
+ * tests (Point::inRangeOf, Rectangle::contains and
+ * Collision::circleWithCircle) for coordinates below 32768.
+ */
+namespace rangefilter
+{
+    enum Implementation
+    {
+        SCALAR = 0,
+        SSE2,
+        AVX2
+    };
+
+    /**
+     * Selects the best implementation supported by the processor.
+     */
+    void init();
+
+    /**
+     * Selects an implementation. Returns false and leaves the current one
+     * when it is not supported by the build or the processor.
+     */
+    bool setImplementation(Implementation implementation);
+
+    /**
+     * Returns whether an implementation can be used on this machine.
+     */
+    bool isSupported(Implementation implementation);
+
+    Implementation getImplementation();
+
+    const char *getName(Implementation implementation);
+
+    /**
+     * Appends to \a result the indices of the points within \a range of
+     * \a center on both axes.
+     */
+    void inRange(const int *xs, const int *ys, unsigned count,
+                 const Point &center, int range,
+                 std::vector<unsigned> &result);
+
+    /**
+     * Appends to \a result the indices of the points inside \a rect.
+     */
+    void inRectangle(const int *xs, const int *ys, unsigned count,
+                     const Rectangle &rect,
+                     std::vector<unsigned> &result);
+
+    /**
+     * Appends to \a result the indices of the circles, given by their center
+     * and radius, touching the circle of the given \a center and \a radius.
+     */
+    void inCircle(const int *xs, const int *ys, const unsigned char *sizes,
+                  unsigned count, const Point &center, int radius,
+                  std::vector<unsigned> &result);
+
+} // namespace rangefilter
+} // namespace utils
+
+#endif // RANGEFILTER_H
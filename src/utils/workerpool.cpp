@@ -0,0 +1,105 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/workerpool.h"
+
+namespace utils
+{
+
+WorkerPool::WorkerPool(unsigned threads):
+    mJob(nullptr),
+    mCount(0),
+    mNext(0),
+    mPending(0),
+    mBatch(0),
+    mQuit(false)
+{
+    mThreads.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i)
+        mThreads.push_back(std::thread(&WorkerPool::threadLoop, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mBatchStarted.notify_all();
+
+    for (std::thread &thread : mThreads)
+        thread.join();
+}
+
+void WorkerPool::run(unsigned count, const Job &job)
+{
+    if (count == 0)
+        return;
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mJob = &job;
+    mCount = count;
+    mNext = 0;
+    mPending = count;
+    ++mBatch;
+    mBatchStarted.notify_all();
+
+    work(lock);
+
+    while (mPending > 0)
+        mBatchDone.wait(lock);
+    mJob = nullptr;
+}
+
+void WorkerPool::work(std::unique_lock<std::mutex> &lock)
+{
+    while (mJob && mNext < mCount)
+    {
+        const unsigned index = mNext++;
+        const Job &job = *mJob;
+
+        lock.unlock();
+        job(index);
+        lock.lock();
+
+        if (--mPending == 0)
+            mBatchDone.notify_all();
+    }
+}
+
+void WorkerPool::threadLoop()
+{
+    unsigned lastBatch = 0;
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true)
+    {
+        while (!mQuit && mBatch == lastBatch)
+            mBatchStarted.wait(lock);
+
+        if (mQuit)
+            return;
+
+        lastBatch = mBatch;
+        work(lock);
+    }
+}
+
+} // namespace utils
@@ -0,0 +1,92 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils
+{
+
+/**
+ * A fixed set of threads executing batches of independent jobs.
+ *
+ * The thread calling run() takes part in the work and only returns once every
+ * job of the batch has completed, so each call to run() acts as a barrier.
+ */
+class WorkerPool
+{
+    public:
+        typedef std::function<void (unsigned)> Job;
+
+        /**
+         * Starts \a threads worker threads, in addition to the thread that
+         * will be calling run().
+         */
+        WorkerPool(unsigned threads);
+        WorkerPool(const WorkerPool &) = delete;
+
+        /**
+         * Stops and joins the worker threads.
+         */
+        ~WorkerPool();
+
+        /**
+         * Calls \a job once for each index in [0, count), spread over the
+         * worker threads and the calling thread. Returns when all the calls
+         * have returned.
+         */
+        void run(unsigned count, const Job &job);
+
+        /**
+         * Returns the number of threads started in addition to the caller.
+         */
+        unsigned getThreadCount() const
+        { return mThreads.size(); }
+
+    private:
+        void threadLoop();
+
+        /**
+         * Executes jobs of the current batch until none is left.
+         */
+        void work(std::unique_lock<std::mutex> &lock);
+
+        std::vector<std::thread> mThreads;
+        std::mutex mMutex;
+        std::condition_variable mBatchStarted;
+        std::condition_variable mBatchDone;
+
+        const Job *mJob;        /**< Job of the current batch, if any. */
+        unsigned mCount;        /**< Number of jobs in the current batch. */
+        unsigned mNext;         /**< Next job index to hand out. */
+        unsigned mPending;      /**< Jobs not yet completed. */
+        unsigned mBatch;        /**< Counts the batches started so far. */
+        bool mQuit;
+};
+
+} // namespace utils
+
+#endif // WORKERPOOL_H